@@ -7,5 +7,6 @@ void list_columns(const Table *table);
 void count_isna(const Table *table, int col_index);
 void na_count(const Table *table);
 void find_outlier(const Table *table);
+void value_counts(const Table *table, int col_index, int top);
 
 #endif
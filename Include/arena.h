@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define ARENA_BLOCK_SIZE (1 << 20) // bytes taken from malloc at a time
+#define ARENA_CLASSES 256          // pooled size classes, 4 per power of two
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator owned by a Table. Allocations are carved out of large
+// blocks and only returned when the whole arena is destroyed, so teardown
+// costs one free per block. Buffers that are replaced, such as the vectors
+// of a rewritten column, can be released into size class pools (classes
+// are at most 25% apart) and are handed out again by later requests of
+// the same class. All functions are thread-safe.
+typedef struct
+{
+    ArenaBlock *blocks;
+    char *cursor;     // free space of the current block
+    char *end;
+    void *pools[ARENA_CLASSES];
+    size_t reserved;  // bytes obtained from malloc
+    pthread_mutex_t lock;
+} Arena;
+
+Arena *arena_create(void);
+void arena_destroy(Arena *arena);
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *str);
+
+// Allocation of at least `size` bytes that may later go back to the pool
+// with arena_release, called with the same size
+void *arena_alloc_pooled(Arena *arena, size_t size);
+void arena_release(Arena *arena, void *ptr, size_t size);
+
+// Bytes behind a pooled allocation of `size`. Memory from elsewhere may be
+// released into the pools if it is at least this large.
+size_t arena_class_size(size_t size);
+
+#endif
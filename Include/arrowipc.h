@@ -0,0 +1,17 @@
+#ifndef ARROWIPC_H
+#define ARROWIPC_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "fileio.h"
+
+// Write a table as an Arrow IPC file (Feather v2), readable with
+// pyarrow.feather / pyarrow.ipc.open_file and memory-mapped by consumers.
+// Each column keeps its type: int64, float64, bool and utf8 (binary when a
+// column is not valid UTF-8), with all-N/A columns as the null type.
+// String columns with few distinct values (see set_dictionary_limit) are
+// dictionary encoded. With export compression on, every buffer is an LZ4
+// frame. Columns are encoded in parallel and written as one record batch.
+bool arrow_write_table(const Table *table, FILE *fp);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include "datagen.h"
+
+#define DEFAULT_BENCH_REPEAT 5
+
+// Generate the data set `spec` describes, then time load_csv, print_stats,
+// export_stats_csv, fill_na, drop_na, bucket_col, scale_to_range,
+// outlier_detection and save_csv on it, `repeat` runs each. Steps that
+// change the table run on a freshly loaded copy every time. Per step the
+// report gives the median and best time, throughput in MB/s (size of the
+// generated CSV, or of the written file for save_csv) and rows/s, and the
+// peak resident memory while it ran. The report is JSON when its name ends
+// in .json and CSV otherwise; a summary is printed as well.
+bool run_benchmarks(const DataSpec *spec, int repeat, const char *report);
+
+// Index `filename` with every tokenizer the CPU supports (see ScanMode)
+// and compare each index, span by span, with a single-threaded scalar
+// one. Prints the time and throughput of each; false if any differs.
+bool check_scan_modes(const char *filename);
+
+#endif
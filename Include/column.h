@@ -0,0 +1,99 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+typedef enum
+{
+    TYPE_STRING,
+    TYPE_INT,
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_NULL
+} FieldType;
+
+// One column of a Table, stored contiguously by type.
+// Only the vector matching the storage type is allocated. String (and
+// TYPE_NULL) columns keep every value in one byte buffer, in row order:
+// value i starts at bytes + offsets[i] and is NUL-terminated, so it can be
+// used as a C string.
+// A string column with few distinct values may be dictionary encoded
+// instead: each distinct value is stored once, value k at bytes +
+// offsets[k], and codes[i] is the value of row i (0 for nulls). Counting,
+// grouping and comparing such a column can work on the codes alone.
+typedef struct
+{
+    FieldType type;
+    int length;         // number of rows stored
+    int capacity;       // number of rows allocated
+    int64_t *ints;      // TYPE_INT
+    double *floats;     // TYPE_FLOAT
+    uint8_t *bools;     // TYPE_BOOL
+    int64_t *offsets;   // TYPE_STRING / TYPE_NULL
+    char *bytes;
+    int64_t bytes_len;
+    int64_t bytes_cap;
+    uint16_t *codes;    // dictionary encoded strings, else NULL
+    int dict_count;     // distinct values (entries of offsets) when encoded
+    uint64_t *validity; // bit set = value present, clear = N/A
+    Arena *arena;       // owner of the buffers, NULL for malloc
+} Column;
+
+void column_init(Column *col, FieldType type);
+void column_init_in(Column *col, FieldType type, Arena *arena);
+void column_free(Column *col);
+bool column_reserve(Column *col, int capacity);
+bool column_reserve_bytes(Column *col, int64_t bytes);
+
+bool column_push_null(Column *col);
+bool column_push_int(Column *col, int64_t value);
+bool column_push_float(Column *col, double value);
+bool column_push_bool(Column *col, bool value);
+bool column_push_string(Column *col, const char *str, size_t len);
+bool column_push_text(Column *col, const char *text, size_t len);
+bool column_push_code(Column *col, int code);
+
+void column_set_null(Column *col, int row);
+void column_set_int(Column *col, int row, int64_t value);
+void column_set_float(Column *col, int row, double value);
+void column_set_bool(Column *col, int row, bool value);
+void column_set_code(Column *col, int row, int code);
+
+bool column_convert(Column *col, FieldType type);
+bool column_encode_dictionary(Column *col, int limit);
+bool column_decode_dictionary(Column *col);
+bool column_begin_dictionary(Column *col);
+int column_append_code(Column *col, const char *str, size_t len);
+int column_find_code(const Column *col, const char *text);
+int column_add_code(Column *col, const char *text);
+bool column_take(Column *col, const int *rows, int count);
+void column_compact(Column *col, const uint64_t *keep, int kept);
+
+bool column_get_number(const Column *col, int row, double *out);
+const char *column_text(const Column *col, int row, char *buf, size_t size);
+int column_null_count(const Column *col);
+int column_next_null(const Column *col, int from);
+int bitmap_count(const uint64_t *bits, int nbits);
+
+static inline bool column_is_valid(const Column *col, int row) {
+    return (col->validity[row >> 6] >> (row & 63)) & 1;
+}
+
+static inline bool column_is_numeric(const Column *col) {
+    return col->type == TYPE_INT || col->type == TYPE_FLOAT;
+}
+
+// Text of a present cell of a string column
+static inline const char *column_string_at(const Column *col, int row) {
+    return col->bytes + col->offsets[col->codes ? col->codes[row] : row];
+}
+
+// String value of a row in a string column, NULL when the cell is N/A.
+static inline const char *column_get_string(const Column *col, int row) {
+    return column_is_valid(col, row) ? column_string_at(col, row) : NULL;
+}
+
+#endif // COLUMN_H
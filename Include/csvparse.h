@@ -0,0 +1,61 @@
+#ifndef CSVPARSE_H
+#define CSVPARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPAN_ESCAPED 1u // raw text still holds quotes that must be decoded
+
+// Location of one field inside the input buffer. Plain quoted fields point
+// between their quotes; fields with "" escapes or text after the closing
+// quote keep the raw bytes and are flagged SPAN_ESCAPED.
+typedef struct
+{
+    int64_t offset;
+    uint32_t length;
+    uint32_t flags;
+} FieldSpan;
+
+// Field boundaries of a whole CSV buffer.
+// Row i is fields[row_start[i]] .. fields[row_start[i + 1] - 1].
+typedef struct
+{
+    FieldSpan *fields;
+    int64_t field_count;
+    int64_t field_cap;
+    int64_t *row_start; // row_count + 1 entries
+    int64_t row_count;
+    int64_t row_cap;
+    uint32_t max_length; // longest raw field, sizes decode buffers
+} CsvIndex;
+
+// Tokenizer used by csv_index_build. SCAN_AUTO picks the widest one the
+// CPU supports; the others can be chosen with --scan and are checked
+// against each other by --check-scan.
+typedef enum
+{
+    SCAN_AUTO,
+    SCAN_SCALAR,
+    SCAN_BLOCK,  // 64-byte bitmaps, portable classifier
+    SCAN_SSE2,
+    SCAN_AVX2,
+    SCAN_MODES
+} ScanMode;
+
+void csv_set_scan_mode(ScanMode mode);
+ScanMode csv_scan_mode(void);
+// "auto", "scalar", "block", "sse2" or "avx2"
+const char *csv_scan_mode_name(ScanMode mode);
+// Whether this build and CPU have the tokenizer. A mode that is not
+// supported falls back to the next narrower one.
+bool csv_scan_supported(ScanMode mode);
+bool csv_index_build(CsvIndex *idx, const char *data, size_t size, char delim);
+void csv_index_free(CsvIndex *idx);
+size_t csv_span_decode(const char *data, const FieldSpan *span, char *out);
+
+static inline int64_t csv_row_fields(const CsvIndex *idx, int64_t row) {
+    return idx->row_start[row + 1] - idx->row_start[row];
+}
+
+#endif
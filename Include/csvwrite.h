@@ -0,0 +1,16 @@
+#ifndef CSVWRITE_H
+#define CSVWRITE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "fileio.h"
+
+#define WRITE_BLOCK_ROWS 16384 // rows encoded per task
+
+// Write the header and every row of a table to fp as RFC 4180 CSV. Fields
+// are quoted only when they hold a delimiter, quote or line break, and
+// nulls are written as empty cells. Row blocks are encoded in parallel
+// into memory and written in order, several blocks per system call.
+bool csv_write_table(const Table *table, FILE *fp);
+
+#endif
@@ -9,4 +9,19 @@ int bucket_col(Table *t, int col, int nbuckets, int preserve_header);
 int outlier_detection(Table *t);
 int scale_to_range(Table *t, int col, double a, double b, int preserve_header);
 
+// Kernels the query plan (plan.c) combines into fused passes. They print
+// nothing, so several can run side by side.
+
+// Linear map v -> a + (v - vmin) * scale, as scale_to_range applies it
+typedef struct
+{
+    double a, vmin, scale;
+} Rescale;
+
+Rescale rescale_for(double a, double b, double vmin, double vmax);
+void rescaled_range(const Rescale *maps, int count, double *vmin, double *vmax);
+bool numeric_range(const Column *col, const uint64_t *rows, double *vmin, double *vmax);
+bool rescale_numbers(Column *col, const Rescale *maps, int count);
+bool bucket_numbers(Column *col, const Rescale *maps, int count, double vmin, double vmax, int nbuckets);
+
 #endif
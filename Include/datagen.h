@@ -0,0 +1,34 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "column.h"
+
+// Shape of a synthetic CSV data set. Cells are drawn from a generator
+// seeded by `seed`, so one spec always gives the same bytes.
+typedef struct
+{
+    int64_t rows;
+    int cols;
+    int mix[4];        // relative number of int, float, string and bool columns
+    double null_rate;  // share of cells left empty
+    double quote_rate; // share of distinct strings holding a comma or quotes
+    int64_t cardinality; // distinct values of int and string columns, 0 = unbounded
+    uint64_t seed;
+} DataSpec;
+
+void datagen_default(DataSpec *spec);
+
+// Read "key=value" settings, separated by spaces or commas, over *spec:
+//   rows=1000000 cols=12 mix=4:4:3:1 nulls=0.05 quoted=0.1 card=1000 seed=7
+// (mix gives int:float:string:bool). Prints the offending setting and
+// returns false on a bad one.
+bool datagen_parse(DataSpec *spec, const char *text);
+
+// Write the header and every row to path. Column types are spread through
+// the table in proportion to the mix and named by type and position (i0,
+// f1, s2, b3, ...).
+bool datagen_write(const DataSpec *spec, const char *path);
+
+#endif
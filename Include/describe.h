@@ -0,0 +1,44 @@
+#ifndef DESCRIBE_H
+#define DESCRIBE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fileio.h"
+
+#define DESCRIBE_QUARTILES 1 // also sketch the 25/50/75% quantiles
+
+// Running count, mean, spread and range of a stream of numbers. Values are
+// folded in with Welford's update, and partial results combine exactly
+// (Chan et al.), so blocks, chunks and threads can each keep their own.
+typedef struct
+{
+    int64_t count;
+    double mean;
+    double m2; // sum of squared deviations from the mean
+    double min, max;
+} Moments;
+
+void moments_init(Moments *m);
+void moments_add(Moments *m, double v);
+void moments_add_block(Moments *m, const double *v, int n);
+void moments_merge(Moments *dst, const Moments *src);
+double moments_sd(const Moments *m); // population standard deviation
+
+// Everything print_stats and export_stats_csv report for one column
+typedef struct
+{
+    bool numeric;        // int or float column; the values below need this
+    int count;           // values present
+    int nulls;
+    double mean, sd;     // NAN without values
+    double min, max;
+    double quartiles[3]; // 25%, 50%, 75%; NAN unless DESCRIBE_QUARTILES
+} ColumnSummary;
+
+bool describe_column(const Column *col, ColumnSummary *out, int flags);
+// One summary per column, computed in parallel. Caller frees the array.
+ColumnSummary *describe_table(const Table *table, int flags);
+// N/A count of every column, computed in parallel. Caller frees the array.
+int *count_nulls(const Table *table);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "column.h"
+
+#define DEFAULT_DICTIONARY_LIMIT 1024 // most distinct values worth encoding
+#define DICTIONARY_MAX_VALUES 32767   // codes also fit a signed 16-bit index
+
+// Distinct values of a string column and the code of every row's value.
+// Null rows get code 0; the validity bitmap of the column still tells them
+// apart. Value k is the NUL-terminated text at bytes + offsets[k].
+typedef struct
+{
+    int count;
+    const char *bytes;
+    const int64_t *offsets;
+    const uint16_t *codes;   // one per row
+    int64_t *owned_offsets;  // set when built, NULL when borrowed from an encoded column
+    uint16_t *owned_codes;
+} Dictionary;
+
+// Dictionary of a column that is encoded already, or one built for it in
+// order of first appearance. Building gives up (returns false) once more
+// than `limit` distinct values or more than half as many as there are rows
+// have been seen, so a column that does not pay off costs little.
+bool dictionary_build(const Column *col, int limit, Dictionary *dict);
+void dictionary_free(Dictionary *dict);
+
+static inline const char *dictionary_value(const Dictionary *dict, int k) {
+    return dict->bytes + dict->offsets[k];
+}
+
+// Fills an empty string column as an encoded one, value by value, so the
+// text of repeated values is never stored. Values are found by hash.
+typedef struct
+{
+    Column *col;
+    int limit;
+    size_t cap; // hash slots, a power of two
+    struct DictionarySlot *slots;
+} DictionaryEncoder;
+
+bool dictionary_encoder_init(DictionaryEncoder *enc, Column *col, int limit);
+// Append a value (NULL for N/A). False once the column would need more
+// than `limit` distinct values, or when out of memory.
+bool dictionary_encoder_push(DictionaryEncoder *enc, const char *text, size_t len);
+void dictionary_encoder_free(DictionaryEncoder *enc);
+
+// One distinct value of a column: the first row holding it and how many do
+typedef struct
+{
+    int row;
+    int count;
+} ValueCount;
+
+// Distinct present values, most frequent first (ties in row order). Counts
+// codes directly for encoded columns and hashes the text otherwise. Returns
+// the number of values, or -1 if out of memory; caller frees *out.
+int column_value_counts(const Column *col, ValueCount **out);
+
+// Most distinct values a string column may have to be dictionary encoded,
+// at load time, by bucket_col and in binary exports (0 = never)
+void set_dictionary_limit(int values);
+int get_dictionary_limit(void);
+
+#endif
@@ -2,7 +2,15 @@
 #define EXPORT_H
 
 #include "fileio.h"
+#include "describe.h"
 
-void export_cleaned_data(const Table *table, const char *filename);
+const char *field_type_to_str(FieldType type);
+bool export_cleaned_data(const Table *table, const char *filename);
+// LZ4 compression of Arrow and Parquet exports; off by default, so Arrow
+// files can be mapped and read without copying
+void set_export_compression(bool lz4);
+bool get_export_compression(void);
+bool is_utf8(const char *text, size_t len);
 void export_stats_csv(const Table *table, const char *filename);
+void export_summary_csv(const Table *table, const ColumnSummary *summary, const char *filename);
 #endif
@@ -3,36 +3,41 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include "column.h"
+#include "mapfile.h"
 
-#define MAX_LINE_LEN 1024
-#define MAX_COLS 100
+// From this many columns on, a row of the CSV index spans more than a page
+// and walking it one column at a time defeats the prefetcher, so load_csv
+// fills adjacent columns together, row by row
+#define WIDE_TABLE_COLS 256
+#define WIDE_BLOCK_COLS 64 // adjacent columns one load task fills
 
-typedef enum
-{
-    TYPE_STRING,
-    TYPE_INT,
-    TYPE_FLOAT,
-    TYPE_BOOL,
-    TYPE_NULL
-} FieldType;
+typedef struct StatsCache StatsCache;
 
 typedef struct
 {
-    char ***data;     // data[row][col] as strings
-    FieldType *types; // inferred type per column
-    int rows;
+    Column *columns; // columns[col], column-major typed storage
+    int rows;        // number of data rows (header excluded)
     int cols;
-    int capacity;   // dynamic row allocation
-    char **headers; // column headers
+    char **headers;  // column headers
+    Arena *arena;    // headers and column storage
+    MappedFile *mapping; // snapshot the columns were loaded from, or NULL
+    StatsCache *stats;   // column summaries kept between calls (statcache.h)
 } Table;
 
+// Encoder for one file format, writing the whole table to fp
+typedef bool (*TableWriter)(const Table *table, FILE *fp);
+
 bool load_csv(Table *table, const char *filename);
 bool save_csv(const Table *table, const char *filepath);
+bool save_csv_atomic(const Table *table, const char *filepath);
+bool write_table_file(const Table *table, const char *path, const char *mode, TableWriter writer, bool atomic);
 int get_column_index(const Table *table, const char *column_name);
+bool table_set_header(Table *table, int col, const char *name);
 void free_table(Table *table);
 FieldType infer_type(const char *str);
-int *get_column_as_int(const Table *table, int col_index);
-float *get_column_as_float(const Table *table, int col_index);
-bool *get_column_as_bool(const Table *table, int col_index);
+bool is_missing(const char *text, size_t len);
+FILE *open_data_file(const char *filename, const char *mode);
+bool map_data_file(MappedFile *mf, const char *filename, bool writable);
 
-#endif // FILEIO_H
\ No newline at end of file
+#endif // FILEIO_H
@@ -0,0 +1,32 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fileio.h"
+
+// Decides whether a row of the table is kept
+typedef bool (*RowPredicate)(const Table *table, int row, void *ctx);
+
+// Keep-bitmaps have one bit per row (bit set = keep), 64 rows per word.
+// Each function removes the other rows from every column in a single
+// stable pass and returns the number of rows removed, or -1 on error.
+int filter_rows(Table *table, RowPredicate keep, void *ctx);
+int filter_rows_mask(Table *table, const uint64_t *keep);
+
+// Drop rows with a null in column `col`, or in any column when col < 0
+int filter_drop_nulls(Table *table, int col);
+
+// Keep only the rows whose value in column `col` equals `text`. Numbers
+// compare by value, other columns by their text; dictionary encoded
+// columns compare one code per row.
+int filter_equals(Table *table, int col, const char *text);
+
+// Building blocks for several conditions applied in one pass: start from a
+// mask keeping every row (caller frees), clear the rows each condition
+// rejects, then hand the mask to filter_rows_mask.
+uint64_t *filter_mask_all(int rows);
+void filter_mask_nulls(const Table *table, int col, uint64_t *mask);
+void filter_mask_equals(const Table *table, int col, const char *text, uint64_t *mask);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef IMPUTE_H
+#define IMPUTE_H
+
+#include <stdbool.h>
+#include "fileio.h"
+
+typedef enum
+{
+    IMPUTE_CONSTANT, // the given value
+    IMPUTE_MEAN,     // numerical columns only
+    IMPUTE_MEDIAN,   // upper median, numerical columns only
+    IMPUTE_MODE,     // most frequent value, earliest on ties
+    IMPUTE_FFILL,    // previous value in the column; leading N/A stay
+    IMPUTE_INVALID   // neither a method nor a constant
+} ImputeMethod;
+
+// One column to fill. The fields after `value` are set by impute_columns.
+typedef struct
+{
+    int col;
+    ImputeMethod method;
+    const char *value;  // IMPUTE_CONSTANT
+    int filled;         // N/A values replaced
+    char fill_text[64]; // value used, empty for forward fill
+    const char *error;  // NULL when the column was filled
+} ImputeSpec;
+
+// "mean", "median", "mode" or "ffill", or a constant: a number, true or
+// false, or any text written as value=TEXT. For a constant *value is set
+// to its text. Other words are IMPUTE_INVALID, so a misspelt method does
+// not turn a column into text.
+ImputeMethod impute_method(const char *name, const char **value);
+
+// Fill every listed column, each in its own task. Returns false if any
+// spec failed; its error says why. A spec with a bad column or value is
+// skipped and the other columns are still filled.
+bool impute_columns(Table *table, ImputeSpec *specs, int count);
+
+// k-th smallest (from 0) of v[0..n), reordering v
+double select_kth(double *v, int n, int k);
+
+#endif
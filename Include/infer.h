@@ -0,0 +1,45 @@
+#ifndef INFER_H
+#define INFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "column.h"
+
+#define DEFAULT_INFER_SAMPLE 4096 // rows sampled per column when loading
+#define MAX_STRAY_PERCENT 10      // text allowed in a numeric column, % of its values
+
+// Type of one cell, as infer_type would give it, without needing a
+// NUL-terminated copy. Plain numbers and booleans are recognised in one
+// table-driven sweep; only unusual text reaches strtol/strtod.
+FieldType classify_field(const char *text, size_t len);
+
+// Narrowest type holding values of both types: null gives way to anything,
+// int widens to float, and any other mix is a string
+FieldType widen_type(FieldType a, FieldType b);
+
+// Cell types seen in a column, numbers apart from the rest, so that a few
+// stray cells of text (a shifted row, a note such as "N/A") do not turn a
+// numeric column into a string one
+typedef struct
+{
+    FieldType numeric; // widened type of the numbers
+    FieldType other;   // widened type of every other value
+    int64_t numbers, others;
+} TypeTally;
+
+void tally_init(TypeTally *t);
+void tally_add(TypeTally *t, FieldType type);
+// The numeric type when the other values are few_strays, else the
+// narrowest type holding every value
+FieldType tally_type(const TypeTally *t);
+// Whether `strays` cells that are not numbers, out of `values`, still leave
+// a column numeric. load_csv reads them as N/A.
+bool few_strays(int64_t strays, int64_t values);
+
+// Number of rows load_csv samples to guess a column type before checking it
+// against every row; 0 infers from every row
+void set_infer_sample(int rows);
+int get_infer_sample(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ4 compression for the binary exporters: the raw block format (Parquet
+// LZ4_RAW pages) and the frame format (Arrow IPC LZ4_FRAME buffers). Fast
+// greedy matching over a 64 KB window; output is decoded by any LZ4
+// implementation. Only compression is provided.
+
+// Largest output of lz4_compress_block / lz4_compress_frame for `size` bytes
+size_t lz4_block_bound(size_t size);
+size_t lz4_frame_bound(size_t size);
+
+// Compress src into dst, which holds at least the bound. Returns the
+// number of bytes written.
+size_t lz4_compress_block(const void *src, size_t size, void *dst);
+size_t lz4_compress_frame(const void *src, size_t size, void *dst);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Read-only view of a whole file. Uses mmap (or a Windows file mapping)
+// and falls back to reading the file into memory when mapping fails.
+typedef struct
+{
+    const char *data;
+    size_t size;
+    bool mapped;        // false when data is a heap copy
+#ifdef _WIN32
+    void *file_handle;
+    void *map_handle;
+#endif
+} MappedFile;
+
+bool map_file(MappedFile *mf, const char *path);
+// Private copy-on-write mapping: the data may be modified in memory and
+// the changes never reach the file
+bool map_file_writable(MappedFile *mf, const char *path);
+void unmap_file(MappedFile *mf);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef NUMFORMAT_H
+#define NUMFORMAT_H
+
+#include <stdint.h>
+
+#define NUMBER_TEXT_LEN 32 // room for any formatted int64 or double
+
+// Write a number into buf (at least NUMBER_TEXT_LEN bytes), NUL-terminated,
+// and return its length. Doubles get the fewest significant digits that
+// read back as the same value, laid out like printf's %g: fixed notation
+// for moderate magnitudes, exponent notation otherwise.
+int format_int64(int64_t v, char *buf);
+int format_double(double v, char *buf);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef NUMPARSE_H
+#define NUMPARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parse a whole field (not NUL-terminated) as a number. The results are
+// those of strtoll/strtod in the C locale; false if any byte is left over.
+// Plain decimal text is handled here, eight digits at a time; anything
+// unusual (hex, inf/nan, leading spaces, long mantissas or large exponents)
+// is handed to libc, so every result is correctly rounded.
+bool parse_int64(const char *text, size_t len, int64_t *out);
+bool parse_double(const char *text, size_t len, double *out);
+
+// Time parse_int64/parse_double against strtoll/strtod on `count` generated
+// fields of each kind and print the results
+void numparse_benchmark(int count);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef PARQUET_H
+#define PARQUET_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "fileio.h"
+
+#define PARQUET_PAGE_ROWS 65536 // rows per data page
+
+// Write a table as a Parquet file with one row group. Columns are optional
+// INT64, DOUBLE, BOOLEAN or BYTE_ARRAY (annotated as UTF-8 strings when
+// valid), written as plain-encoded data pages with RLE definition levels
+// and min/max statistics for numbers. Low-cardinality string columns get a
+// dictionary page and bit-packed indices. With export compression on,
+// pages are LZ4_RAW compressed. Column chunks are encoded in parallel.
+bool parquet_write_table(const Table *table, FILE *fp);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "fileio.h"
+
+#define MAX_PIPELINE_STEPS 64
+
+typedef enum
+{
+    STEP_LOAD,    // load FILE (CSV or snapshot)
+    STEP_FILL_NA, // fill_na COL METHOD (mean, median, mode, ffill, a number, true/false or value=TEXT)
+    STEP_DROP_NA, // drop_na [COL] (any column when none is given)
+    STEP_KEEP,    // keep COL VALUE: rows where the column equals the value
+    STEP_SCALE,   // scale_to_range COL A B
+    STEP_BUCKET,  // bucket_col COL BUCKETS
+    STEP_EXPORT   // export FILE [COL...] (.csv, .arrow/.feather, .parquet)
+} StepKind;
+
+typedef struct
+{
+    StepKind kind;
+    const char *column; // header name or index, NULL for every column
+    const char *text;   // file name, fill method or value
+    double a, b;
+    int buckets;
+    int ncolumns;       // export: columns listed, `column` being the first
+} PipelineStep;
+
+// A non-interactive run: one load followed by preprocessing steps and
+// exports. Steps are separated by ';', '|', "->" or new lines, arguments by
+// spaces, commas or parentheses, so "load big.csv -> fill_na(score, median)
+// -> drop_na -> export out.parquet" and a script with one step per line
+// both work. Quote arguments holding spaces; '#' starts a comment.
+typedef struct
+{
+    char *buffer; // the tokenized spec, which the steps point into
+    PipelineStep steps[MAX_PIPELINE_STEPS];
+    int count;
+} Pipeline;
+
+bool pipeline_parse(Pipeline *p, const char *spec);
+bool pipeline_parse_file(Pipeline *p, const char *path);
+
+// Load the table, then record the other steps as a query plan (plan.h)
+// and run it, so filters apply before transforms, scans are shared and
+// columns no export needs are skipped. Prints the time and row counts of
+// every action the plan took. Returns false at the first failure.
+bool pipeline_run(const Pipeline *p);
+void pipeline_free(Pipeline *p);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdbool.h>
+#include "fileio.h"
+#include "data_preparation.h"
+
+#define MAX_PLAN_OPS 64
+#define MAX_PLAN_CHAIN 8    // scale/bucket steps one column can hold back
+#define MAX_PLAN_ACTIONS 256
+
+typedef enum
+{
+    OP_FILL_NA,
+    OP_DROP_NA,
+    OP_KEEP,
+    OP_SCALE,
+    OP_BUCKET,
+    OP_EXPORT
+} PlanOpKind;
+
+typedef struct
+{
+    PlanOpKind kind;
+    int col;            // -1 for every column (drop_na)
+    const char *text;   // fill method, value to keep or file name
+    double a, b;        // scale target range
+    int buckets;
+    const int *columns; // export: columns to write, every column when NULL
+    int ncolumns;
+    bool dead;          // nothing exported depends on it
+} PlanOp;
+
+// One piece of work the plan actually did, for the timing table
+typedef struct
+{
+    const char *name;
+    int ops;            // recorded steps it carries out
+    int rows_in, rows_out;
+    double ms;
+} PlanAction;
+
+// Steps recorded against a loaded table and run together by plan_run.
+// Recording does no work; at run time the plan
+//   - drops steps and columns no export depends on,
+//   - folds consecutive drop_na/keep steps into one keep-mask that is
+//     applied lazily, so transforms run on the rows that survive,
+//   - holds back scale/bucket steps of numeric columns as a chain of maps,
+//     finding the ranges they need in one shared scan and applying the
+//     whole chain in one pass per column, the columns in parallel,
+// and gives the same result as running the steps one by one.
+typedef struct
+{
+    Table *table;
+    PlanOp ops[MAX_PLAN_OPS];
+    int count;
+    PlanAction actions[MAX_PLAN_ACTIONS];
+    int nactions;
+} Plan;
+
+void plan_init(Plan *plan, Table *table);
+bool plan_fill_na(Plan *plan, int col, const char *method);
+bool plan_drop_na(Plan *plan, int col);
+bool plan_keep(Plan *plan, int col, const char *value);
+bool plan_scale(Plan *plan, int col, double a, double b);
+bool plan_bucket(Plan *plan, int col, int buckets);
+bool plan_export(Plan *plan, const char *filename, const int *columns, int ncolumns);
+
+// Run the recorded steps. Returns false at the first failure; the actions
+// done so far stay in plan->actions.
+bool plan_run(Plan *plan);
+
+#endif
@@ -8,7 +8,10 @@
 void isna(const Table *table);
 void find_na(const Table *table, int col);
 void fill_na(Table *table, int col, const char *val);
+void fill_na_columns(Table *table, const int *cols, int count, const char *val);
 void drop_na(Table *table, int col);
+void drop_na_any(Table *table);
+void keep_equal(Table *table, int col, const char *val);
 void convert_to_num(Table *table, int col);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PROFILE_BATCH_BYTES (4 << 20) // input read per batch
+
+// Profile a CSV file in one pass without building a Table. Only one batch
+// of input is held at a time (more only while a single row is longer than
+// the batch), so files larger than memory work. Writes the columns of
+// export_stats_csv plus a null count and sketched quartiles per column.
+bool profile_csv_stream(const char *filename, const char *stats_path, size_t batch_bytes);
+
+#endif
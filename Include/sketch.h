@@ -0,0 +1,41 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// KLL quantile sketch. Values sit in levels; an item on level h stands for
+// 2^h inputs. When the sketch is full, its lowest full level is sorted and
+// every other item moves one level up, so memory stays around 3k values
+// whatever the input size and the rank error is about 2/k of the count. Sketches built over
+// separate parts of the data can be merged. k = 0 keeps every value, which
+// makes all answers exact.
+typedef struct
+{
+    int k;
+    int levels;
+    double **items; // items[h]: values of weight 2^h
+    int *sizes;
+    int *caps;      // allocated length of items[h]
+    int size;       // values retained over all levels
+    int max_size;   // a level is compacted once size reaches this
+    int64_t n;      // values added
+    uint64_t rng;   // picks which half of a level survives a compaction
+} QuantileSketch;
+
+bool sketch_init(QuantileSketch *s, int k);
+void sketch_free(QuantileSketch *s);
+bool sketch_add(QuantileSketch *s, double value);
+bool sketch_merge(QuantileSketch *dst, const QuantileSketch *src);
+
+// Value of the given 0-based rank in sorted order (exact when k = 0)
+double sketch_value_at(const QuantileSketch *s, int64_t rank);
+// Value at rank q * (n - 1), the definition calculate_quantile uses
+double sketch_quantile(const QuantileSketch *s, double q);
+// Several quantiles with a single sort of the retained values
+void sketch_quantiles(const QuantileSketch *s, const double *qs, double *out, int count);
+
+// Smallest k whose rank error stays within eps (0 or less means exact)
+int sketch_k_for_error(double eps);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include "fileio.h"
+#include "describe.h"
+
+#define SNAPSHOT_MAGIC "CSVSNAP"
+#define SNAPSHOT_VERSION 2
+
+// Binary image of a loaded table: headers, typed column vectors, validity
+// bitmaps and the stats of every column, each section aligned so that the
+// file can be mapped and used in place. Loading maps the file copy-on-write
+// and points the columns straight into it, so reopening costs a few page
+// faults rather than a parse; edits stay in memory. Dictionary encoded
+// columns are saved as their codes and unique values. Snapshots are only
+// read back on the machine type that wrote them.
+bool snapshot_save(const Table *table, const char *path);
+
+// Load a snapshot into `table`. If `stats` is given it receives the saved
+// per-column stats (caller frees), matching describe_table(table, 0).
+bool snapshot_load(Table *table, const char *path, ColumnSummary **stats);
+
+// True if the file starts with the snapshot magic
+bool is_snapshot(const char *path);
+
+#endif
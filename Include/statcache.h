@@ -0,0 +1,30 @@
+#ifndef STATCACHE_H
+#define STATCACHE_H
+
+#include <stdbool.h>
+#include "describe.h"
+
+// Column summaries kept with a table between calls, so print_stats,
+// export_stats_csv, find_outlier and mean fills after one another describe
+// each column once. Operations that change a column mark its entry stale,
+// and only stale columns are described again the next time they are
+// asked for. Entries hold the DESCRIBE_* flags they were made with; asking
+// for quartiles redoes entries made without them. Not thread-safe: call
+// from the thread that owns the table.
+
+// Summary of every column, computing only the stale ones (in parallel).
+// The array belongs to the table and lasts until the next change; NULL
+// when out of memory.
+const ColumnSummary *table_summaries(const Table *table, int flags);
+const ColumnSummary *table_column_summary(const Table *table, int col, int flags);
+
+// Summary of a column if the cache holds a current one, else NULL
+const ColumnSummary *table_cached_summary(const Table *table, int col);
+
+// Column `col` changed, or every column when col < 0 (rows removed)
+void table_stats_changed(Table *table, int col);
+// Take summaries computed elsewhere, such as those stored in a snapshot
+void table_stats_seed(Table *table, const ColumnSummary *summary, int flags);
+void table_stats_free(Table *table);
+
+#endif
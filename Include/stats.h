@@ -6,12 +6,37 @@
 #include <string.h>
 #include <math.h>
 #include "fileio.h"
+#include "sketch.h"
+#include "describe.h"
 
-double calculate_mean(float *vals, int size);
-double calculate_sd(float *vals, int size);
-double calculate_min(float *vals, int size);
-double calculate_max(float *vals, int size);
-double calculate_quantile(float *vals, int size, double quantile);
+#define DEFAULT_QUANTILE_ERROR 0.005 // rank error of quantile sketches
+// Tall columns are summarized in pieces of this many rows, in parallel,
+// and the pieces merged in order. The size is fixed so that results do not
+// depend on the number of threads.
+#define SKETCH_CHUNK_ROWS 65536
+
+double calculate_mean(const Column *col);
+double calculate_sd(const Column *col);
+double calculate_min(const Column *col);
+double calculate_max(const Column *col);
+double calculate_quantile(const Column *col, double quantile);
+
+// Rank error allowed in quantiles; 0 makes them exact
+void set_quantile_error(double eps);
+double get_quantile_error(void);
+bool column_sketch(const Column *col, QuantileSketch *s);
+
+// A row (counted from 1) and its value
+typedef struct
+{
+    int row;
+    double value;
+} RowValue;
+
+// Rows whose number lies outside [lo, hi], and above 0 with positive_only,
+// in row order. Returns how many, or -1 when out of memory; the caller
+// frees *out.
+int column_values_outside(const Column *col, double lo, double hi, bool positive_only, RowValue **out);
 void print_info(const Table *table);
 void print_stats(const Table *table);
 void export_stats_csv(const Table *table, const char *filename);
@@ -0,0 +1,26 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdbool.h>
+
+typedef void (*TaskFn)(void *arg);
+typedef void (*ParallelFn)(int index, void *ctx);
+
+typedef struct ThreadPool ThreadPool;
+
+ThreadPool *threadpool_create(int threads);
+bool threadpool_submit(ThreadPool *pool, TaskFn fn, void *arg);
+void threadpool_wait(ThreadPool *pool);
+void threadpool_destroy(ThreadPool *pool);
+
+// Number of threads used by parallel_for; 0 means one per CPU
+void set_thread_count(int threads);
+int get_thread_count(void);
+
+// Run fn(i, ctx) for every i in [0, count) on the shared pool and wait.
+// Indices are handed out dynamically, so uneven tasks still balance. Calls
+// may nest: a task can split its own work with parallel_for, and idle
+// threads steal the pieces.
+void parallel_for(int count, ParallelFn fn, void *ctx);
+
+#endif
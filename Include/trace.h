@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    TRACE_BYTES_READ,
+    TRACE_BYTES_WRITTEN,
+    TRACE_ROWS_PARSED,
+    TRACE_CELLS,        // table cells allocated by loads
+    TRACE_ALLOCATIONS,  // arena and column buffer allocations
+    TRACE_COUNTERS
+} TraceCounter;
+
+// Instrumentation of the stages of a run: named scopes with their start,
+// duration, the counters they moved and the peak resident memory, kept
+// per thread and nested. It is off until trace_enable; then every call is
+// a flag test and nothing more.
+void trace_enable(const char *report, const char *chrome);
+bool trace_enabled(void);
+
+// Open a scope; returns a handle for trace_end, -1 when tracing is off.
+// The name is copied.
+int trace_begin(const char *name);
+void trace_end(int scope);
+void trace_add(TraceCounter counter, int64_t amount);
+
+// Run `call` inside a scope called `name`
+#define TRACE_CALL(name, call)                \
+    do {                                      \
+        int trace_scope_ = trace_begin(name); \
+        call;                                 \
+        trace_end(trace_scope_);              \
+    } while (0)
+
+// Write the files given to trace_enable: a JSON report of the scopes and
+// counter totals, and a Chrome trace-event file (chrome://tracing or
+// Perfetto). Called at exit once tracing is on.
+void trace_finish(void);
+
+// Peak resident memory of the process in KB, -1 when unknown. Only Linux
+// can start a new peak; elsewhere it covers the whole run so far.
+long peak_memory_kb(void);
+void reset_peak_memory(void);
+
+#endif
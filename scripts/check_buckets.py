@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""Check that bucketing leaves NaN and infinities out of the buckets.
+
+A small column of numbers mixed with nan, inf and -inf is bucketed three
+ways: by bucket_col from the menu (with the stats computed first, so the
+range comes from the stats cache), by a pipeline bucket step, and by a
+pipeline that scales the column before bucketing it. Every finite value
+must get the label of its bucket over the finite range, and every
+non-finite value must come out empty (N/A).
+
+    python3 scripts/check_buckets.py src_code/csv_tool.exe
+
+Exits with 1 if any result differs.
+"""
+import csv
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+VALUES = ["1", "nan", "inf", "5", "-inf", "3", "", "2.5", "4.99"]
+BUCKETS = 2
+
+
+def expected_labels(values, lo, hi):
+    finite = [float(v) for v in values if v and math.isfinite(float(v))]
+    vmin, vmax = min(finite), max(finite)
+    labels = []
+    for v in values:
+        if not v or not math.isfinite(float(v)):
+            labels.append("")
+            continue
+        # The same map a scale step applies, then the bucket of the result
+        x = lo + (float(v) - vmin) * (hi - lo) / (vmax - vmin) if lo is not None else float(v)
+        a, b = (lo, hi) if lo is not None else (vmin, vmax)
+        width = (b - a) / BUCKETS
+        idx = min(max(math.floor((x - a) / width), 0), BUCKETS - 1)
+        start = a + idx * width
+        labels.append(f"[{start:.2f}-{start + width:.2f})")
+    return labels
+
+
+def exported_column(path):
+    with open(path, newline="") as f:
+        return [row[1] if len(row) > 1 else "" for row in list(csv.reader(f))[1:]]
+
+
+def compare(what, got, expected):
+    if got == expected:
+        print(f"{what}: same")
+        return True
+    print(f"{what}: differs\n  tool:     {got}\n  expected: {expected}")
+    return False
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__.strip())
+        return 2
+    tool = os.path.abspath(sys.argv[1])
+    ok = True
+    with tempfile.TemporaryDirectory() as tmp:
+        data = os.path.join(tmp, "values.csv")
+        with open(data, "w") as f:
+            f.write("id,v\n" + "".join(f"{i},{v}\n" for i, v in enumerate(VALUES)))
+
+        pipelines = [
+            ("pipeline bucket", f"bucket v {BUCKETS}", None, None),
+            ("pipeline scale + bucket", f"scale v 0 10 -> bucket v {BUCKETS}", 0.0, 10.0),
+        ]
+        for what, steps, lo, hi in pipelines:
+            out = os.path.join(tmp, "out.csv")
+            run = subprocess.run([tool, "--pipeline", f"load {data} -> {steps} -> export {out}"],
+                                 capture_output=True, text=True)
+            if run.returncode != 0:
+                print(f"{what}: the tool failed\n{run.stdout}{run.stderr}")
+                ok = False
+                continue
+            ok = compare(what, exported_column(out), expected_labels(VALUES, lo, hi)) and ok
+
+        # The menu writes its output to ../Data, relative to where it runs
+        work = os.path.join(tmp, "run")
+        os.makedirs(work)
+        os.makedirs(os.path.join(tmp, "Data"))
+        keys = f"{data}\n2\nb\nx\n5\na\n1\n{BUCKETS}\nx\n6\n"
+        run = subprocess.run([tool], input=keys, capture_output=True, text=True, cwd=work, timeout=60)
+        out = os.path.join(tmp, "Data", "output_cleaned.csv")
+        if run.returncode != 0 or not os.path.exists(out):
+            print(f"menu bucket_col: the tool failed\n{run.stdout[-2000:]}{run.stderr}")
+            ok = False
+        else:
+            ok = compare("menu bucket_col", exported_column(out), expected_labels(VALUES, None, None)) and ok
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Check that the tool reads CSV files the way Python's csv module does.
+
+Each file is loaded and exported again with the tool's pipeline mode, and
+the export is compared, row by row and field by field, with what
+csv.reader makes of the original. Numbers are compared by value, since
+the export writes them in shortest form. Empty fields and missing ones
+count as equal, and so does an empty field for text the csv module found
+in its place: that is stray text the tool read as N/A in a numeric
+column. Fields past the header are ignored, since the tool keeps the
+header's width.
+
+    python3 scripts/check_parse.py src_code/csv_tool.exe Data/book.csv [more.csv ...]
+
+Exits with 1 if any file differs.
+"""
+import csv
+import os
+import subprocess
+import sys
+import tempfile
+
+
+def read_rows(path):
+    with open(path, newline="", encoding="utf-8", errors="surrogateescape") as f:
+        return list(csv.reader(f))
+
+
+def normalise(row, width):
+    row = row[:width] + [""] * (width - len(row))
+    return ["" if field.isspace() else field for field in row]
+
+
+def number(text):
+    try:
+        return float(text)
+    except ValueError:
+        return None
+
+
+def same_field(got, expected):
+    if got == expected:
+        return True
+    if got == "":
+        return number(expected) is None
+    a, b = number(got), number(expected)
+    return a is not None and a == b
+
+
+def same_row(got, expected, width):
+    return all(same_field(a, b) for a, b in zip(normalise(got, width), normalise(expected, width)))
+
+
+def check(tool, path):
+    expected = read_rows(path)
+    with tempfile.TemporaryDirectory() as tmp:
+        out = os.path.join(tmp, "parsed.csv")
+        run = subprocess.run([tool, "--pipeline", f"load {os.path.abspath(path)} -> export {out}"],
+                             capture_output=True, text=True)
+        if run.returncode != 0 or not os.path.exists(out):
+            print(f"{path}: the tool failed\n{run.stdout}{run.stderr}")
+            return False
+        got = read_rows(out)
+
+    width = len(expected[0]) if expected else 0
+    ok = True
+    if len(got) != len(expected):
+        print(f"{path}: {len(got) - 1} data rows, csv module {len(expected) - 1}")
+        ok = False
+    for i, (a, b) in enumerate(zip(got, expected)):
+        if not same_row(a, b, width):
+            print(f"{path}: row {i} differs\n  tool: {a[:width]}\n  csv:  {b[:width]}")
+            ok = False
+            break
+    if ok:
+        print(f"{path}: {len(got) - 1} data rows, same as the csv module")
+    return ok
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__.strip())
+        return 2
+    tool = sys.argv[1]
+    results = [check(tool, path) for path in sys.argv[2:]]
+    return 0 if all(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
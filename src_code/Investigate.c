@@ -1,7 +1,11 @@
 #include <stdio.h>
-#include "investigate.h"
+#include <stdlib.h>
+#include "Investigate.h"
 #include "fileio.h"
-#include "stats.h" // For get_column_as_float
+#include "stats.h"
+#include "statcache.h"
+#include "dictionary.h"
+#include "threadpool.h"
 
 void print_column(const Table *table) {
     if (!table || !table->headers) {
@@ -19,12 +23,7 @@ void count_isna(const Table *table, int col) {
         printf("Invalid column index or table.\n");
         return;
     }
-    int count = 0;
-    for (int i = 0; i < table->rows; i++) {
-        if (table->data[i] && table->data[i][col] && strcmp(table->data[i][col], "N/A") == 0) {
-            count++;
-        }
-    }
+    int count = column_null_count(&table->columns[col]);
     printf("Column %d (%s) has %d N/A values.\n", col, table->headers[col], count);
 }
 
@@ -33,17 +32,42 @@ void na_count(const Table *table) {
         printf("Invalid table.\n");
         return;
     }
-    int total_na = 0;
-    for (int i = 0; i < table->rows; i++) {
-        for (int j = 0; j < table->cols; j++) {
-            if (table->data[i] && table->data[i][j] && strcmp(table->data[i][j], "N/A") == 0) {
-                total_na++;
-            }
-        }
+    int *counts = count_nulls(table);
+    if (!counts) {
+        printf("Error: Memory allocation failed.\n");
+        return;
     }
+    int total_na = 0;
+    for (int j = 0; j < table->cols; j++) total_na += counts[j];
+    free(counts);
     printf("Total number of N/A values across the table: %d\n", total_na);
 }
 
+// Outliers of one column, found by its own task
+typedef struct
+{
+    RowValue *rows;
+    int count; // -1 when out of memory
+} ColumnOutliers;
+
+typedef struct
+{
+    const Table *table;
+    const ColumnSummary *summary; // quartiles of every column
+    ColumnOutliers *found;
+} OutlierJob;
+
+static void outlier_task(int j, void *ctx) {
+    OutlierJob *job = ctx;
+    const Column *col = &job->table->columns[j];
+    if (!column_is_numeric(col) || col->length == 0) return;
+    double q1 = job->summary[j].quartiles[0], q3 = job->summary[j].quartiles[2];
+    double iqr = q3 - q1;
+    double lower_bound = q1 - 1.5 * iqr;
+    double upper_bound = q3 + 1.5 * iqr;
+    job->found[j].count = column_values_outside(col, lower_bound, upper_bound, true, &job->found[j].rows);
+}
+
 void find_outlier(const Table *table) {
     if (!table) {
         printf("Invalid table.\n");
@@ -52,36 +76,58 @@ void find_outlier(const Table *table) {
     printf("\nOutlier Detection (using IQR method) for numerical columns\n");
     printf("Column Id  Column Name  Row Index  Outlier Value\n");
 
+    // Columns are searched in parallel and reported in order
+    OutlierJob job = {table, table_summaries(table, DESCRIBE_QUARTILES),
+                      calloc(table->cols > 0 ? table->cols : 1, sizeof(ColumnOutliers))};
+    if (!job.summary || !job.found) {
+        printf("Error: Memory allocation failed.\n");
+        free(job.found);
+        return;
+    }
+    parallel_for(table->cols, outlier_task, &job);
     for (int j = 0; j < table->cols; j++) {
-        if (table->types[j] == TYPE_INT || table->types[j] == TYPE_FLOAT) {
-            float *vals = get_column_as_float(table, j);
-            int size = table->rows - 1;
-            if (size > 0) {
-                double q1 = calculate_quantile(vals, size, 0.25);
-                double q3 = calculate_quantile(vals, size, 0.75);
-                double iqr = q3 - q1;
-                double lower_bound = q1 - 1.5 * iqr;
-                double upper_bound = q3 + 1.5 * iqr;
-
-                bool has_outliers = false;
-                for (int i = 0; i < size; i++) {
-                    if (!isnan(vals[i]) && (vals[i] < lower_bound || vals[i] > upper_bound) && vals[i] > 0) {
-                        if (!has_outliers) {
-                            printf("%-10d %-11s %-9d %-12.2f\n", j, table->headers[j], i + 1, vals[i]);
-                            has_outliers = true;
-                        } else {
-                            printf("%-10s %-11s %-9d %-12.2f\n", "", "", i + 1, vals[i]);
-                        }
-                    }
-                }
-                // No "None" row if no outliers > 0 are found
+        const ColumnOutliers *found = &job.found[j];
+        if (found->count < 0) printf("Error: Memory allocation failed for column %d.\n", j);
+        for (int i = 0; i < found->count; i++) {
+            if (i == 0) {
+                printf("%-10d %-11s %-9d %-12.2f\n", j, table->headers[j], found->rows[i].row, found->rows[i].value);
+            } else {
+                printf("%-10s %-11s %-9d %-12.2f\n", "", "", found->rows[i].row, found->rows[i].value);
             }
-            free(vals);
         }
+        // No "None" row if no outliers > 0 are found
+        free(found->rows);
     }
+    free(job.found);
 }
 void list_columns(const Table *table) {
     for (int i = 0; i < table->cols; i++) {
         printf("[%d] %s\n", i, table->headers[i]);
     }
-}
\ No newline at end of file
+}
+// Most frequent values of a column, with their counts
+void value_counts(const Table *table, int col, int top) {
+    if (!table || col < 0 || col >= table->cols) {
+        printf("Invalid column index or table.\n");
+        return;
+    }
+    const Column *column = &table->columns[col];
+    ValueCount *values;
+    int n = column_value_counts(column, &values);
+    if (n < 0) {
+        printf("Error: Memory allocation failed.\n");
+        return;
+    }
+    printf("\nColumn %d (%s): %d distinct values%s\n", col, table->headers[col], n,
+           column->codes ? " (dictionary encoded)" : "");
+    printf("%-30s %10s %8s\n", "Value", "Count", "Share");
+    char buf[64];
+    for (int k = 0; k < n && k < top; k++) {
+        const char *text = column_text(column, values[k].row, buf, sizeof(buf));
+        printf("%-30s %10d %7.2f%%\n", text, values[k].count, 100.0 * values[k].count / table->rows);
+    }
+    if (n > top) printf("... %d more\n", n - top);
+    int nulls = column_null_count(column);
+    if (nulls > 0) printf("%-30s %10d %7.2f%%\n", "N/A", nulls, 100.0 * nulls / table->rows);
+    free(values);
+}
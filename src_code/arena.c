@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "trace.h"
+
+#define ARENA_ALIGN 16
+#define MIN_CLASS_SIZE 16
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t size;
+    // allocations follow, aligned to ARENA_ALIGN
+};
+
+#define BLOCK_HEADER ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Size classes run 16, 20, 24, 28, 32, 40, 48, 56, 64, ...: four steps
+// between consecutive powers of two
+static int size_class(size_t size, size_t *class_size) {
+    if (size <= MIN_CLASS_SIZE) {
+        *class_size = MIN_CLASS_SIZE;
+        return 0;
+    }
+    int e = 0;
+    while (((size - 1) >> e) > 1) e++; // 2^e <= size - 1 < 2^(e + 1)
+    size_t step = (size_t)1 << (e - 2);
+    size_t steps = (size - 1) / step + 1; // 5..8
+    *class_size = steps * step;
+    return (e - 4) * 4 + (int)(steps - 4);
+}
+
+size_t arena_class_size(size_t size) {
+    size_t class_size;
+    size_class(size, &class_size);
+    return class_size;
+}
+
+Arena *arena_create(void) {
+    Arena *arena = calloc(1, sizeof(Arena));
+    if (!arena) return NULL;
+    pthread_mutex_init(&arena->lock, NULL);
+    return arena;
+}
+
+void arena_destroy(Arena *arena) {
+    if (!arena) return;
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    pthread_mutex_destroy(&arena->lock);
+    free(arena);
+}
+
+static ArenaBlock *new_block(Arena *arena, size_t size) {
+    ArenaBlock *block = malloc(BLOCK_HEADER + size);
+    if (!block) return NULL;
+    block->size = size;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->reserved += BLOCK_HEADER + size;
+    return block;
+}
+
+// Caller holds the lock
+static void *bump(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        // Large requests get a block of their own and leave the current one alone
+        ArenaBlock *block = new_block(arena, size);
+        return block ? (char *)block + BLOCK_HEADER : NULL;
+    }
+    if ((size_t)(arena->end - arena->cursor) < size) {
+        ArenaBlock *block = new_block(arena, ARENA_BLOCK_SIZE);
+        if (!block) return NULL;
+        arena->cursor = (char *)block + BLOCK_HEADER;
+        arena->end = arena->cursor + ARENA_BLOCK_SIZE;
+    }
+    void *p = arena->cursor;
+    arena->cursor += size;
+    return p;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    trace_add(TRACE_ALLOCATIONS, 1);
+    pthread_mutex_lock(&arena->lock);
+    void *p = bump(arena, size);
+    pthread_mutex_unlock(&arena->lock);
+    return p;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    size_t len = strlen(str);
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy) memcpy(copy, str, len + 1);
+    return copy;
+}
+
+void *arena_alloc_pooled(Arena *arena, size_t size) {
+    size_t class_size;
+    int c = size_class(size, &class_size);
+    trace_add(TRACE_ALLOCATIONS, 1);
+    pthread_mutex_lock(&arena->lock);
+    void *p = arena->pools[c];
+    if (p) arena->pools[c] = *(void **)p;
+    else p = bump(arena, class_size);
+    pthread_mutex_unlock(&arena->lock);
+    return p;
+}
+
+void arena_release(Arena *arena, void *ptr, size_t size) {
+    if (!ptr) return;
+    size_t class_size;
+    int c = size_class(size, &class_size);
+    pthread_mutex_lock(&arena->lock);
+    *(void **)ptr = arena->pools[c];
+    arena->pools[c] = ptr;
+    pthread_mutex_unlock(&arena->lock);
+}
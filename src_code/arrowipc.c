@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arrowipc.h"
+#include "dictionary.h"
+#include "export.h"
+#include "lz4.h"
+#include "threadpool.h"
+
+#define ARROW_MAGIC "ARROW1"
+#define IPC_ALIGN 8
+#define METADATA_V5 4
+
+// Message header and type union members, as numbered in Message.fbs / Schema.fbs
+enum { HEADER_SCHEMA = 1, HEADER_DICTIONARY_BATCH = 2, HEADER_RECORD_BATCH = 3 };
+enum {
+    ARROW_NULL = 1, ARROW_INT = 2, ARROW_FLOAT = 3, ARROW_BINARY = 4, ARROW_UTF8 = 5,
+    ARROW_BOOL = 6, ARROW_LARGE_BINARY = 19, ARROW_LARGE_UTF8 = 20
+};
+
+/* =========================================================
+ * Flatbuffer building
+ * Objects are laid out front to back: a table is written with empty
+ * offset fields, and whatever they point to is written after it and
+ * linked in, so every offset points forward as the format requires.
+ * ======================================================= */
+typedef struct
+{
+    uint8_t *data;
+    size_t len, cap;
+    bool failed;
+} Flat;
+
+typedef struct
+{
+    int id;         // field number in the schema
+    int size;       // 1, 2, 4 or 8 for scalars; 0 for an offset linked later
+    uint64_t value;
+} FlatField;
+
+// Zeroed space for n bytes at an `align` boundary; returns its position
+static size_t flat_reserve(Flat *fb, size_t n, size_t align) {
+    size_t pos = (fb->len + align - 1) & ~(align - 1);
+    if (pos + n > fb->cap) {
+        size_t cap = fb->cap ? fb->cap * 2 : 1024;
+        while (cap < pos + n) cap *= 2;
+        uint8_t *data = realloc(fb->data, cap);
+        if (!data) {
+            fb->failed = true;
+            return 0;
+        }
+        memset(data + fb->cap, 0, cap - fb->cap);
+        fb->data = data;
+        fb->cap = cap;
+    }
+    fb->len = pos + n;
+    return pos;
+}
+
+static void flat_put(Flat *fb, size_t pos, uint64_t value, int size) {
+    if (fb->failed) return;
+    for (int i = 0; i < size; i++) fb->data[pos + i] = (uint8_t)(value >> (8 * i));
+}
+
+// Point the offset field at `slot` to the object at `target`
+static void flat_link(Flat *fb, size_t slot, size_t target) {
+    flat_put(fb, slot, target - slot, 4);
+}
+
+// Vtable followed by the table. slots[i] receives the position of fields[i].
+static size_t flat_table(Flat *fb, const FlatField *fields, int count, size_t *slots) {
+    int slots_used = 0;
+    for (int i = 0; i < count; i++) {
+        if (fields[i].id + 1 > slots_used) slots_used = fields[i].id + 1;
+    }
+    size_t vtable = flat_reserve(fb, 4 + 2 * (size_t)slots_used, 2);
+    size_t table = flat_reserve(fb, 4, 8);
+    for (int i = 0; i < count; i++) {
+        int size = fields[i].size ? fields[i].size : 4;
+        size_t pos = flat_reserve(fb, (size_t)size, (size_t)size);
+        flat_put(fb, pos, fields[i].value, size);
+        flat_put(fb, vtable + 4 + 2 * (size_t)fields[i].id, pos - table, 2);
+        if (slots) slots[i] = pos;
+    }
+    flat_put(fb, vtable, 4 + 2 * (uint64_t)slots_used, 2);
+    flat_put(fb, vtable + 2, fb->len - table, 2);
+    flat_put(fb, table, table - vtable, 4);
+    return table;
+}
+
+// Vector of count elements, each elem_size bytes; returns the position of
+// its length, with the zeroed elements following
+static size_t flat_vector(Flat *fb, size_t count, size_t elem_size, size_t align) {
+    if (align < 4) align = 4;
+    // The elements, not the length, get the alignment
+    size_t pos = (fb->len + 4 + align - 1) / align * align - 4;
+    flat_reserve(fb, pos - fb->len, 1);
+    pos = flat_reserve(fb, 4 + count * elem_size, 4);
+    flat_put(fb, pos, count, 4);
+    return pos;
+}
+
+static size_t flat_string(Flat *fb, const char *s) {
+    size_t len = strlen(s);
+    size_t pos = flat_vector(fb, len + 1, 1, 4);
+    if (!fb->failed) memcpy(fb->data + pos + 4, s, len);
+    flat_put(fb, pos, len, 4);
+    return pos;
+}
+
+static void flat_root(Flat *fb) {
+    flat_reserve(fb, 4, 4); // offset to the root table, linked by the caller
+}
+
+/* =========================================================
+ * Column encoding
+ * ======================================================= */
+typedef struct
+{
+    const void *data;
+    int64_t length;
+    void *owned; // freed once written
+} IpcBuffer;
+
+typedef struct
+{
+    int type;              // ARROW_*, the value type when dictionary encoded
+    int64_t null_count;
+    IpcBuffer buffers[3];
+    int buffer_count;
+    bool dictionary;
+    int64_t dict_length;   // values in the dictionary
+    IpcBuffer dict_buffers[3];
+    bool failed;
+} IpcColumn;
+
+typedef struct
+{
+    const Table *table;
+    IpcColumn *columns;
+    bool compress;
+    int dict_limit;
+} IpcJob;
+
+static void add_buffer(IpcBuffer *list, int *count, const void *data, int64_t length, void *owned) {
+    list[*count] = (IpcBuffer){data, length, owned};
+    (*count)++;
+}
+
+// Offsets and bytes of an Arrow string array holding `count` values.
+// get(i) gives value i or NULL for a null.
+typedef const char *(*ValueFn)(const Column *col, const Dictionary *dict, int i);
+
+static const char *row_value(const Column *col, const Dictionary *dict, int i) {
+    (void)dict;
+    return column_get_string(col, i);
+}
+
+static const char *dict_entry(const Column *col, const Dictionary *dict, int k) {
+    (void)col;
+    return dictionary_value(dict, k);
+}
+
+static bool encode_strings(const Column *col, const Dictionary *dict, int count, ValueFn get,
+                           IpcBuffer *buffers, int *type) {
+    int64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        const char *s = get(col, dict, i);
+        if (s) total += (int64_t)strlen(s);
+    }
+    bool large = total > INT32_MAX;
+    size_t width = large ? sizeof(int64_t) : sizeof(int32_t);
+    uint8_t *offsets = malloc(((size_t)count + 1) * width);
+    char *data = malloc(total > 0 ? (size_t)total : 1);
+    if (!offsets || !data) {
+        free(offsets);
+        free(data);
+        return false;
+    }
+    int64_t pos = 0;
+    for (int i = 0; i <= count; i++) {
+        if (large) ((int64_t *)offsets)[i] = pos;
+        else ((int32_t *)offsets)[i] = (int32_t)pos;
+        const char *s = i < count ? get(col, dict, i) : NULL;
+        if (s) {
+            size_t len = strlen(s);
+            memcpy(data + pos, s, len);
+            pos += (int64_t)len;
+        }
+    }
+    bool text = is_utf8(data, (size_t)total);
+    *type = text ? (large ? ARROW_LARGE_UTF8 : ARROW_UTF8) : (large ? ARROW_LARGE_BINARY : ARROW_BINARY);
+    buffers[0] = (IpcBuffer){offsets, ((int64_t)count + 1) * (int64_t)width, offsets};
+    buffers[1] = (IpcBuffer){data, total, data};
+    return true;
+}
+
+// Eight byte little-endian uncompressed length, then the LZ4 frame, or -1
+// and the bytes as they are when compressing does not pay
+static bool compress_buffer(IpcBuffer *buf) {
+    if (buf->length == 0) return true;
+    size_t bound = lz4_frame_bound((size_t)buf->length);
+    uint8_t *out = malloc(8 + (bound > (size_t)buf->length ? bound : (size_t)buf->length));
+    if (!out) return false;
+    size_t n = lz4_compress_frame(buf->data, (size_t)buf->length, out + 8);
+    int64_t prefix = buf->length;
+    if (n >= (size_t)buf->length) {
+        memcpy(out + 8, buf->data, (size_t)buf->length);
+        n = (size_t)buf->length;
+        prefix = -1;
+    }
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)((uint64_t)prefix >> (8 * i));
+    free(buf->owned);
+    *buf = (IpcBuffer){out, (int64_t)(8 + n), out};
+    return true;
+}
+
+static void encode_column(int j, void *ctx) {
+    IpcJob *job = ctx;
+    const Column *col = &job->table->columns[j];
+    IpcColumn *out = &job->columns[j];
+    int rows = job->table->rows;
+    out->null_count = column_null_count(col);
+
+    if (col->type == TYPE_NULL || out->null_count == rows) {
+        out->type = ARROW_NULL; // no buffers at all
+        out->null_count = rows;
+        return;
+    }
+    // Our bitmap has the Arrow layout already; it is left out when all valid
+    add_buffer(out->buffers, &out->buffer_count, col->validity,
+               out->null_count > 0 ? ((int64_t)rows + 7) / 8 : 0, NULL);
+
+    switch (col->type) {
+        case TYPE_INT:
+            out->type = ARROW_INT;
+            add_buffer(out->buffers, &out->buffer_count, col->ints, (int64_t)rows * 8, NULL);
+            break;
+        case TYPE_FLOAT:
+            out->type = ARROW_FLOAT;
+            add_buffer(out->buffers, &out->buffer_count, col->floats, (int64_t)rows * 8, NULL);
+            break;
+        case TYPE_BOOL: {
+            out->type = ARROW_BOOL;
+            uint8_t *bits = calloc(((size_t)rows + 7) / 8 + 1, 1);
+            if (!bits) {
+                out->failed = true;
+                return;
+            }
+            for (int i = 0; i < rows; i++) bits[i >> 3] |= (uint8_t)((col->bools[i] != 0) << (i & 7));
+            add_buffer(out->buffers, &out->buffer_count, bits, ((int64_t)rows + 7) / 8, bits);
+            break;
+        }
+        default: {
+            Dictionary dict;
+            if (dictionary_build(col, job->dict_limit, &dict)) {
+                out->dictionary = true;
+                out->dict_length = dict.count;
+                // The dictionary batch has no nulls, so no validity bitmap
+                out->dict_buffers[0] = (IpcBuffer){NULL, 0, NULL};
+                if (!encode_strings(col, &dict, dict.count, dict_entry, out->dict_buffers + 1, &out->type)) {
+                    out->failed = true;
+                }
+                // Codes borrowed from an encoded column stay with it
+                add_buffer(out->buffers, &out->buffer_count, dict.codes, (int64_t)rows * 2, dict.owned_codes);
+                dict.owned_codes = NULL;
+                dictionary_free(&dict);
+            } else if (encode_strings(col, NULL, rows, row_value, out->buffers + 1, &out->type)) {
+                out->buffer_count = 3;
+            } else {
+                out->failed = true;
+            }
+            break;
+        }
+    }
+
+    if (job->compress) {
+        for (int b = 0; b < out->buffer_count; b++) {
+            if (!compress_buffer(&out->buffers[b])) out->failed = true;
+        }
+        for (int b = 0; out->dictionary && b < 3; b++) {
+            if (!compress_buffer(&out->dict_buffers[b])) out->failed = true;
+        }
+    }
+}
+
+static void free_column(IpcColumn *c) {
+    for (int b = 0; b < c->buffer_count; b++) free(c->buffers[b].owned);
+    for (int b = 0; b < 3; b++) free(c->dict_buffers[b].owned);
+}
+
+/* =========================================================
+ * Messages
+ * ======================================================= */
+// Schema table, shared by the schema message and the footer
+static size_t build_schema(Flat *fb, const Table *table, const IpcColumn *columns) {
+    size_t slot;
+    size_t schema = flat_table(fb, (FlatField[]){{1, 0, 0}}, 1, &slot);
+    size_t fields = flat_vector(fb, (size_t)table->cols, 4, 4);
+    flat_link(fb, slot, fields);
+
+    for (int j = 0; j < table->cols; j++) {
+        const IpcColumn *c = &columns[j];
+        // name, nullable, type_type, type, children, dictionary
+        size_t s[6];
+        FlatField f[] = {{0, 0, 0}, {1, 1, 1}, {2, 1, (uint64_t)c->type}, {3, 0, 0}, {5, 0, 0}, {4, 0, 0}};
+        size_t field = flat_table(fb, f, c->dictionary ? 6 : 5, s);
+        flat_link(fb, fields + 4 + 4 * (size_t)j, field);
+        flat_link(fb, s[0], flat_string(fb, table->headers[j] ? table->headers[j] : "N/A"));
+
+        size_t type;
+        if (c->type == ARROW_INT) type = flat_table(fb, (FlatField[]){{0, 4, 64}, {1, 1, 1}}, 2, NULL);
+        else if (c->type == ARROW_FLOAT) type = flat_table(fb, (FlatField[]){{0, 2, 2}}, 1, NULL); // double
+        else type = flat_table(fb, NULL, 0, NULL);
+        flat_link(fb, s[3], type);
+        flat_link(fb, s[4], flat_vector(fb, 0, 4, 4));
+
+        if (c->dictionary) {
+            // Dictionary id is the column number; indices are int16
+            size_t e[2];
+            flat_link(fb, s[5], flat_table(fb, (FlatField[]){{0, 8, (uint64_t)j}, {1, 0, 0}}, 2, e));
+            flat_link(fb, e[1], flat_table(fb, (FlatField[]){{0, 4, 16}, {1, 1, 1}}, 2, NULL));
+        }
+    }
+    return schema;
+}
+
+static int64_t padded(int64_t n) {
+    return (n + IPC_ALIGN - 1) & ~(int64_t)(IPC_ALIGN - 1);
+}
+
+static int64_t body_length(IpcBuffer *const *buffers, int count) {
+    int64_t total = 0;
+    for (int b = 0; b < count; b++) total += padded(buffers[b]->length);
+    return total;
+}
+
+// RecordBatch table: one node per column, then where each buffer lies in
+// the body
+static size_t build_record_batch(Flat *fb, int64_t rows, const int64_t *node_nulls, int node_count,
+                                 IpcBuffer *const *buffers, int buffer_count, bool compress) {
+    size_t s[4];
+    FlatField f[] = {{0, 8, (uint64_t)rows}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}};
+    size_t batch = flat_table(fb, f, compress ? 4 : 3, s);
+
+    size_t nodes = flat_vector(fb, (size_t)node_count, 16, 8);
+    for (int j = 0; j < node_count; j++) {
+        flat_put(fb, nodes + 4 + 16 * (size_t)j, (uint64_t)rows, 8);
+        flat_put(fb, nodes + 12 + 16 * (size_t)j, (uint64_t)node_nulls[j], 8);
+    }
+    flat_link(fb, s[1], nodes);
+
+    size_t list = flat_vector(fb, (size_t)buffer_count, 16, 8);
+    int64_t offset = 0;
+    for (int b = 0; b < buffer_count; b++) {
+        flat_put(fb, list + 4 + 16 * (size_t)b, (uint64_t)offset, 8);
+        flat_put(fb, list + 12 + 16 * (size_t)b, (uint64_t)buffers[b]->length, 8);
+        offset += padded(buffers[b]->length);
+    }
+    flat_link(fb, s[2], list);
+
+    // LZ4_FRAME, one compressed unit per buffer
+    if (compress) flat_link(fb, s[3], flat_table(fb, (FlatField[]){{0, 1, 0}, {1, 1, 0}}, 2, NULL));
+    return batch;
+}
+
+// Message table as the root of fb; returns the slot for its header
+static size_t begin_message(Flat *fb, int header_type, int64_t body) {
+    flat_root(fb);
+    size_t s[4];
+    FlatField f[] = {{0, 2, METADATA_V5}, {1, 1, (uint64_t)header_type}, {2, 0, 0}, {3, 8, (uint64_t)body}};
+    flat_link(fb, 0, flat_table(fb, f, 4, s));
+    return s[2];
+}
+
+typedef struct
+{
+    FILE *fp;
+    int64_t pos;
+    bool ok;
+} IpcOut;
+
+static void out_write(IpcOut *out, const void *data, int64_t n) {
+    if (out->ok && n > 0 && fwrite(data, 1, (size_t)n, out->fp) != (size_t)n) out->ok = false;
+    out->pos += n;
+}
+
+static void out_pad(IpcOut *out) {
+    static const char zeros[IPC_ALIGN];
+    out_write(out, zeros, padded(out->pos) - out->pos);
+}
+
+typedef struct
+{
+    int64_t offset;
+    int32_t metadata_length;
+    int64_t body_length;
+} IpcBlock;
+
+// Continuation marker, metadata length, metadata padded to IPC_ALIGN, body
+static IpcBlock write_message(IpcOut *out, Flat *fb, IpcBuffer *const *buffers, int buffer_count) {
+    IpcBlock block = {out->pos, 0, body_length(buffers, buffer_count)};
+    int32_t size = (int32_t)padded((int64_t)fb->len);
+    uint8_t prefix[8] = {0xFF, 0xFF, 0xFF, 0xFF};
+    for (int i = 0; i < 4; i++) prefix[4 + i] = (uint8_t)((uint32_t)size >> (8 * i));
+    out_write(out, prefix, 8);
+    out_write(out, fb->data, (int64_t)fb->len);
+    out_pad(out);
+    block.metadata_length = 8 + size;
+    for (int b = 0; b < buffer_count; b++) {
+        out_write(out, buffers[b]->data, buffers[b]->length);
+        out_pad(out);
+    }
+    if (fb->failed) out->ok = false;
+    free(fb->data);
+    *fb = (Flat){0};
+    return block;
+}
+
+static size_t block_vector(Flat *fb, const IpcBlock *blocks, int count) {
+    size_t list = flat_vector(fb, (size_t)count, 24, 8);
+    for (int i = 0; i < count; i++) {
+        size_t at = list + 4 + 24 * (size_t)i;
+        flat_put(fb, at, (uint64_t)blocks[i].offset, 8);
+        flat_put(fb, at + 8, (uint64_t)(uint32_t)blocks[i].metadata_length, 4);
+        flat_put(fb, at + 16, (uint64_t)blocks[i].body_length, 8);
+    }
+    return list;
+}
+
+bool arrow_write_table(const Table *table, FILE *fp) {
+    int cols = table->cols;
+    IpcJob job = {table, calloc(cols > 0 ? cols : 1, sizeof(IpcColumn)),
+                  get_export_compression(), get_dictionary_limit()};
+    IpcBuffer **buffers = malloc(((size_t)cols * 3 + 1) * sizeof(IpcBuffer *));
+    int64_t *nulls = malloc(((size_t)cols + 1) * sizeof(int64_t));
+    IpcBlock *dict_blocks = malloc(((size_t)cols + 1) * sizeof(IpcBlock));
+    IpcOut out = {fp, 0, job.columns && buffers && nulls && dict_blocks};
+    if (out.ok) parallel_for(cols, encode_column, &job);
+    for (int j = 0; out.ok && j < cols; j++) out.ok = !job.columns[j].failed;
+
+    Flat fb = {0};
+    int dict_count = 0;
+    IpcBlock batch_block = {0};
+    if (out.ok) {
+        out_write(&out, ARROW_MAGIC "\0\0", 8);
+
+        flat_link(&fb, begin_message(&fb, HEADER_SCHEMA, 0), build_schema(&fb, table, job.columns));
+        write_message(&out, &fb, NULL, 0);
+
+        for (int j = 0; j < cols; j++) {
+            IpcColumn *c = &job.columns[j];
+            if (!c->dictionary) continue;
+            IpcBuffer *dict_buffers[3] = {&c->dict_buffers[0], &c->dict_buffers[1], &c->dict_buffers[2]};
+            int64_t none = 0;
+            size_t header = begin_message(&fb, HEADER_DICTIONARY_BATCH, body_length(dict_buffers, 3));
+            size_t s[2];
+            flat_link(&fb, header, flat_table(&fb, (FlatField[]){{0, 8, (uint64_t)j}, {1, 0, 0}}, 2, s));
+            flat_link(&fb, s[1], build_record_batch(&fb, c->dict_length, &none, 1, dict_buffers, 3, job.compress));
+            dict_blocks[dict_count++] = write_message(&out, &fb, dict_buffers, 3);
+        }
+
+        int buffer_count = 0;
+        for (int j = 0; j < cols; j++) {
+            nulls[j] = job.columns[j].null_count;
+            for (int b = 0; b < job.columns[j].buffer_count; b++) buffers[buffer_count++] = &job.columns[j].buffers[b];
+        }
+        size_t header = begin_message(&fb, HEADER_RECORD_BATCH, body_length(buffers, buffer_count));
+        flat_link(&fb, header, build_record_batch(&fb, table->rows, nulls, cols, buffers, buffer_count, job.compress));
+        batch_block = write_message(&out, &fb, buffers, buffer_count);
+
+        static const uint8_t end_of_stream[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+        out_write(&out, end_of_stream, 8);
+
+        // Footer: the schema again and where every batch starts
+        flat_root(&fb);
+        size_t s[4];
+        FlatField f[] = {{0, 2, METADATA_V5}, {1, 0, 0}, {2, 0, 0}, {3, 0, 0}};
+        flat_link(&fb, 0, flat_table(&fb, f, 4, s));
+        flat_link(&fb, s[1], build_schema(&fb, table, job.columns));
+        flat_link(&fb, s[2], block_vector(&fb, dict_blocks, dict_count));
+        flat_link(&fb, s[3], block_vector(&fb, &batch_block, 1));
+        if (fb.failed) out.ok = false;
+        uint8_t tail[4];
+        for (int i = 0; i < 4; i++) tail[i] = (uint8_t)((uint32_t)fb.len >> (8 * i));
+        out_write(&out, fb.data, (int64_t)fb.len);
+        out_write(&out, tail, 4);
+        out_write(&out, ARROW_MAGIC, 6);
+        free(fb.data);
+    }
+
+    for (int j = 0; job.columns && j < cols; j++) free_column(&job.columns[j]);
+    free(job.columns);
+    free(buffers);
+    free(nulls);
+    free(dict_blocks);
+    return out.ok;
+}
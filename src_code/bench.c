@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "fileio.h"
+#include "stats.h"
+#include "export.h"
+#include "preprocess.h"
+#include "data_preparation.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "statcache.h"
+#include "csvparse.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <unistd.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#define BENCH_DATA "../Data/bench_data.csv"
+#define BENCH_STATS "../Data/bench_stats.csv"
+#define BENCH_SAVED "../Data/bench_saved.csv"
+#define BENCH_BUCKETS 10
+
+typedef enum
+{
+    BENCH_LOADS,   // starts from nothing and loads the table itself
+    BENCH_READS,   // shares one loaded table
+    BENCH_CHANGES  // gets a freshly loaded table every run
+} BenchKind;
+
+typedef struct
+{
+    const char *name;
+    BenchKind kind;
+    bool (*run)(Table *table);
+} BenchStep;
+
+typedef struct
+{
+    const char *name;
+    bool ok;
+    int runs;
+    int rows;          // rows the step was given (loaded, for load_csv)
+    long long bytes;
+    double median_ms, min_ms;
+    long peak_kb;      // -1 when unknown
+} BenchResult;
+
+/* =========================================================
+ * Measuring
+ * ======================================================= */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : 0;
+}
+
+// The operations report as they go; their output is sent to the null
+// device while they are timed. Returns the saved stdout, -1 if it stays.
+static int silence_stdout(void) {
+    fflush(stdout);
+    int saved = dup(fileno(stdout));
+    FILE *null = fopen(NULL_DEVICE, "w");
+    if (saved < 0 || !null) {
+        if (saved >= 0) close(saved);
+        if (null) fclose(null);
+        return -1;
+    }
+    dup2(fileno(null), fileno(stdout));
+    fclose(null);
+    return saved;
+}
+
+static void restore_stdout(int saved) {
+    if (saved < 0) return;
+    fflush(stdout);
+    dup2(saved, fileno(stdout));
+    close(saved);
+}
+
+/* =========================================================
+ * Steps
+ * ======================================================= */
+// Numeric columns of the table; the caller frees the list
+static int numeric_columns(const Table *table, int **cols) {
+    *cols = malloc((size_t)(table->cols > 0 ? table->cols : 1) * sizeof(int));
+    if (!*cols) return -1;
+    int n = 0;
+    for (int j = 0; j < table->cols; j++) {
+        FieldType type = table->columns[j].type;
+        if (type == TYPE_INT || type == TYPE_FLOAT) (*cols)[n++] = j;
+    }
+    return n;
+}
+
+static bool step_load(Table *table) {
+    return load_csv(table, BENCH_DATA);
+}
+
+static bool step_print_stats(Table *table) {
+    print_stats(table);
+    return true;
+}
+
+static bool step_export_stats(Table *table) {
+    export_stats_csv(table, BENCH_STATS);
+    return true;
+}
+
+static bool step_save(Table *table) {
+    return save_csv(table, BENCH_SAVED);
+}
+
+static bool step_outliers(Table *table) {
+    return outlier_detection(table) == 1;
+}
+
+static bool step_fill_na(Table *table) {
+    int *cols;
+    int n = numeric_columns(table, &cols);
+    if (n > 0) fill_na_columns(table, cols, n, "median");
+    free(cols);
+    return n >= 0;
+}
+
+static bool step_drop_na(Table *table) {
+    drop_na_any(table);
+    return true;
+}
+
+static bool step_bucket(Table *table) {
+    int *cols;
+    int n = numeric_columns(table, &cols);
+    bool ok = n >= 0;
+    for (int i = 0; i < n && ok; i++) ok = bucket_col(table, cols[i], BENCH_BUCKETS, 1) == 1;
+    free(cols);
+    return ok;
+}
+
+static bool step_scale(Table *table) {
+    int *cols;
+    int n = numeric_columns(table, &cols);
+    bool ok = n >= 0;
+    for (int i = 0; i < n && ok; i++) ok = scale_to_range(table, cols[i], 0.0, 1.0, 1) == 1;
+    free(cols);
+    return ok;
+}
+
+static const BenchStep steps[] = {
+    {"load_csv", BENCH_LOADS, step_load},
+    {"print_stats", BENCH_READS, step_print_stats},
+    {"export_stats_csv", BENCH_READS, step_export_stats},
+    {"outlier_detection", BENCH_READS, step_outliers},
+    {"save_csv", BENCH_READS, step_save},
+    {"fill_na", BENCH_CHANGES, step_fill_na},
+    {"drop_na", BENCH_CHANGES, step_drop_na},
+    {"bucket_col", BENCH_CHANGES, step_bucket},
+    {"scale_to_range", BENCH_CHANGES, step_scale},
+};
+#define BENCH_STEPS (int)(sizeof(steps) / sizeof(steps[0]))
+
+static int compare_ms(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Run one step `repeat` times. `shared` is the loaded table read-only
+// steps use.
+static void time_step(const BenchStep *step, Table *shared, int repeat, double *times, BenchResult *r) {
+    memset(r, 0, sizeof(*r));
+    r->name = step->name;
+    r->ok = true;
+    r->bytes = file_size(BENCH_DATA);
+    reset_peak_memory();
+    for (int k = 0; k < repeat && r->ok; k++) {
+        Table fresh = {0};
+        Table *table = step->kind == BENCH_READS ? shared : &fresh;
+        int saved = silence_stdout();
+        // Each run describes the columns again instead of reading the cache
+        if (step->kind == BENCH_READS) table_stats_changed(shared, -1);
+        if (step->kind == BENCH_CHANGES) r->ok = load_csv(table, BENCH_DATA);
+        r->rows = table->rows;
+        double start = now_ms();
+        if (r->ok) r->ok = step->run(table);
+        times[k] = now_ms() - start;
+        restore_stdout(saved);
+        if (step->kind == BENCH_LOADS) r->rows = table->rows;
+        if (table == &fresh) free_table(&fresh);
+        r->runs++;
+    }
+    r->peak_kb = peak_memory_kb();
+    if (step->run == step_save) r->bytes = file_size(BENCH_SAVED);
+    qsort(times, r->runs, sizeof(double), compare_ms);
+    r->min_ms = times[0];
+    r->median_ms = r->runs % 2 ? times[r->runs / 2] : (times[r->runs / 2 - 1] + times[r->runs / 2]) / 2;
+}
+
+/* =========================================================
+ * Report
+ * ======================================================= */
+static double mb_per_s(const BenchResult *r) {
+    return r->median_ms > 0 ? r->bytes / 1e6 / (r->median_ms / 1e3) : 0;
+}
+
+static double rows_per_s(const BenchResult *r) {
+    return r->median_ms > 0 ? r->rows / (r->median_ms / 1e3) : 0;
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void write_json(FILE *fp, const DataSpec *spec, int repeat, const BenchResult *results, int count) {
+    fprintf(fp, "{\n  \"spec\": {\"rows\": %lld, \"cols\": %d, \"mix\": [%d, %d, %d, %d], "
+                "\"nulls\": %g, \"quoted\": %g, \"card\": %lld, \"seed\": %llu},\n",
+            (long long)spec->rows, spec->cols, spec->mix[0], spec->mix[1], spec->mix[2], spec->mix[3],
+            spec->null_rate, spec->quote_rate, (long long)spec->cardinality, (unsigned long long)spec->seed);
+    fprintf(fp, "  \"threads\": %d,\n  \"repeat\": %d,\n  \"results\": [\n", get_thread_count(), repeat);
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"ok\": %s, \"runs\": %d, \"rows\": %d, \"bytes\": %lld, "
+                    "\"median_ms\": %.3f, \"min_ms\": %.3f, \"mb_per_s\": %.2f, \"rows_per_s\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+                r->name, r->ok ? "true" : "false", r->runs, r->rows, r->bytes, r->median_ms, r->min_ms,
+                mb_per_s(r), rows_per_s(r), r->peak_kb, i + 1 < count ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+static void write_csv(FILE *fp, int repeat, const BenchResult *results, int count) {
+    fprintf(fp, "name,ok,runs,rows,bytes,median_ms,min_ms,mb_per_s,rows_per_s,peak_rss_kb,threads,repeat\n");
+    for (int i = 0; i < count; i++) {
+        const BenchResult *r = &results[i];
+        fprintf(fp, "%s,%d,%d,%d,%lld,%.3f,%.3f,%.2f,%.0f,%ld,%d,%d\n", r->name, r->ok, r->runs, r->rows,
+                r->bytes, r->median_ms, r->min_ms, mb_per_s(r), rows_per_s(r), r->peak_kb, get_thread_count(), repeat);
+    }
+}
+
+/* =========================================================
+ * Tokenizers
+ * ======================================================= */
+// Whether two indexes split the input the same way; if not, `why` says
+// where they first part
+static bool same_index(const CsvIndex *a, const CsvIndex *b, char *why, size_t size) {
+    if (a->row_count != b->row_count || a->field_count != b->field_count) {
+        snprintf(why, size, "%lld rows and %lld fields, against %lld and %lld", (long long)b->row_count,
+                 (long long)b->field_count, (long long)a->row_count, (long long)a->field_count);
+        return false;
+    }
+    for (int64_t r = 0; r <= a->row_count; r++) {
+        if (a->row_start[r] != b->row_start[r]) {
+            snprintf(why, size, "row %lld starts at field %lld, against %lld", (long long)r,
+                     (long long)b->row_start[r], (long long)a->row_start[r]);
+            return false;
+        }
+    }
+    for (int64_t f = 0; f < a->field_count; f++) {
+        const FieldSpan *x = &a->fields[f], *y = &b->fields[f];
+        if (x->offset != y->offset || x->length != y->length || x->flags != y->flags) {
+            snprintf(why, size, "field %lld is at %lld, %u bytes, flags %u, against %lld, %u, %u", (long long)f,
+                     (long long)y->offset, y->length, y->flags, (long long)x->offset, x->length, x->flags);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_scan_modes(const char *filename) {
+    MappedFile mf;
+    if (!map_data_file(&mf, filename, false)) {
+        printf("Error: cannot open '%s'.\n", filename);
+        return false;
+    }
+    ScanMode saved = csv_scan_mode();
+    int threads = get_thread_count();
+
+    // The reference takes no shortcut: byte by byte, in one piece
+    CsvIndex ref;
+    set_thread_count(1);
+    csv_set_scan_mode(SCAN_SCALAR);
+    double start = now_ms();
+    bool ok = csv_index_build(&ref, mf.data, mf.size, ',');
+    double ms = now_ms() - start;
+    set_thread_count(threads);
+    if (!ok) {
+        printf("Error: cannot index '%s'.\n", filename);
+        csv_set_scan_mode(saved);
+        unmap_file(&mf);
+        return false;
+    }
+    printf("%s: %lld rows with the header, %lld fields, %.1f MB\n", filename, (long long)ref.row_count,
+           (long long)ref.field_count, mf.size / 1e6);
+    printf("\n%-8s %7s %10s %9s  %s\n", "Scanner", "Threads", "ms", "MB/s", "Index");
+    printf("%-8s %7d %10.1f %9.1f  reference\n", "scalar", 1, ms, ms > 0 ? mf.size / 1e6 / (ms / 1e3) : 0);
+
+    for (ScanMode mode = SCAN_SCALAR; mode < SCAN_MODES; mode++) {
+        const char *name = csv_scan_mode_name(mode);
+        if (!csv_scan_supported(mode)) {
+            printf("%-8s not supported on this CPU\n", name);
+            continue;
+        }
+        CsvIndex idx;
+        csv_set_scan_mode(mode);
+        start = now_ms();
+        bool built = csv_index_build(&idx, mf.data, mf.size, ',');
+        ms = now_ms() - start;
+        char why[160] = "";
+        bool same = built && same_index(&ref, &idx, why, sizeof(why));
+        printf("%-8s %7d %10.1f %9.1f  %s\n", name, threads, ms, ms > 0 ? mf.size / 1e6 / (ms / 1e3) : 0,
+               !built ? "failed" : same ? "same" : "DIFFERS");
+        if (why[0]) printf("  %s\n", why);
+        if (built) csv_index_free(&idx);
+        ok = ok && same;
+    }
+    csv_set_scan_mode(saved);
+    csv_index_free(&ref);
+    unmap_file(&mf);
+    return ok;
+}
+
+bool run_benchmarks(const DataSpec *spec, int repeat, const char *report) {
+    if (repeat < 1) repeat = 1;
+    double *times = malloc((size_t)repeat * sizeof(double));
+    if (!times) {
+        printf("Error: Memory allocation failed.\n");
+        return false;
+    }
+    double start = now_ms();
+    if (!datagen_write(spec, BENCH_DATA)) {
+        free(times);
+        return false;
+    }
+    printf("Generated %lld rows x %d columns (%.1f MB) in %.0f ms.\n", (long long)spec->rows, spec->cols,
+           file_size(BENCH_DATA) / 1e6, now_ms() - start);
+
+    Table shared = {0};
+    int saved = silence_stdout();
+    bool ok = load_csv(&shared, BENCH_DATA);
+    restore_stdout(saved);
+    if (!ok) {
+        printf("Error: the generated data did not load.\n");
+        free(times);
+        remove(BENCH_DATA);
+        return false;
+    }
+
+    BenchResult results[BENCH_STEPS];
+    printf("\n%-18s %5s %10s %10s %9s %12s %10s\n", "Step", "Runs", "ms", "best ms", "MB/s", "rows/s", "peak MB");
+    for (int i = 0; i < BENCH_STEPS; i++) {
+        BenchResult *r = &results[i];
+        time_step(&steps[i], &shared, repeat, times, r);
+        if (!r->ok) {
+            printf("%-18s failed\n", r->name);
+            ok = false;
+            continue;
+        }
+        printf("%-18s %5d %10.1f %10.1f %9.1f %12.0f %10.1f\n", r->name, r->runs, r->median_ms, r->min_ms,
+               mb_per_s(r), rows_per_s(r), r->peak_kb / 1024.0);
+    }
+    free_table(&shared);
+    free(times);
+    remove(BENCH_DATA);
+    remove(BENCH_STATS);
+    remove(BENCH_SAVED);
+
+    FILE *fp = fopen(report, "w");
+    if (!fp) {
+        printf("Error: cannot write '%s'.\n", report);
+        return false;
+    }
+    if (ends_with(report, ".json")) write_json(fp, spec, repeat, results, BENCH_STEPS);
+    else write_csv(fp, repeat, results, BENCH_STEPS);
+    if (fclose(fp) != 0) ok = false;
+    printf("\nReport written to %s\n", report);
+    return ok;
+}
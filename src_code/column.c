@@ -0,0 +1,642 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "column.h"
+#include "numparse.h"
+#include "numformat.h"
+#include "dictionary.h"
+#include "trace.h"
+
+#define INITIAL_COLUMN_CAPACITY 64
+
+static bool is_string_storage(FieldType type) {
+    return type == TYPE_STRING || type == TYPE_NULL;
+}
+
+static bool parse_bool(const char *str, size_t len, bool *out) {
+    if (len == 4 && strncasecmp(str, "true", 4) == 0) { *out = true; return true; }
+    if (len == 5 && strncasecmp(str, "false", 5) == 0) { *out = false; return true; }
+    return false;
+}
+
+static inline void set_valid(Column *col, int row, bool valid) {
+    uint64_t bit = (uint64_t)1 << (row & 63);
+    if (valid) col->validity[row >> 6] |= bit;
+    else col->validity[row >> 6] &= ~bit;
+}
+
+void column_init(Column *col, FieldType type) {
+    column_init_in(col, type, NULL);
+}
+
+void column_init_in(Column *col, FieldType type, Arena *arena) {
+    memset(col, 0, sizeof(*col));
+    col->type = type;
+    col->arena = arena;
+}
+
+static inline int popcount64(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+static inline int lowest_bit(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+// Grow or shrink one buffer of the column, keeping its contents. Leaves
+// the old buffer in place and returns NULL on failure, like realloc.
+static void *resize_buffer(Column *col, void *old, size_t old_size, size_t size) {
+    if (!col->arena) {
+        trace_add(TRACE_ALLOCATIONS, 1);
+        return realloc(old, size);
+    }
+    // Pooled blocks are whole size classes, so small growth may fit in place
+    if (old && arena_class_size(old_size) == arena_class_size(size)) return old;
+    void *p = arena_alloc_pooled(col->arena, size);
+    if (!p) return NULL;
+    if (old) {
+        memcpy(p, old, old_size < size ? old_size : size);
+        arena_release(col->arena, old, old_size);
+    }
+    return p;
+}
+
+static void free_buffer(Column *col, void *p, size_t size) {
+    if (col->arena) arena_release(col->arena, p, size);
+    else free(p);
+}
+
+void column_free(Column *col) {
+    size_t cap = (size_t)col->capacity;
+    free_buffer(col, col->ints, cap * sizeof(int64_t));
+    free_buffer(col, col->floats, cap * sizeof(double));
+    free_buffer(col, col->bools, cap * sizeof(uint8_t));
+    free_buffer(col, col->offsets, (col->codes ? (size_t)col->dict_count : cap) * sizeof(int64_t));
+    free_buffer(col, col->codes, cap * sizeof(uint16_t));
+    free_buffer(col, col->bytes, (size_t)col->bytes_cap);
+    free_buffer(col, col->validity, (cap + 63) / 64 * sizeof(uint64_t));
+    column_init_in(col, col->type, col->arena);
+}
+
+bool column_reserve(Column *col, int capacity) {
+    if (capacity <= col->capacity) return true;
+
+    size_t old_words = (size_t)(col->capacity + 63) / 64;
+    size_t words = (size_t)(capacity + 63) / 64;
+    uint64_t *validity = resize_buffer(col, col->validity, old_words * sizeof(uint64_t),
+                                       words * sizeof(uint64_t));
+    if (!validity) return false;
+    memset(validity + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    col->validity = validity;
+
+    size_t old_cap = (size_t)col->capacity;
+    switch (col->type) {
+        case TYPE_INT: {
+            int64_t *ints = resize_buffer(col, col->ints, old_cap * sizeof(int64_t), capacity * sizeof(int64_t));
+            if (!ints) return false;
+            col->ints = ints;
+            break;
+        }
+        case TYPE_FLOAT: {
+            double *floats = resize_buffer(col, col->floats, old_cap * sizeof(double), capacity * sizeof(double));
+            if (!floats) return false;
+            col->floats = floats;
+            break;
+        }
+        case TYPE_BOOL: {
+            uint8_t *bools = resize_buffer(col, col->bools, old_cap * sizeof(uint8_t), capacity * sizeof(uint8_t));
+            if (!bools) return false;
+            col->bools = bools;
+            break;
+        }
+        case TYPE_STRING:
+        case TYPE_NULL:
+        default: {
+            if (col->codes) {
+                uint16_t *codes = resize_buffer(col, col->codes, old_cap * sizeof(uint16_t), capacity * sizeof(uint16_t));
+                if (!codes) return false;
+                col->codes = codes;
+                break;
+            }
+            int64_t *offsets = resize_buffer(col, col->offsets, old_cap * sizeof(int64_t), capacity * sizeof(int64_t));
+            if (!offsets) return false;
+            col->offsets = offsets;
+            break;
+        }
+    }
+    col->capacity = capacity;
+    return true;
+}
+
+// Make room for `bytes` more bytes of string data (terminators included)
+bool column_reserve_bytes(Column *col, int64_t bytes) {
+    if (col->bytes_len + bytes <= col->bytes_cap) return true;
+    int64_t cap = col->bytes_len + bytes;
+    char *data = resize_buffer(col, col->bytes, (size_t)col->bytes_cap, (size_t)cap);
+    if (!data) return false;
+    col->bytes = data;
+    col->bytes_cap = cap;
+    return true;
+}
+
+// Make room for one more row, doubling the allocation when full
+static bool grow(Column *col) {
+    if (col->length < col->capacity) return true;
+    int capacity = col->capacity ? col->capacity * 2 : INITIAL_COLUMN_CAPACITY;
+    return column_reserve(col, capacity);
+}
+
+static bool append_bytes(Column *col, const char *str, size_t len) {
+    if (col->bytes_len + (int64_t)len + 1 > col->bytes_cap) {
+        int64_t cap = col->bytes_cap ? col->bytes_cap : 256;
+        while (cap < col->bytes_len + (int64_t)len + 1) cap *= 2;
+        char *bytes = resize_buffer(col, col->bytes, (size_t)col->bytes_cap, (size_t)cap);
+        if (!bytes) return false;
+        col->bytes = bytes;
+        col->bytes_cap = cap;
+    }
+    col->offsets[col->length] = col->bytes_len;
+    if (len) memcpy(col->bytes + col->bytes_len, str, len);
+    col->bytes[col->bytes_len + len] = '\0';
+    col->bytes_len += len + 1;
+    return true;
+}
+
+bool column_push_null(Column *col) {
+    if (!grow(col)) return false;
+    switch (col->type) {
+        case TYPE_INT: col->ints[col->length] = 0; break;
+        case TYPE_FLOAT: col->floats[col->length] = 0.0; break;
+        case TYPE_BOOL: col->bools[col->length] = 0; break;
+        default:
+            // No bytes: nulls are only a clear bit
+            if (col->codes) col->codes[col->length] = 0;
+            else col->offsets[col->length] = col->bytes_len;
+            break;
+    }
+    set_valid(col, col->length, false);
+    col->length++;
+    return true;
+}
+
+bool column_push_int(Column *col, int64_t value) {
+    if (col->type != TYPE_INT || !grow(col)) return false;
+    col->ints[col->length] = value;
+    set_valid(col, col->length, true);
+    col->length++;
+    return true;
+}
+
+bool column_push_float(Column *col, double value) {
+    if (col->type != TYPE_FLOAT || !grow(col)) return false;
+    col->floats[col->length] = value;
+    set_valid(col, col->length, true);
+    col->length++;
+    return true;
+}
+
+bool column_push_bool(Column *col, bool value) {
+    if (col->type != TYPE_BOOL || !grow(col)) return false;
+    col->bools[col->length] = value;
+    set_valid(col, col->length, true);
+    col->length++;
+    return true;
+}
+
+static int add_code(Column *col, const char *str, size_t len);
+
+bool column_push_string(Column *col, const char *str, size_t len) {
+    if (!is_string_storage(col->type) || !grow(col)) return false;
+    if (col->codes) {
+        // A value that does not fit the dictionary any more undoes it
+        int code = add_code(col, str, len);
+        if (code >= 0) col->codes[col->length] = (uint16_t)code;
+        else if (!column_decode_dictionary(col)) return false;
+    }
+    if (!col->codes && !append_bytes(col, str, len)) return false;
+    set_valid(col, col->length, true);
+    col->length++;
+    return true;
+}
+
+// Append a row holding dictionary value `code` of an encoded column
+bool column_push_code(Column *col, int code) {
+    if (!col->codes || !grow(col)) return false;
+    col->codes[col->length] = (uint16_t)code;
+    set_valid(col, col->length, true);
+    col->length++;
+    return true;
+}
+
+// Append a value given as text (not NUL-terminated), parsed for the column
+// type. Returns false when the text is not a valid value of that type.
+bool column_push_text(Column *col, const char *text, size_t len) {
+    switch (col->type) {
+        case TYPE_INT: {
+            int64_t v;
+            return parse_int64(text, len, &v) && column_push_int(col, v);
+        }
+        case TYPE_FLOAT: {
+            double v;
+            return parse_double(text, len, &v) && column_push_float(col, v);
+        }
+        case TYPE_BOOL: {
+            bool v;
+            return parse_bool(text, len, &v) && column_push_bool(col, v);
+        }
+        default:
+            return column_push_string(col, text, len);
+    }
+}
+
+void column_set_null(Column *col, int row) {
+    set_valid(col, row, false);
+}
+
+void column_set_int(Column *col, int row, int64_t value) {
+    col->ints[row] = value;
+    set_valid(col, row, true);
+}
+
+void column_set_float(Column *col, int row, double value) {
+    col->floats[row] = value;
+    set_valid(col, row, true);
+}
+
+void column_set_bool(Column *col, int row, bool value) {
+    col->bools[row] = value;
+    set_valid(col, row, true);
+}
+
+// Row of an encoded column set to dictionary value `code`
+void column_set_code(Column *col, int row, int code) {
+    col->codes[row] = (uint16_t)code;
+    set_valid(col, row, true);
+}
+
+// Append the value of `row` in `src` to `dst`, parsing or formatting it for
+// the storage type of `dst`. Returns false when the value does not fit.
+static bool push_converted(Column *dst, const Column *src, int row) {
+    if (!column_is_valid(src, row)) return column_push_null(dst);
+
+    if (src->type == TYPE_INT && dst->type == TYPE_FLOAT)
+        return column_push_float(dst, (double)src->ints[row]);
+
+    char buf[64];
+    const char *text = column_text(src, row, buf, sizeof(buf));
+    return column_push_text(dst, text, strlen(text));
+}
+
+// Change the storage type of a column. Leaves the column untouched and
+// returns false if any present value cannot be represented in `type`.
+bool column_convert(Column *col, FieldType type) {
+    if (col->type == type) return true;
+    if (is_string_storage(col->type) && is_string_storage(type)) {
+        col->type = type;
+        return true;
+    }
+
+    Column out;
+    column_init_in(&out, type, col->arena);
+    if (!column_reserve(&out, col->length > 0 ? col->length : 1)) {
+        column_free(&out);
+        return false;
+    }
+    for (int i = 0; i < col->length; i++) {
+        if (!push_converted(&out, col, i)) {
+            column_free(&out);
+            return false;
+        }
+    }
+    column_free(col);
+    *col = out;
+    return true;
+}
+
+/* =========================================================
+ * Dictionary encoding
+ * ======================================================= */
+// Copy of the dictionary of `src` for `dst`, which has none yet
+static bool copy_dictionary(Column *dst, const Column *src) {
+    int64_t *offsets = resize_buffer(dst, NULL, 0, (size_t)src->dict_count * sizeof(int64_t));
+    char *bytes = resize_buffer(dst, NULL, 0, (size_t)src->bytes_len);
+    if (!offsets || !bytes) {
+        free_buffer(dst, offsets, (size_t)src->dict_count * sizeof(int64_t));
+        free_buffer(dst, bytes, (size_t)src->bytes_len);
+        return false;
+    }
+    memcpy(offsets, src->offsets, (size_t)src->dict_count * sizeof(int64_t));
+    memcpy(bytes, src->bytes, (size_t)src->bytes_len);
+    dst->offsets = offsets;
+    dst->bytes = bytes;
+    dst->bytes_len = dst->bytes_cap = src->bytes_len;
+    dst->dict_count = src->dict_count;
+    return true;
+}
+
+// Store each distinct value of a string column once, with a 16-bit code
+// per row, if it has at most `limit` of them (see dictionary_build).
+// Returns true if the column is encoded afterwards.
+bool column_encode_dictionary(Column *col, int limit) {
+    if (col->codes) return true;
+    Dictionary dict;
+    if (!dictionary_build(col, limit, &dict)) return false;
+
+    int64_t bytes_len = 0;
+    for (int k = 0; k < dict.count; k++) bytes_len += (int64_t)strlen(dictionary_value(&dict, k)) + 1;
+    size_t cap = (size_t)col->capacity;
+    int64_t *offsets = resize_buffer(col, NULL, 0, (size_t)dict.count * sizeof(int64_t));
+    char *bytes = resize_buffer(col, NULL, 0, (size_t)bytes_len);
+    uint16_t *codes = resize_buffer(col, NULL, 0, cap * sizeof(uint16_t));
+    if (!offsets || !bytes || !codes) {
+        free_buffer(col, offsets, (size_t)dict.count * sizeof(int64_t));
+        free_buffer(col, bytes, (size_t)bytes_len);
+        free_buffer(col, codes, cap * sizeof(uint16_t));
+        dictionary_free(&dict);
+        return false;
+    }
+    int64_t pos = 0;
+    for (int k = 0; k < dict.count; k++) {
+        const char *s = dictionary_value(&dict, k);
+        size_t len = strlen(s) + 1;
+        memcpy(bytes + pos, s, len);
+        offsets[k] = pos;
+        pos += (int64_t)len;
+    }
+    memcpy(codes, dict.codes, (size_t)col->length * sizeof(uint16_t));
+
+    free_buffer(col, col->offsets, cap * sizeof(int64_t));
+    free_buffer(col, col->bytes, (size_t)col->bytes_cap);
+    col->offsets = offsets;
+    col->bytes = bytes;
+    col->bytes_len = col->bytes_cap = bytes_len;
+    col->codes = codes;
+    col->dict_count = dict.count;
+    dictionary_free(&dict);
+    return true;
+}
+
+// Back to one copy of the text per row
+bool column_decode_dictionary(Column *col) {
+    if (!col->codes) return true;
+    Column out;
+    column_init_in(&out, col->type, col->arena);
+    int64_t bytes = 0;
+    for (int i = 0; i < col->length; i++) {
+        if (column_is_valid(col, i)) bytes += (int64_t)strlen(column_string_at(col, i)) + 1;
+    }
+    bool ok = column_reserve(&out, col->capacity > 0 ? col->capacity : 1) && column_reserve_bytes(&out, bytes);
+    for (int i = 0; ok && i < col->length; i++) {
+        if (!column_is_valid(col, i)) {
+            ok = column_push_null(&out);
+        } else {
+            const char *s = column_string_at(col, i);
+            ok = column_push_string(&out, s, strlen(s));
+        }
+    }
+    if (!ok) {
+        column_free(&out);
+        return false;
+    }
+    column_free(col);
+    *col = out;
+    return true;
+}
+
+static int find_code(const Column *col, const char *text, size_t len) {
+    for (int k = 0; k < col->dict_count; k++) {
+        const char *s = col->bytes + col->offsets[k];
+        if (strncmp(s, text, len) == 0 && s[len] == '\0') return k;
+    }
+    return -1;
+}
+
+// Turn an empty string column into an encoded one, so that values can be
+// appended as codes while their dictionary is built elsewhere
+bool column_begin_dictionary(Column *col) {
+    if (col->codes) return true;
+    if (col->length > 0 || !is_string_storage(col->type) || !grow(col)) return false;
+    size_t cap = (size_t)col->capacity;
+    uint16_t *codes = resize_buffer(col, NULL, 0, cap * sizeof(uint16_t));
+    if (!codes) return false;
+    free_buffer(col, col->offsets, cap * sizeof(int64_t));
+    col->offsets = NULL;
+    col->codes = codes;
+    col->dict_count = 0;
+    return true;
+}
+
+// Code of `text` in an encoded column, or -1 if no row may hold it
+int column_find_code(const Column *col, const char *text) {
+    return col->codes ? find_code(col, text, strlen(text)) : -1;
+}
+
+// Add a value the dictionary does not hold yet and return its code. -1
+// when the dictionary is full or memory runs out.
+int column_append_code(Column *col, const char *str, size_t len) {
+    if (!col->codes || col->dict_count >= DICTIONARY_MAX_VALUES) return -1;
+    size_t old_size = (size_t)col->dict_count * sizeof(int64_t);
+    int64_t *offsets = resize_buffer(col, col->offsets, old_size, old_size + sizeof(int64_t));
+    if (!offsets) return -1;
+    col->offsets = offsets;
+    if (!column_reserve_bytes(col, (int64_t)len + 1)) return -1;
+    memcpy(col->bytes + col->bytes_len, str, len);
+    col->bytes[col->bytes_len + len] = '\0';
+    col->offsets[col->dict_count] = col->bytes_len;
+    col->bytes_len += (int64_t)len + 1;
+    return col->dict_count++;
+}
+
+// Code of a value, added to the dictionary if new
+static int add_code(Column *col, const char *str, size_t len) {
+    int code = find_code(col, str, len);
+    return code >= 0 ? code : column_append_code(col, str, len);
+}
+
+int column_add_code(Column *col, const char *text) {
+    return col->codes ? add_code(col, text, strlen(text)) : -1;
+}
+
+// Keep only the listed rows, in the given order
+bool column_take(Column *col, const int *rows, int count) {
+    Column out;
+    column_init_in(&out, col->type, col->arena);
+    if (col->codes) {
+        // Same dictionary; only the codes are picked
+        int capacity = count > 0 ? count : 1;
+        out.codes = resize_buffer(&out, NULL, 0, (size_t)capacity * sizeof(uint16_t));
+        out.validity = resize_buffer(&out, NULL, 0, (size_t)(capacity + 63) / 64 * sizeof(uint64_t));
+        out.capacity = capacity;
+        if (!out.codes || !out.validity || !copy_dictionary(&out, col)) {
+            column_free(&out);
+            return false;
+        }
+        memset(out.validity, 0, (size_t)(capacity + 63) / 64 * sizeof(uint64_t));
+        for (int i = 0; i < count; i++) {
+            out.codes[i] = col->codes[rows[i]];
+            set_valid(&out, i, column_is_valid(col, rows[i]));
+        }
+        out.length = count;
+        column_free(col);
+        *col = out;
+        return true;
+    }
+    if (!column_reserve(&out, count > 0 ? count : 1)) {
+        column_free(&out);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        int r = rows[i];
+        bool ok;
+        if (!column_is_valid(col, r)) {
+            ok = column_push_null(&out);
+        } else {
+            switch (col->type) {
+                case TYPE_INT: ok = column_push_int(&out, col->ints[r]); break;
+                case TYPE_FLOAT: ok = column_push_float(&out, col->floats[r]); break;
+                case TYPE_BOOL: ok = column_push_bool(&out, col->bools[r]); break;
+                default: {
+                    const char *s = column_string_at(col, r);
+                    ok = column_push_string(&out, s, strlen(s));
+                    break;
+                }
+            }
+        }
+        if (!ok) {
+            column_free(&out);
+            return false;
+        }
+    }
+    column_free(col);
+    *col = out;
+    return true;
+}
+
+// Keep the rows whose bit is set in `keep` (kept of them), in order, by
+// moving them down in place. Rows only ever move to lower positions, and
+// string bytes are stored in row order, so nothing is overwritten before it
+// has been read. Encoded columns only move their codes.
+void column_compact(Column *col, const uint64_t *keep, int kept) {
+    int dst = 0;
+    int64_t bytes_len = 0;
+    for (int w = 0; w * 64 < col->length; w++) {
+        uint64_t bits = keep[w];
+        if (col->length - w * 64 < 64) bits &= ((uint64_t)1 << (col->length - w * 64)) - 1;
+        for (; bits; bits &= bits - 1) {
+            int r = w * 64 + lowest_bit(bits);
+            bool valid = column_is_valid(col, r);
+            switch (col->type) {
+                case TYPE_INT: col->ints[dst] = col->ints[r]; break;
+                case TYPE_FLOAT: col->floats[dst] = col->floats[r]; break;
+                case TYPE_BOOL: col->bools[dst] = col->bools[r]; break;
+                default: {
+                    if (col->codes) {
+                        col->codes[dst] = col->codes[r];
+                        break;
+                    }
+                    int64_t end = r + 1 < col->length ? col->offsets[r + 1] : col->bytes_len;
+                    int64_t len = end - col->offsets[r];
+                    if (len > 0 && col->offsets[r] != bytes_len) {
+                        memmove(col->bytes + bytes_len, col->bytes + col->offsets[r], len);
+                    }
+                    col->offsets[dst] = bytes_len;
+                    bytes_len += len;
+                    break;
+                }
+            }
+            set_valid(col, dst, valid);
+            dst++;
+        }
+    }
+    if (is_string_storage(col->type) && !col->codes) col->bytes_len = bytes_len;
+    // Clear the bits of the rows that are gone
+    for (int r = dst; r < col->length && (r & 63); r++) set_valid(col, r, false);
+    for (int w = (dst + 63) / 64; w * 64 < col->length; w++) col->validity[w] = 0;
+    col->length = kept;
+}
+
+// Numeric value of a cell. String cells count when the whole text parses.
+bool column_get_number(const Column *col, int row, double *out) {
+    if (!column_is_valid(col, row)) return false;
+    switch (col->type) {
+        case TYPE_INT: *out = (double)col->ints[row]; return true;
+        case TYPE_FLOAT: *out = col->floats[row]; return true;
+        case TYPE_BOOL: return false;
+        default: {
+            const char *text = column_string_at(col, row);
+            return parse_double(text, strlen(text), out);
+        }
+    }
+}
+
+// Text of a cell. Strings are returned in place, other types are formatted
+// into `buf`. Missing values read as "N/A" for display; use
+// column_is_valid to tell them apart from a literal "N/A" string.
+const char *column_text(const Column *col, int row, char *buf, size_t size) {
+    if (!column_is_valid(col, row)) return "N/A";
+    switch (col->type) {
+        case TYPE_INT:
+        case TYPE_FLOAT: {
+            // Shortest text that reads back as the same value
+            char text[NUMBER_TEXT_LEN];
+            char *out = size >= NUMBER_TEXT_LEN ? buf : text;
+            if (col->type == TYPE_INT) format_int64(col->ints[row], out);
+            else format_double(col->floats[row], out);
+            if (out != buf) snprintf(buf, size, "%s", text);
+            return buf;
+        }
+        case TYPE_BOOL:
+            return col->bools[row] ? "true" : "false";
+        default:
+            return column_string_at(col, row);
+    }
+}
+
+// Set bits among the first `nbits` bits of a bitmap
+int bitmap_count(const uint64_t *bits, int nbits) {
+    int count = 0;
+    for (int w = 0; w * 64 < nbits; w++) {
+        uint64_t word = bits[w];
+        if (nbits - w * 64 < 64) word &= ((uint64_t)1 << (nbits - w * 64)) - 1;
+        count += popcount64(word);
+    }
+    return count;
+}
+
+// Nulls are the clear bits of the validity bitmap, counted a word at a time
+int column_null_count(const Column *col) {
+    return col->length - bitmap_count(col->validity, col->length);
+}
+
+// First null row at or after `from`, or -1 when there is none
+int column_next_null(const Column *col, int from) {
+    if (from < 0) from = 0;
+    if (from >= col->length) return -1;
+    int w = from / 64;
+    uint64_t missing = ~col->validity[w] & (~(uint64_t)0 << (from & 63));
+    int words = (col->length + 63) / 64;
+    for (;;) {
+        if (missing) {
+            int row = w * 64 + lowest_bit(missing);
+            return row < col->length ? row : -1;
+        }
+        if (++w == words) return -1;
+        missing = ~col->validity[w];
+    }
+}
@@ -0,0 +1,645 @@
+#include <stdlib.h>
+#include <string.h>
+#include "csvparse.h"
+#include "threadpool.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define INITIAL_FIELD_CAPACITY 4096
+#define INITIAL_INDEX_ROWS 1024
+#define BLOCK_SIZE 64
+#define PARALLEL_CHUNK_MIN (1 << 20) // smallest byte range worth its own thread
+
+static ScanMode scan_mode = SCAN_AUTO;
+
+// Make room for `extra` more fields
+static bool reserve_fields(CsvIndex *idx, int64_t extra) {
+    if (idx->field_count + extra <= idx->field_cap) return true;
+    int64_t cap = idx->field_cap ? idx->field_cap : INITIAL_FIELD_CAPACITY;
+    while (cap < idx->field_count + extra) cap *= 2;
+    FieldSpan *fields = realloc(idx->fields, cap * sizeof(FieldSpan));
+    if (!fields) return false;
+    idx->fields = fields;
+    idx->field_cap = cap;
+    return true;
+}
+
+static bool push_field(CsvIndex *idx, size_t start, size_t end, uint32_t flags) {
+    if (end - start > UINT32_MAX) return false;
+    if (end - start > idx->max_length) idx->max_length = (uint32_t)(end - start);
+    if (idx->field_count == idx->field_cap && !reserve_fields(idx, 1)) return false;
+    FieldSpan *span = &idx->fields[idx->field_count++];
+    span->offset = (int64_t)start;
+    span->length = (uint32_t)(end - start);
+    span->flags = flags;
+    return true;
+}
+
+// Make room for `extra` more rows
+static bool reserve_rows(CsvIndex *idx, int64_t extra) {
+    if (idx->row_count + extra < idx->row_cap) return true;
+    int64_t cap = idx->row_cap;
+    while (cap <= idx->row_count + extra) cap *= 2;
+    int64_t *row_start = realloc(idx->row_start, cap * sizeof(int64_t));
+    if (!row_start) return false;
+    idx->row_start = row_start;
+    idx->row_cap = cap;
+    return true;
+}
+
+static bool end_row(CsvIndex *idx) {
+    if (idx->row_count + 1 == idx->row_cap && !reserve_rows(idx, 1)) return false;
+    idx->row_start[++idx->row_count] = idx->field_count;
+    return true;
+}
+
+// First delimiter, '\n' or '\r' at or after pos
+static size_t scan_unquoted(const char *data, size_t pos, size_t size, char delim) {
+    while (pos < size) {
+        char c = data[pos];
+        if (c == delim || c == '\n' || c == '\r') break;
+        pos++;
+    }
+    return pos;
+}
+
+// Index one row starting at pos, byte by byte. Returns the position just
+// past the row terminator. Blank lines produce no row.
+static bool index_row_scalar(CsvIndex *idx, const char *data, size_t size, char delim, size_t *pos_io) {
+    size_t pos = *pos_io;
+    int64_t row_first = idx->field_count;
+    bool blank = false;
+    for (;;) {
+        size_t start = pos, end;
+        uint32_t flags = 0;
+
+        if (pos < size && data[pos] == '"') {
+            size_t p = pos + 1;
+            bool escaped = false, closed = false;
+            for (;;) {
+                const char *q = memchr(data + p, '"', size - p);
+                if (!q) {
+                    p = size; // unterminated quote runs to the end of input
+                    break;
+                }
+                p = q - data;
+                if (p + 1 < size && data[p + 1] == '"') {
+                    escaped = true;
+                    p += 2;
+                    continue;
+                }
+                p++;
+                closed = true;
+                break;
+            }
+            if (closed && !escaped && (p == size || data[p] == delim || data[p] == '\n' || data[p] == '\r')) {
+                start = pos + 1;
+                end = p - 1;
+                pos = p;
+            } else {
+                // Keep the raw text, including anything after the closing quote
+                end = scan_unquoted(data, p, size, delim);
+                flags = SPAN_ESCAPED;
+                pos = end;
+            }
+        } else {
+            end = scan_unquoted(data, pos, size, delim);
+            pos = end;
+            blank = (end == start && idx->field_count == row_first);
+        }
+
+        if (!push_field(idx, start, end, flags)) return false;
+
+        if (pos < size && data[pos] == delim) {
+            pos++;
+            blank = false;
+            continue;
+        }
+        // End of row: "\n", "\r\n" or a lone "\r"
+        if (pos < size && data[pos] == '\r') {
+            pos++;
+            if (pos < size && data[pos] == '\n') pos++;
+        } else if (pos < size && data[pos] == '\n') {
+            pos++;
+        }
+        break;
+    }
+
+    *pos_io = pos;
+    if (blank) {
+        idx->field_count = row_first; // empty line, not a row
+        return true;
+    }
+    return end_row(idx);
+}
+
+/* =========================================================
+ * Block scanner
+ * Classifies 64 bytes at a time into bitmaps (bit i = byte i) of quotes,
+ * delimiters and line breaks. The quote state of every byte is the prefix
+ * XOR of the quote bitmap, so delimiters and line breaks inside quotes drop
+ * out of the structural bitmap without a per-byte state machine. Quotes
+ * that do not sit at a field boundary are not RFC 4180; the row holding one
+ * is handed to the scalar parser, which gives such text its lenient meaning.
+ * ======================================================= */
+typedef struct
+{
+    uint64_t quote;
+    uint64_t delim;
+    uint64_t eol; // '\n' or '\r'
+    uint64_t sep; // delim | eol
+} BlockMasks;
+
+typedef void (*ClassifyFn)(const char *p, char delim, BlockMasks *m);
+
+static void classify_portable(const char *p, char delim, BlockMasks *m) {
+    uint64_t quote = 0, dl = 0, eol = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        char c = p[i];
+        quote |= (uint64_t)(c == '"') << i;
+        dl |= (uint64_t)(c == delim) << i;
+        eol |= (uint64_t)(c == '\n' || c == '\r') << i;
+    }
+    m->quote = quote;
+    m->delim = dl;
+    m->eol = eol;
+}
+
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+static void classify_sse2(const char *p, char delim, BlockMasks *m) {
+    const __m128i q = _mm_set1_epi8('"');
+    const __m128i d = _mm_set1_epi8(delim);
+    const __m128i n = _mm_set1_epi8('\n');
+    const __m128i r = _mm_set1_epi8('\r');
+    uint64_t quote = 0, dl = 0, eol = 0;
+    for (int i = 0; i < BLOCK_SIZE; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i e = _mm_or_si128(_mm_cmpeq_epi8(v, n), _mm_cmpeq_epi8(v, r));
+        quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)) << i;
+        dl |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, d)) << i;
+        eol |= (uint64_t)(uint16_t)_mm_movemask_epi8(e) << i;
+    }
+    m->quote = quote;
+    m->delim = dl;
+    m->eol = eol;
+}
+#endif
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static void classify_avx2(const char *p, char delim, BlockMasks *m) {
+    const __m256i q = _mm256_set1_epi8('"');
+    const __m256i d = _mm256_set1_epi8(delim);
+    const __m256i n = _mm256_set1_epi8('\n');
+    const __m256i r = _mm256_set1_epi8('\r');
+    __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    __m256i elo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, n), _mm256_cmpeq_epi8(lo, r));
+    __m256i ehi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, n), _mm256_cmpeq_epi8(hi, r));
+    m->quote = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, q)) |
+               (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, q)) << 32;
+    m->delim = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, d)) |
+               (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, d)) << 32;
+    m->eol = (uint64_t)(uint32_t)_mm256_movemask_epi8(elo) |
+             (uint64_t)(uint32_t)_mm256_movemask_epi8(ehi) << 32;
+}
+#endif
+
+// Bit i of the result is the XOR of bits 0..i of x
+static inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+static inline int popcount(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+#endif
+}
+
+static inline int lowest_bit(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+// Record the field [start, end) ending at a structural character
+static bool emit_field(CsvIndex *idx, const char *data, size_t start, size_t end) {
+    uint32_t flags = 0;
+    if (end > start && data[start] == '"') {
+        // Well-formed quoted field: plain unless it holds "" escapes
+        if (end - start >= 2 && data[end - 1] == '"' &&
+            !memchr(data + start + 1, '"', end - start - 2)) {
+            start++;
+            end--;
+        } else {
+            flags = SPAN_ESCAPED;
+        }
+    }
+    return push_field(idx, start, end, flags);
+}
+
+static bool finish_row(CsvIndex *idx, const char *data, int64_t row_first) {
+    const FieldSpan *f = &idx->fields[row_first];
+    if (idx->field_count - row_first == 1 && f->length == 0 && f->flags == 0 &&
+        (f->offset == 0 || data[f->offset - 1] != '"')) {
+        idx->field_count = row_first; // empty line, not a row
+        return true;
+    }
+    return end_row(idx);
+}
+
+// Index rows from pos until one ends at or past limit; *stop receives the
+// first byte of the next row.
+static bool index_blocks(CsvIndex *idx, const char *data, size_t size, char delim,
+                         size_t pos, size_t limit, size_t *stop, ClassifyFn classify) {
+    uint64_t in_quotes = 0;     // all ones while the previous block ended inside quotes
+    uint64_t prev_sep = 1;      // previous byte was a separator (or start of input)
+    uint64_t prev_quote = 0;    // previous byte was a quote
+    uint64_t prev_closing = 0;  // previous byte closed a quoted field
+    size_t field_start = pos;
+    size_t row_pos = pos;       // first byte of the current row
+    int64_t row_first = idx->field_count;
+    char tail[BLOCK_SIZE];
+
+    while (pos < size) {
+        const char *p = data + pos;
+        size_t avail = size - pos;
+        uint64_t valid = ~(uint64_t)0;
+        if (avail < BLOCK_SIZE) {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, p, avail);
+            p = tail;
+            valid = ((uint64_t)1 << avail) - 1;
+        }
+
+        BlockMasks m;
+        classify(p, delim, &m);
+        m.quote &= valid;
+        m.eol &= valid;
+        m.sep = (m.delim | m.eol) & valid;
+
+        uint64_t inside = prefix_xor(m.quote) ^ in_quotes;
+        uint64_t opening = m.quote & inside;
+        uint64_t closing = m.quote & ~inside;
+
+        // A quote may only open right after a separator or a closing quote
+        // ("" escape), and a closing quote must be followed by a separator
+        // or another quote.
+        uint64_t before_sep = (m.sep << 1) | prev_sep;
+        uint64_t before_quote = (m.quote << 1) | prev_quote;
+        uint64_t after_closing = (closing << 1) | prev_closing;
+        uint64_t bad = ((opening & ~(before_sep | before_quote)) |
+                        (after_closing & ~(m.sep | m.quote))) & valid;
+
+        uint64_t structural = m.sep & ~inside;
+        if (bad) structural &= ((uint64_t)1 << lowest_bit(bad)) - 1;
+        if (!reserve_fields(idx, popcount(structural) + 1)) return false;
+
+        // Plain fields are written straight into the span array; quoted ones
+        // and row ends take the slower helpers
+        FieldSpan *out = idx->fields + idx->field_count;
+        while (structural) {
+            int bit = lowest_bit(structural);
+            size_t s = pos + bit;
+            structural &= structural - 1;
+            if (s > field_start && data[field_start] == '"') {
+                idx->field_count = out - idx->fields;
+                if (!emit_field(idx, data, field_start, s)) return false;
+                out = idx->fields + idx->field_count;
+            } else {
+                size_t len = s - field_start;
+                if (len > UINT32_MAX) return false;
+                if (len > idx->max_length) idx->max_length = (uint32_t)len;
+                out->offset = (int64_t)field_start;
+                out->length = (uint32_t)len;
+                out->flags = 0;
+                out++;
+            }
+            field_start = s + 1;
+            if ((m.eol >> bit) & 1) {
+                idx->field_count = out - idx->fields;
+                if (!finish_row(idx, data, row_first)) return false;
+                row_first = idx->field_count;
+                row_pos = field_start;
+                if (row_pos >= limit) {
+                    *stop = row_pos;
+                    return true;
+                }
+                out = idx->fields + idx->field_count;
+            }
+        }
+        idx->field_count = out - idx->fields;
+
+        if (bad) {
+            // Re-parse the offending row byte by byte, then resume in blocks
+            idx->field_count = row_first;
+            pos = row_pos;
+            if (!index_row_scalar(idx, data, size, delim, &pos)) return false;
+            if (pos >= limit) {
+                *stop = pos;
+                return true;
+            }
+            field_start = row_pos = pos;
+            row_first = idx->field_count;
+            in_quotes = 0;
+            prev_sep = 1;
+            prev_quote = prev_closing = 0;
+            continue;
+        }
+
+        in_quotes = (uint64_t)((int64_t)inside >> 63);
+        prev_sep = m.sep >> 63;
+        prev_quote = m.quote >> 63;
+        prev_closing = closing >> 63;
+        pos += BLOCK_SIZE;
+    }
+
+    // Last row without a trailing line break
+    if (field_start < size || idx->field_count > row_first) {
+        if (!emit_field(idx, data, field_start, size)) return false;
+        if (!finish_row(idx, data, row_first)) return false;
+    }
+    *stop = size;
+    return true;
+}
+
+static ClassifyFn pick_classifier(ScanMode mode) {
+#ifdef HAVE_X86_SIMD
+    if ((mode == SCAN_AUTO || mode == SCAN_AVX2) && __builtin_cpu_supports("avx2")) return classify_avx2;
+#endif
+#if defined(HAVE_X86_SIMD) && defined(__SSE2__)
+    if (mode == SCAN_AUTO || mode == SCAN_AVX2 || mode == SCAN_SSE2) return classify_sse2;
+#endif
+    return classify_portable;
+}
+
+void csv_set_scan_mode(ScanMode mode) {
+    scan_mode = mode;
+}
+
+ScanMode csv_scan_mode(void) {
+    return scan_mode;
+}
+
+const char *csv_scan_mode_name(ScanMode mode) {
+    static const char *const names[SCAN_MODES] = {"auto", "scalar", "block", "sse2", "avx2"};
+    return mode >= 0 && mode < SCAN_MODES ? names[mode] : "?";
+}
+
+bool csv_scan_supported(ScanMode mode) {
+    switch (mode) {
+        case SCAN_AVX2: return pick_classifier(SCAN_AVX2) != pick_classifier(SCAN_SSE2);
+        case SCAN_SSE2: return pick_classifier(SCAN_SSE2) != classify_portable;
+        default: return mode >= 0 && mode < SCAN_MODES;
+    }
+}
+
+static bool index_init(CsvIndex *idx) {
+    memset(idx, 0, sizeof(*idx));
+    idx->row_cap = INITIAL_INDEX_ROWS;
+    idx->row_start = malloc(idx->row_cap * sizeof(int64_t));
+    if (!idx->row_start) return false;
+    idx->row_start[0] = 0;
+    return true;
+}
+
+// Index the rows that start in [pos, limit). A NULL classifier selects the
+// byte-by-byte parser. *stop receives the first byte after the last row.
+static bool index_range(CsvIndex *idx, const char *data, size_t size, char delim,
+                        size_t pos, size_t limit, size_t *stop, ClassifyFn classify) {
+    if (classify) return index_blocks(idx, data, size, delim, pos, limit, stop, classify);
+    bool ok = true;
+    while (ok && pos < limit) ok = index_row_scalar(idx, data, size, delim, &pos);
+    *stop = pos;
+    return ok;
+}
+
+/* =========================================================
+ * Chunked parsing
+ * The input is cut into one byte range per thread. The quote parity of
+ * every range is counted in parallel; a prefix XOR over those counts says
+ * whether each cut falls inside a quoted field, so every thread can find
+ * the first real row start after its cut and index its rows on its own.
+ * The guess is only trusted when the previous range ends exactly where the
+ * next one begins; any range that does not line up is parsed again
+ * serially from the true boundary.
+ * ======================================================= */
+typedef struct
+{
+    const char *data;
+    size_t size;
+    char delim;
+    ClassifyFn classify;
+    size_t *bounds;    // chunk i covers [bounds[i], bounds[i + 1])
+    uint8_t *parity;   // odd number of quotes in chunk i
+    size_t *starts;    // first row start found in chunk i
+    size_t *stops;     // first byte after the rows of chunk i
+    CsvIndex *parts;
+    bool *ok;
+} ChunkJob;
+
+static void count_quotes(int i, void *ctx) {
+    ChunkJob *job = ctx;
+    const char *data = job->data;
+    size_t pos = job->bounds[i], end = job->bounds[i + 1];
+    uint64_t count = 0;
+    if (job->classify) {
+        for (; pos + BLOCK_SIZE <= end; pos += BLOCK_SIZE) {
+            BlockMasks m;
+            job->classify(data + pos, job->delim, &m);
+            count += popcount(m.quote);
+        }
+    }
+    for (; pos < end; pos++) count += data[pos] == '"';
+    job->parity[i] = (uint8_t)(count & 1);
+}
+
+// First byte after a line break outside quotes, scanning from pos
+static size_t find_row_start(const char *data, size_t pos, size_t limit, bool in_quotes) {
+    for (; pos < limit; pos++) {
+        char c = data[pos];
+        if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (!in_quotes && (c == '\n' || c == '\r')) {
+            pos++;
+            if (c == '\r' && pos < limit && data[pos] == '\n') pos++;
+            return pos;
+        }
+    }
+    return limit;
+}
+
+static void index_chunk(int i, void *ctx) {
+    ChunkJob *job = ctx;
+    size_t limit = job->bounds[i + 1];
+    size_t start = job->starts[i];
+    if (i > 0) start = job->starts[i] = find_row_start(job->data, job->bounds[i], limit, job->parity[i]);
+    if (start >= limit) {
+        job->stops[i] = start;
+        job->ok[i] = true;
+        return;
+    }
+    job->ok[i] = index_range(&job->parts[i], job->data, job->size, job->delim, start, limit,
+                             &job->stops[i], job->classify);
+}
+
+// Only line breaks between pos and end, i.e. blank lines the parser skips
+static bool only_line_breaks(const char *data, size_t pos, size_t end) {
+    for (; pos < end; pos++) {
+        if (data[pos] != '\n' && data[pos] != '\r') return false;
+    }
+    return true;
+}
+
+static bool append_index(CsvIndex *idx, const CsvIndex *part) {
+    if (!reserve_fields(idx, part->field_count) || !reserve_rows(idx, part->row_count)) return false;
+    if (part->field_count > 0) {
+        memcpy(idx->fields + idx->field_count, part->fields, part->field_count * sizeof(FieldSpan));
+    }
+    for (int64_t r = 1; r <= part->row_count; r++) {
+        idx->row_start[idx->row_count + r] = idx->field_count + part->row_start[r];
+    }
+    idx->field_count += part->field_count;
+    idx->row_count += part->row_count;
+    if (part->max_length > idx->max_length) idx->max_length = part->max_length;
+    return true;
+}
+
+static bool index_parallel(CsvIndex *idx, const char *data, size_t size, char delim,
+                           size_t pos, int chunks, ClassifyFn classify) {
+    ChunkJob job = {data, size, delim, classify, NULL, NULL, NULL, NULL, NULL, NULL};
+    job.bounds = malloc((chunks + 1) * sizeof(size_t));
+    job.parity = calloc(chunks + 1, sizeof(uint8_t));
+    job.starts = malloc(chunks * sizeof(size_t));
+    job.stops = malloc(chunks * sizeof(size_t));
+    job.parts = calloc(chunks, sizeof(CsvIndex));
+    job.ok = calloc(chunks, sizeof(bool));
+    bool ok = job.bounds && job.parity && job.starts && job.stops && job.parts && job.ok;
+
+    for (int i = 0; ok && i < chunks; i++) {
+        job.bounds[i] = pos + (size - pos) / chunks * i;
+        ok = i == 0 || index_init(&job.parts[i]);
+    }
+    if (ok) {
+        job.bounds[chunks] = size;
+        job.starts[0] = pos;
+        job.parts[0] = *idx; // chunk 0 is indexed in place
+
+        parallel_for(chunks, count_quotes, &job);
+        // Turn per-chunk parity into "chunk i starts inside quotes"
+        uint8_t inside = 0;
+        for (int i = 0; i < chunks; i++) {
+            uint8_t p = job.parity[i];
+            job.parity[i] = inside;
+            inside ^= p;
+        }
+        parallel_for(chunks, index_chunk, &job);
+
+        *idx = job.parts[0];
+        memset(&job.parts[0], 0, sizeof(CsvIndex));
+        ok = job.ok[0];
+    }
+
+    // Stitch the chunks together, re-parsing any whose guessed start was wrong
+    size_t cursor = ok ? job.stops[0] : size;
+    for (int i = 1; ok && i < chunks; i++) {
+        size_t limit = job.bounds[i + 1];
+        if (cursor >= limit) continue; // already covered by an earlier row
+        size_t start = job.starts[i];
+        if (job.ok[i] && start < limit && start >= cursor && only_line_breaks(data, cursor, start)) {
+            ok = append_index(idx, &job.parts[i]);
+            cursor = job.stops[i];
+        } else {
+            ok = index_range(idx, data, size, delim, cursor, limit, &cursor, classify);
+        }
+    }
+
+    if (job.parts) {
+        for (int i = 1; i < chunks; i++) csv_index_free(&job.parts[i]);
+    }
+    free(job.bounds);
+    free(job.parity);
+    free(job.starts);
+    free(job.stops);
+    free(job.parts);
+    free(job.ok);
+    return ok;
+}
+
+// Index every field of an RFC 4180 style buffer without copying it.
+// Quoted fields may contain delimiters, newlines and "" escapes; blank
+// lines are skipped and a UTF-8 byte order mark is ignored. Large inputs
+// are split across the shared thread pool.
+bool csv_index_build(CsvIndex *idx, const char *data, size_t size, char delim) {
+    if (!index_init(idx)) return false;
+
+    size_t pos = 0;
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) pos = 3;
+
+    ClassifyFn classify = (scan_mode == SCAN_SCALAR || delim == '"') ? NULL : pick_classifier(scan_mode);
+    size_t chunks = (size - pos) / PARALLEL_CHUNK_MIN;
+    size_t threads = (size_t)get_thread_count();
+    if (chunks > threads) chunks = threads;
+
+    bool ok;
+    if (chunks > 1 && delim != '"') {
+        ok = index_parallel(idx, data, size, delim, pos, (int)chunks, classify);
+    } else {
+        size_t stop;
+        ok = index_range(idx, data, size, delim, pos, size, &stop, classify);
+    }
+    if (!ok) csv_index_free(idx);
+    return ok;
+}
+
+void csv_index_free(CsvIndex *idx) {
+    free(idx->fields);
+    free(idx->row_start);
+    memset(idx, 0, sizeof(*idx));
+}
+
+// Copy the value of a field into out (at least span->length bytes),
+// removing quotes and turning "" into ". Returns the decoded length.
+size_t csv_span_decode(const char *data, const FieldSpan *span, char *out) {
+    const char *raw = data + span->offset;
+    if (!(span->flags & SPAN_ESCAPED)) {
+        memcpy(out, raw, span->length);
+        return span->length;
+    }
+    size_t n = 0;
+    bool in_quotes = false;
+    for (uint32_t i = 0; i < span->length; i++) {
+        char c = raw[i];
+        if (c == '"') {
+            if (in_quotes && i + 1 < span->length && raw[i + 1] == '"') {
+                out[n++] = '"';
+                i++;
+            } else {
+                in_quotes = !in_quotes;
+            }
+        } else {
+            out[n++] = c;
+        }
+    }
+    return n;
+}
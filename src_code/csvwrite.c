@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+#include "csvwrite.h"
+#include "numformat.h"
+#include "threadpool.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+// Growable output buffer for one block of rows
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    bool ok;
+} Chunk;
+
+static bool reserve(Chunk *c, size_t extra) {
+    if (c->len + extra <= c->cap) return true;
+    size_t cap = c->cap ? c->cap : 1 << 16;
+    while (cap < c->len + extra) cap *= 2;
+    char *data = realloc(c->data, cap);
+    if (!data) return c->ok = false;
+    c->data = data;
+    c->cap = cap;
+    return true;
+}
+
+// Append text, quoted if a reader would otherwise split it
+static void put_field(Chunk *c, const char *text, size_t len) {
+    bool quote = memchr(text, ',', len) || memchr(text, '"', len) ||
+                 memchr(text, '\n', len) || memchr(text, '\r', len);
+    if (!quote) {
+        if (!reserve(c, len)) return;
+        memcpy(c->data + c->len, text, len);
+        c->len += len;
+        return;
+    }
+    // At worst every byte is a quote that doubles, plus the outer pair
+    if (!reserve(c, 2 * len + 2)) return;
+    char *p = c->data + c->len;
+    *p++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '"') *p++ = '"';
+        *p++ = text[i];
+    }
+    *p++ = '"';
+    c->len = p - c->data;
+}
+
+static void put_cell(Chunk *c, const Column *col, int row) {
+    if (!column_is_valid(col, row)) return;
+    switch (col->type) {
+        case TYPE_INT:
+        case TYPE_FLOAT:
+            if (!reserve(c, NUMBER_TEXT_LEN)) return;
+            c->len += col->type == TYPE_INT ? format_int64(col->ints[row], c->data + c->len)
+                                            : format_double(col->floats[row], c->data + c->len);
+            break;
+        case TYPE_BOOL:
+            put_field(c, col->bools[row] ? "true" : "false", col->bools[row] ? 4 : 5);
+            break;
+        default: {
+            const char *s = column_string_at(col, row);
+            put_field(c, s, strlen(s));
+            break;
+        }
+    }
+}
+
+typedef struct
+{
+    const Table *table;
+    Chunk *chunks;
+    int first_block; // block encoded by chunks[0]
+} EncodeJob;
+
+static void encode_block(int i, void *ctx) {
+    EncodeJob *job = ctx;
+    const Table *t = job->table;
+    Chunk *c = &job->chunks[i];
+    c->len = 0;
+    int start = (job->first_block + i) * WRITE_BLOCK_ROWS;
+    int end = start + WRITE_BLOCK_ROWS < t->rows ? start + WRITE_BLOCK_ROWS : t->rows;
+    for (int r = start; r < end && c->ok; r++) {
+        for (int j = 0; j < t->cols; j++) {
+            put_cell(c, &t->columns[j], r);
+            if (reserve(c, 1)) c->data[c->len++] = j < t->cols - 1 ? ',' : '\n';
+        }
+    }
+}
+
+// Write chunks in order. POSIX systems hand them all to writev at once;
+// elsewhere each goes out in one fwrite.
+static bool write_chunks(FILE *fp, Chunk *chunks, int count) {
+#ifndef _WIN32
+    struct iovec iov[64];
+    int fd = fileno(fp);
+    if (fflush(fp) != 0) return false;
+    for (int first = 0; first < count; first += 64) {
+        int n = count - first < 64 ? count - first : 64;
+        for (int i = 0; i < n; i++) {
+            iov[i].iov_base = chunks[first + i].data;
+            iov[i].iov_len = chunks[first + i].len;
+        }
+        struct iovec *v = iov;
+        while (n > 0) {
+            ssize_t written = writev(fd, v, n);
+            if (written < 0) return false;
+            // Skip what was written, which may end part way into a chunk
+            while (n > 0 && (size_t)written >= v->iov_len) {
+                written -= v->iov_len;
+                v++;
+                n--;
+            }
+            if (n > 0) {
+                v->iov_base = (char *)v->iov_base + written;
+                v->iov_len -= written;
+            }
+        }
+    }
+    return true;
+#else
+    for (int i = 0; i < count; i++) {
+        if (chunks[i].len > 0 && fwrite(chunks[i].data, 1, chunks[i].len, fp) != chunks[i].len) return false;
+    }
+    return true;
+#endif
+}
+
+bool csv_write_table(const Table *table, FILE *fp) {
+    // Enough blocks per round to keep every thread busy
+    int per_round = get_thread_count() * 2;
+    int blocks = (table->rows + WRITE_BLOCK_ROWS - 1) / WRITE_BLOCK_ROWS;
+    if (per_round > blocks) per_round = blocks;
+    if (per_round < 1) per_round = 1;
+    Chunk *chunks = calloc(per_round, sizeof(Chunk));
+    if (!chunks) return false;
+    for (int i = 0; i < per_round; i++) chunks[i].ok = true;
+
+    // Header row
+    Chunk *c = &chunks[0];
+    for (int j = 0; j < table->cols; j++) {
+        const char *name = table->headers[j] ? table->headers[j] : "N/A";
+        put_field(c, name, strlen(name));
+        if (reserve(c, 1)) c->data[c->len++] = j < table->cols - 1 ? ',' : '\n';
+    }
+    bool ok = c->ok && write_chunks(fp, chunks, 1);
+
+    EncodeJob job = {table, chunks, 0};
+    for (; ok && job.first_block < blocks; job.first_block += per_round) {
+        int n = blocks - job.first_block < per_round ? blocks - job.first_block : per_round;
+        parallel_for(n, encode_block, &job);
+        for (int i = 0; i < n; i++) ok = ok && chunks[i].ok;
+        ok = ok && write_chunks(fp, chunks, n);
+    }
+
+    for (int i = 0; i < per_round; i++) free(chunks[i].data);
+    free(chunks);
+    return ok;
+}
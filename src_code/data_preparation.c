@@ -5,24 +5,192 @@
 #include <float.h>
 #include <math.h>
 #include "data_preparation.h"
+#include "numformat.h"
+#include "dictionary.h"
+#include "stats.h"
+#include "impute.h"
+#include "threadpool.h"
+#include "statcache.h"
+
+// Swap a rebuilt column into place
+static void replace_column(Column *col, Column *out) {
+    column_free(col);
+    *col = *out;
+}
+
+// Map every numeric cell v of a column to a + (v - vmin) * scale.
+// Typed columns are rewritten in place as floats; string columns can mix
+// numbers with text, so they are rebuilt with the new values as text.
+static int rescale_column(Column *col, double vmin, double scale, double a, const char *tag) {
+    if (column_is_numeric(col)) {
+        if (!column_convert(col, TYPE_FLOAT)) {
+            printf("[%s] Error: Memory allocation failed\n", tag);
+            return 0;
+        }
+        for (int r = 0; r < col->length; ++r) {
+            if (column_is_valid(col, r)) col->floats[r] = a + (col->floats[r] - vmin) * scale;
+            if (col->length > 100 && (r + 1) % (col->length / 10 + 1) == 0) {
+                printf("[%s] Progress: Processed %d/%d rows\n", tag, r + 1, col->length);
+            }
+        }
+        return 1;
+    }
 
-// Helper functions
-int parse_num(const char *s, double *out) {
-    if (!s || !*s) return 0;
-    char *end;
-    double v = strtod(s, &end);
-    if (*end) return 0;
-    if (out) *out = v;
+    Column out;
+    column_init_in(&out, col->type, col->arena);
+    char buf[NUMBER_TEXT_LEN];
+    double v;
+    for (int r = 0; r < col->length; ++r) {
+        int ok;
+        if (column_get_number(col, r, &v)) {
+            int len = format_double(a + (v - vmin) * scale, buf);
+            ok = column_push_string(&out, buf, len);
+        } else if (column_is_valid(col, r)) {
+            const char *s = column_get_string(col, r);
+            ok = column_push_string(&out, s, strlen(s));
+        } else {
+            ok = column_push_null(&out);
+        }
+        if (!ok) {
+            printf("[%s] Error: Memory allocation failed for row %d\n", tag, r);
+            column_free(&out);
+            return 0;
+        }
+        if (col->length > 100 && (r + 1) % (col->length / 10 + 1) == 0) {
+            printf("[%s] Progress: Processed %d/%d rows\n", tag, r + 1, col->length);
+        }
+    }
+    replace_column(col, &out);
     return 1;
 }
 
-static int cmpdbl(const void *a, const void *b) {
-    double A = *(double *)a, B = *(double *)b;
-    return (A > B) - (A < B);
+// Smallest and largest finite value of a column, among the rows set in
+// `rows` when given; false if there is none. NaN and infinities would make
+// the range, and every bucket cut from it, meaningless.
+bool numeric_range(const Column *col, const uint64_t *rows, double *vmin, double *vmax) {
+    double v;
+    int valid_count = 0;
+    *vmin = DBL_MAX;
+    *vmax = -DBL_MAX;
+    for (int r = 0; r < col->length; ++r) {
+        if (rows && !((rows[r >> 6] >> (r & 63)) & 1)) continue;
+        if (column_get_number(col, r, &v) && isfinite(v)) {
+            if (v < *vmin) *vmin = v;
+            if (v > *vmax) *vmax = v;
+            valid_count++;
+        }
+    }
+    return valid_count > 0;
+}
+
+// The map scale_to_range applies for target [a, b] and data range
+// [vmin, vmax]: every value to the midpoint when the data is constant
+Rescale rescale_for(double a, double b, double vmin, double vmax) {
+    if (fabs(vmax - vmin) < 1e-12) return (Rescale){(a + b) / 2.0, vmin, 0.0};
+    return (Rescale){a, vmin, (b - a) / (vmax - vmin)};
+}
+
+static inline double apply_maps(const Rescale *maps, int count, double v) {
+    for (int i = 0; i < count; i++) v = maps[i].a + (v - maps[i].vmin) * maps[i].scale;
+    return v;
+}
+
+// Range of the mapped values. Each step of a map rounds monotonically, so
+// the ends map to the ends (swapped when a scale is negative).
+void rescaled_range(const Rescale *maps, int count, double *vmin, double *vmax) {
+    double lo = apply_maps(maps, count, *vmin), hi = apply_maps(maps, count, *vmax);
+    *vmin = lo < hi ? lo : hi;
+    *vmax = lo < hi ? hi : lo;
 }
 
-static double median(const double *a, int n) {
-    return (n & 1) ? a[n / 2] : (a[n / 2 - 1] + a[n / 2]) / 2.0;
+// Rewrite a typed numeric column as floats passed through the maps in
+// turn, as that many scale_to_range calls would
+bool rescale_numbers(Column *col, const Rescale *maps, int count) {
+    if (!column_is_numeric(col) || !column_convert(col, TYPE_FLOAT)) return false;
+    for (int r = 0; r < col->length; ++r) {
+        if (column_is_valid(col, r)) col->floats[r] = apply_maps(maps, count, col->floats[r]);
+    }
+    return true;
+}
+
+// Rebuild a column as the labels of the buckets its numbers fall in, the
+// numbers first passed through `maps`. Labels are text, so the result is a
+// string column. NaN and infinities fall in no bucket and become N/A;
+// values outside [vmin, vmax] go to the first or last bucket. Progress is
+// reported under `tag` unless it is NULL.
+static int write_buckets(Column *column, double vmin, double vmax, int nbuckets, const Rescale *maps, int count,
+                         const char *tag) {
+    double width = (vmax - vmin) / nbuckets;
+    char label[64];
+    double v;
+    Column out;
+    column_init_in(&out, TYPE_STRING, column->arena);
+    // Numeric columns hold no text, so every row is one of the nbuckets
+    // labels: each is formatted once and rows get its dictionary code
+    int *codes = NULL;
+    if (column_is_numeric(column) && nbuckets <= get_dictionary_limit()) {
+        codes = malloc(nbuckets * sizeof(int));
+        if (codes && !column_begin_dictionary(&out)) {
+            free(codes);
+            codes = NULL;
+        }
+        for (int k = 0; codes && k < nbuckets; k++) codes[k] = -1;
+    }
+    for (int r = 0; r < column->length; ++r) {
+        int ok;
+        bool number = column_get_number(column, r, &v);
+        if (number) v = apply_maps(maps, count, v);
+        if (number && !isfinite(v)) {
+            ok = column_push_null(&out);
+        } else if (number) {
+            // Clamp before the cast: vmax itself lands on nbuckets, and the
+            // maps' rounding can step just outside [vmin, vmax]
+            double pos = floor((v - vmin) / width);
+            int idx = pos >= nbuckets ? nbuckets - 1 : pos > 0 ? (int)pos : 0;
+            if (!codes || codes[idx] < 0) {
+                double lo = vmin + idx * width;
+                double hi = lo + width;
+                snprintf(label, sizeof(label), "[%.2f-%.2f)", lo, hi);
+                if (codes) codes[idx] = column_add_code(&out, label);
+            }
+            if (codes) ok = codes[idx] >= 0 && column_push_code(&out, codes[idx]);
+            else ok = column_push_string(&out, label, strlen(label));
+        } else if (column_is_valid(column, r)) {
+            const char *text = column_text(column, r, label, sizeof(label));
+            ok = column_push_string(&out, text, strlen(text));
+        } else {
+            ok = column_push_null(&out);
+        }
+        if (!ok) {
+            if (tag) printf("[%s] Error: Memory allocation failed for row %d\n", tag, r);
+            column_free(&out);
+            free(codes);
+            return 0;
+        }
+        if (tag && column->length > 100 && (r + 1) % (column->length / 10 + 1) == 0) {
+            printf("[%s] Progress: Processed %d/%d rows\n", tag, r + 1, column->length);
+        }
+    }
+    free(codes);
+    column_encode_dictionary(&out, get_dictionary_limit());
+    replace_column(column, &out);
+    return 1;
+}
+
+bool bucket_numbers(Column *col, const Rescale *maps, int count, double vmin, double vmax, int nbuckets) {
+    return write_buckets(col, vmin, vmax, nbuckets, maps, count, NULL);
+}
+
+// Range of the numbers in a column, from the stats cache when it holds
+// the column's summary
+static bool column_range(const Table *t, int col, double *vmin, double *vmax) {
+    const ColumnSummary *s = table_cached_summary(t, col);
+    if (s && s->numeric && s->count > 0 && isfinite(s->min) && isfinite(s->max)) {
+        *vmin = s->min;
+        *vmax = s->max;
+        return true;
+    }
+    return numeric_range(&t->columns[col], NULL, vmin, vmax);
 }
 
 /* =========================================================
@@ -40,17 +208,9 @@ int bucket_col(Table *t, int col, int nbuckets, int preserve_header) {
         return 0;
     }
 
-    double vmin = DBL_MAX, vmax = -DBL_MAX, v;
-    int valid_count = 0;
-    for (int r = 0; r < t->rows; ++r) {
-        if (parse_num(t->data[r][col], &v)) {
-            if (v < vmin) vmin = v;
-            if (v > vmax) vmax = v;
-            valid_count++;
-        }
-    }
-
-    if (valid_count == 0) {
+    Column *column = &t->columns[col];
+    double vmin, vmax;
+    if (!column_range(t, col, &vmin, &vmax)) {
         printf("[bucket_col] Error: No valid numeric data in column %d\n", col);
         return 0;
     }
@@ -58,39 +218,16 @@ int bucket_col(Table *t, int col, int nbuckets, int preserve_header) {
         printf("[bucket_col] Warning: All values in column %d are identical (%.6g). Adjusting range.\n", col, vmin);
         vmax = vmin + 1.0;
     }
-
-    double width = (vmax - vmin) / nbuckets;
-    char label[64];
-    for (int r = 0; r < t->rows; ++r) {
-        if (parse_num(t->data[r][col], &v)) {
-            int idx = (int)floor((v - vmin) / width);
-            if (idx == nbuckets) idx--;
-            double lo = vmin + idx * width;
-            double hi = lo + width;
-            snprintf(label, sizeof(label), "[%.2f-%.2f)", lo, hi);
-            char *new_str = strdup(label);
-            if (!new_str) {
-                printf("[bucket_col] Error: Memory allocation failed for row %d\n", r);
-                return 0;
-            }
-            free(t->data[r][col]);
-            t->data[r][col] = new_str;
-        }
-        if (t->rows > 100 && (r + 1) % (t->rows / 10 + 1) == 0) {
-            printf("[bucket_col] Progress: Processed %d/%d rows\n", r + 1, t->rows);
-        }
-    }
+    if (!write_buckets(column, vmin, vmax, nbuckets, NULL, 0, "bucket_col")) return 0;
+    table_stats_changed(t, col);
 
     if (!preserve_header && t->headers && t->headers[col]) {
         char buf[128];
         snprintf(buf, sizeof(buf), "%s_binned_%d", t->headers[col], nbuckets);
-        char *new_header = strdup(buf);
-        if (!new_header) {
+        if (!table_set_header(t, col, buf)) {
             printf("[bucket_col] Error: Memory allocation failed for header\n");
             return 0;
         }
-        free(t->headers[col]);
-        t->headers[col] = new_header;
     }
 
     printf("[bucket_col] Success: Column %d bucketed into %d ranges\n", col, nbuckets);
@@ -103,6 +240,58 @@ int bucket_col(Table *t, int col, int nbuckets, int preserve_header) {
  * Arguments: Table *t
  * Returns: 1 on success, 0 on failure
  * ======================================================= */
+typedef struct
+{
+    int n;              // numeric values
+    double q1, q3;
+    RowValue *outliers; // by value, then row
+    int count;          // -1 when out of memory
+} ColumnOutliers;
+
+typedef struct
+{
+    const Table *t;
+    ColumnOutliers *out;
+} OutlierJob;
+
+static int cmp_row_value(const void *a, const void *b) {
+    const RowValue *A = a, *B = b;
+    if (A->value != B->value) return (A->value > B->value) - (A->value < B->value);
+    return A->row - B->row;
+}
+
+// Median of the slice [from, from + len) the values would have sorted
+static double median_at(double *vals, int n, int from, int len) {
+    if (len & 1) return select_kth(vals, n, from + len / 2);
+    return (select_kth(vals, n, from + len / 2 - 1) + select_kth(vals, n, from + len / 2)) / 2.0;
+}
+
+static void outlier_task(int col, void *ctx) {
+    OutlierJob *job = ctx;
+    const Column *column = &job->t->columns[col];
+    ColumnOutliers *out = &job->out[col];
+    double *vals = malloc((job->t->rows > 0 ? job->t->rows : 1) * sizeof(double));
+    if (!vals) {
+        out->count = -1;
+        return;
+    }
+    double v;
+    for (int r = 0; r < job->t->rows; ++r) {
+        if (column_get_number(column, r, &v)) vals[out->n++] = v;
+    }
+    if (out->n >= 4) {
+        // Quartiles as medians of the lower and upper halves, found by
+        // selection instead of a full sort
+        int n = out->n, half = n / 2;
+        out->q1 = median_at(vals, n, 0, half);
+        out->q3 = median_at(vals, n, n % 2 ? half + 1 : half, half);
+        double iqr = out->q3 - out->q1;
+        out->count = column_values_outside(column, out->q1 - 1.5 * iqr, out->q3 + 1.5 * iqr, false, &out->outliers);
+        if (out->count > 0) qsort(out->outliers, out->count, sizeof(RowValue), cmp_row_value);
+    }
+    free(vals);
+}
+
 int outlier_detection(Table *t) {
     printf("[outlier_detection] Starting outlier detection across %d columns...\n", t ? t->cols : 0);
     
@@ -112,57 +301,44 @@ int outlier_detection(Table *t) {
         return 0;
     }
 
-    int any = 0;
+    // Columns are searched in parallel, then reported in column order
+    OutlierJob job = {t, calloc(t->cols, sizeof(ColumnOutliers))};
+    if (!job.out) {
+        printf("[outlier_detection] Error: Memory allocation failed\n");
+        return 0;
+    }
+    parallel_for(t->cols, outlier_task, &job);
+
+    int any = 0, ok = 1;
     for (int col = 0; col < t->cols; ++col) {
-        double *vals = malloc(t->rows * sizeof(double));
-        int *rows = malloc(t->rows * sizeof(int));
-        if (!vals || !rows) {
+        ColumnOutliers *out = &job.out[col];
+        if (out->count < 0) {
             printf("[outlier_detection] Error: Memory allocation failed for column %d\n", col);
-            free(vals);
-            free(rows);
-            return 0;
+            ok = 0;
+            break;
         }
-
-        int n = 0;
-        double v;
-        for (int r = 0; r < t->rows; ++r) {
-            if (parse_num(t->data[r][col], &v)) {
-                vals[n] = v;
-                rows[n] = r;
-                ++n;
-            }
-        }
-
-        if (n < 4) {
-            printf("[outlier_detection] Skipping column %d: Insufficient numeric data (%d values)\n", col, n);
-            free(vals);
-            free(rows);
+        if (out->n < 4) {
+            printf("[outlier_detection] Skipping column %d: Insufficient numeric data (%d values)\n", col, out->n);
             continue;
         }
 
-        qsort(vals, n, sizeof(double), cmpdbl);
-        int half = n / 2;
-        double q1 = median(vals, half);
-        double q3 = median(vals + (n % 2 ? half + 1 : half), half);
-        double iqr = q3 - q1, lo = q1 - 1.5 * iqr, hi = q3 + 1.5 * iqr;
-
-        for (int i = 0; i < n; ++i) {
-            if (vals[i] < lo || vals[i] > hi) {
-                if (!any) {
-                    printf("\n[outlier_detection] Outliers detected:\n");
-                    any = 1;
-                }
-                printf("  Column %d, Row %d: Value %.6g (Q1=%.6g, Q3=%.6g, IQR=%.6g)\n",
-                       col, rows[i], vals[i], q1, q3, iqr);
+        double iqr = out->q3 - out->q1;
+        for (int i = 0; i < out->count; ++i) {
+            if (!any) {
+                printf("\n[outlier_detection] Outliers detected:\n");
+                any = 1;
             }
+            printf("  Column %d, Row %d: Value %.6g (Q1=%.6g, Q3=%.6g, IQR=%.6g)\n",
+                   col, out->outliers[i].row, out->outliers[i].value, out->q1, out->q3, iqr);
         }
-        free(vals);
-        free(rows);
 
         if (t->rows > 100 && (col + 1) % (t->cols / 10 + 1) == 0) {
             printf("[outlier_detection] Progress: Processed %d/%d columns\n", col + 1, t->cols);
         }
     }
+    for (int col = 0; col < t->cols; ++col) free(job.out[col].outliers);
+    free(job.out);
+    if (!ok) return 0;
 
     if (!any) {
         printf("[outlier_detection] No outliers detected in any column.\n");
@@ -186,84 +362,35 @@ int scale_to_range(Table *t, int col, double a, double b, int preserve_header) {
         return 0;
     }
 
-    double vmin = DBL_MAX, vmax = -DBL_MAX, v;
-    int valid_count = 0;
-    for (int r = 0; r < t->rows; ++r) {
-        if (parse_num(t->data[r][col], &v)) {
-            if (v < vmin) vmin = v;
-            if (v > vmax) vmax = v;
-            valid_count++;
-        }
-    }
-
-    if (valid_count == 0) {
+    Column *column = &t->columns[col];
+    double vmin, vmax;
+    if (!column_range(t, col, &vmin, &vmax)) {
         printf("[scale_to_range] Error: No valid numeric data in column %d\n", col);
         return 0;
     }
 
-    if (fabs(vmax - vmin) < 1e-12) {
+    int midpoint = fabs(vmax - vmin) < 1e-12;
+    if (midpoint) {
         printf("[scale_to_range] Warning: All values in column %d are identical (%.6g). Setting to midpoint.\n", col, vmin);
-        double mid = (a + b) / 2.0;
-        char buf[64];
-        snprintf(buf, sizeof(buf), "%.6f", mid);
-        for (int r = 0; r < t->rows; ++r) {
-            if (parse_num(t->data[r][col], &v)) {
-                char *new_str = strdup(buf);
-                if (!new_str) {
-                    printf("[scale_to_range] Error: Memory allocation failed for row %d\n", r);
-                    return 0;
-                }
-                free(t->data[r][col]);
-                t->data[r][col] = new_str;
-            }
-        }
-        if (!preserve_header && t->headers && t->headers[col]) {
-            char buf2[128];
-            snprintf(buf2, sizeof(buf2), "%s_scaled_[%.0f_%.0f]", t->headers[col], a, b);
-            char *new_header = strdup(buf2);
-            if (!new_header) {
-                printf("[scale_to_range] Error: Memory allocation failed for header\n");
-                return 0;
-            }
-            free(t->headers[col]);
-            t->headers[col] = new_header;
-        }
-        printf("[scale_to_range] Success: Column %d scaled to midpoint %.6f\n", col, mid);
-        return 1;
-    }
-
-    double scale = (b - a) / (vmax - vmin);
-    char buf[64];
-    for (int r = 0; r < t->rows; ++r) {
-        if (parse_num(t->data[r][col], &v)) {
-            double s = a + (v - vmin) * scale;
-            snprintf(buf, sizeof(buf), "%.6f", s);
-            char *new_str = strdup(buf);
-            if (!new_str) {
-                printf("[scale_to_range] Error: Memory allocation failed for row %d\n", r);
-                return 0;
-            }
-            free(t->data[r][col]);
-            t->data[r][col] = new_str;
-        }
-        if (t->rows > 100 && (r + 1) % (t->rows / 10 + 1) == 0) {
-            printf("[scale_to_range] Progress: Processed %d/%d rows\n", r + 1, t->rows);
-        }
+        if (!rescale_column(column, vmin, 0.0, (a + b) / 2.0, "scale_to_range")) return 0;
+    } else {
+        if (!rescale_column(column, vmin, (b - a) / (vmax - vmin), a, "scale_to_range")) return 0;
     }
+    table_stats_changed(t, col);
 
     if (!preserve_header && t->headers && t->headers[col]) {
         char buf2[128];
         snprintf(buf2, sizeof(buf2), "%s_scaled_[%.0f_%.0f]", t->headers[col], a, b);
-        char *new_header = strdup(buf2);
-        if (!new_header) {
+        if (!table_set_header(t, col, buf2)) {
             printf("[scale_to_range] Error: Memory allocation failed for header\n");
             return 0;
         }
-        free(t->headers[col]);
-        t->headers[col] = new_header;
     }
 
-    printf("[scale_to_range] Success: Column %d scaled to range [%.2f, %.2f]\n", col, a, b);
+    if (midpoint)
+        printf("[scale_to_range] Success: Column %d scaled to midpoint %.6f\n", col, (a + b) / 2.0);
+    else
+        printf("[scale_to_range] Success: Column %d scaled to range [%.2f, %.2f]\n", col, a, b);
     return 1;
 }
 
@@ -281,60 +408,69 @@ int impute_missing(Table *t, int col, int preserve_header) {
         return 0;
     }
 
-    double *vals = malloc(t->rows * sizeof(double));
-    if (!vals) {
-        printf("[impute_missing] Error: Memory allocation failed for column %d\n", col);
-        return 0;
-    }
-
+    Column *column = &t->columns[col];
     int n = 0;
     double v, sum = 0;
     for (int r = 0; r < t->rows; ++r) {
-        if (parse_num(t->data[r][col], &v)) {
-            vals[n++] = v;
+        if (column_get_number(column, r, &v)) {
+            n++;
             sum += v;
         }
     }
 
     if (n == 0) {
         printf("[impute_missing] Error: No valid numeric data in column %d\n", col);
-        free(vals);
         return 0;
     }
 
     double mean = sum / n;
-    char buf[64];
-    snprintf(buf, sizeof(buf), "%.6f", mean);
     int imputed_count = 0;
-    for (int r = 0; r < t->rows; ++r) {
-        if (!parse_num(t->data[r][col], &v)) {
-            char *new_str = strdup(buf);
-            if (!new_str) {
+    if (column_is_numeric(column)) {
+        // Typed columns only miss values where the validity bit is clear
+        if (!column_convert(column, TYPE_FLOAT)) {
+            printf("[impute_missing] Error: Memory allocation failed for column %d\n", col);
+            return 0;
+        }
+        for (int r = 0; r < t->rows; ++r) {
+            if (!column_is_valid(column, r)) {
+                column_set_float(column, r, mean);
+                imputed_count++;
+            }
+        }
+    } else {
+        char buf[NUMBER_TEXT_LEN];
+        format_double(mean, buf);
+        Column out;
+        column_init_in(&out, column->type, column->arena);
+        for (int r = 0; r < t->rows; ++r) {
+            int ok;
+            if (column_get_number(column, r, &v)) {
+                const char *s = column_get_string(column, r);
+                ok = column_push_string(&out, s, strlen(s));
+            } else {
+                ok = column_push_string(&out, buf, strlen(buf));
+                imputed_count++;
+            }
+            if (!ok) {
                 printf("[impute_missing] Error: Memory allocation failed for row %d\n", r);
-                free(vals);
+                column_free(&out);
                 return 0;
             }
-            free(t->data[r][col]);
-            t->data[r][col] = new_str;
-            imputed_count++;
-        }
-        if (t->rows > 100 && (r + 1) % (t->rows / 10 + 1) == 0) {
-            printf("[impute_missing] Progress: Processed %d/%d rows\n", r + 1, t->rows);
+            if (t->rows > 100 && (r + 1) % (t->rows / 10 + 1) == 0) {
+                printf("[impute_missing] Progress: Processed %d/%d rows\n", r + 1, t->rows);
+            }
         }
+        replace_column(column, &out);
     }
-
-    free(vals);
+    table_stats_changed(t, col);
 
     if (!preserve_header && t->headers && t->headers[col]) {
         char buf2[128];
         snprintf(buf2, sizeof(buf2), "%s_imputed_mean", t->headers[col]);
-        char *new_header = strdup(buf2);
-        if (!new_header) {
+        if (!table_set_header(t, col, buf2)) {
             printf("[impute_missing] Error: Memory allocation failed for header\n");
             return 0;
         }
-        free(t->headers[col]);
-        t->headers[col] = new_header;
     }
 
     printf("[impute_missing] Success: Imputed %d missing/non-numeric values in column %d with mean %.6f\n",
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "datagen.h"
+
+#define GEN_BUFFER_BYTES (1 << 16)
+#define GEN_MAX_CELL 64     // longest cell text written
+#define GEN_MAX_COLS (1 << 20)
+
+static const char *const words[] = {"north", "south", "east", "west", "alpha", "beta", "gamma", "delta"};
+
+void datagen_default(DataSpec *spec) {
+    spec->rows = 100000;
+    spec->cols = 8;
+    spec->mix[0] = 3; // int
+    spec->mix[1] = 3; // float
+    spec->mix[2] = 1; // string
+    spec->mix[3] = 1; // bool
+    spec->null_rate = 0.02;
+    spec->quote_rate = 0.05;
+    spec->cardinality = 1000;
+    spec->seed = 1;
+}
+
+/* =========================================================
+ * Settings
+ * ======================================================= */
+static bool parse_rate(const char *text, double *out) {
+    char *end;
+    *out = strtod(text, &end);
+    return end != text && *end == '\0' && *out >= 0 && *out <= 1;
+}
+
+// Counts may be written as 1e6
+static bool parse_count(const char *text, double max, double *out) {
+    char *end;
+    *out = strtod(text, &end);
+    return end != text && *end == '\0' && *out >= 0 && *out <= max && *out == (int64_t)*out;
+}
+
+static bool parse_setting(DataSpec *spec, const char *key, const char *value) {
+    double n;
+    if (strcmp(key, "rows") == 0 && parse_count(value, 2147483647.0, &n)) {
+        spec->rows = (int64_t)n;
+    } else if (strcmp(key, "cols") == 0 && parse_count(value, GEN_MAX_COLS, &n) && n >= 1) {
+        spec->cols = (int)n;
+    } else if (strcmp(key, "nulls") == 0) {
+        return parse_rate(value, &spec->null_rate);
+    } else if (strcmp(key, "quoted") == 0) {
+        return parse_rate(value, &spec->quote_rate);
+    } else if (strcmp(key, "card") == 0 && parse_count(value, 9e15, &n)) {
+        spec->cardinality = (int64_t)n;
+    } else if (strcmp(key, "seed") == 0 && parse_count(value, 9e15, &n)) {
+        spec->seed = (uint64_t)n;
+    } else if (strcmp(key, "mix") == 0) {
+        int m[4], used;
+        if (sscanf(value, "%d:%d:%d:%d%n", &m[0], &m[1], &m[2], &m[3], &used) != 4 || value[used] != '\0') return false;
+        if (m[0] < 0 || m[1] < 0 || m[2] < 0 || m[3] < 0 || m[0] + m[1] + m[2] + m[3] <= 0) return false;
+        memcpy(spec->mix, m, sizeof(m));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool datagen_parse(DataSpec *spec, const char *text) {
+    char token[128];
+    const char *s = text;
+    for (;;) {
+        while (*s == ' ' || *s == ',') s++;
+        if (*s == '\0') return true;
+        size_t len = strcspn(s, " ,");
+        if (len >= sizeof(token)) len = sizeof(token) - 1;
+        memcpy(token, s, len);
+        token[len] = '\0';
+        s += strcspn(s, " ,");
+
+        char *eq = strchr(token, '=');
+        if (eq) *eq = '\0';
+        if (!eq || !parse_setting(spec, token, eq + 1)) {
+            if (eq) *eq = '=';
+            printf("Data spec: bad setting '%s' (rows, cols, mix=I:F:S:B, nulls, quoted, card, seed).\n", token);
+            return false;
+        }
+    }
+}
+
+/* =========================================================
+ * Generation
+ * ======================================================= */
+static uint64_t splitmix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// Uniform in [0, 1)
+static double to_unit(uint64_t x) {
+    return (double)(x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Each column takes the type furthest behind its share of the mix so far
+static void column_types(const DataSpec *spec, FieldType *types) {
+    static const FieldType kinds[4] = {TYPE_INT, TYPE_FLOAT, TYPE_STRING, TYPE_BOOL};
+    int64_t total = spec->mix[0] + spec->mix[1] + spec->mix[2] + spec->mix[3];
+    int64_t given[4] = {0};
+    for (int j = 0; j < spec->cols; j++) {
+        int best = -1;
+        int64_t best_lag = 0;
+        for (int t = 0; t < 4; t++) {
+            if (spec->mix[t] == 0) continue;
+            int64_t lag = spec->mix[t] * (j + 1) - given[t] * total;
+            if (best < 0 || lag > best_lag) {
+                best = t;
+                best_lag = lag;
+            }
+        }
+        given[best]++;
+        types[j] = kinds[best];
+    }
+}
+
+static char type_letter(FieldType type) {
+    switch (type) {
+        case TYPE_INT: return 'i';
+        case TYPE_FLOAT: return 'f';
+        case TYPE_BOOL: return 'b';
+        default: return 's';
+    }
+}
+
+// Value drawn for an int or string cell
+static uint64_t draw_id(const DataSpec *spec, uint64_t *rng) {
+    uint64_t r = next_random(rng);
+    return spec->cardinality > 0 ? r % (uint64_t)spec->cardinality : r;
+}
+
+// Text of one cell; returns its length. Whether a string needs quoting
+// depends on its value only, so the cardinality holds.
+static int write_cell(const DataSpec *spec, FieldType type, uint64_t *rng, char *out) {
+    if (to_unit(next_random(rng)) < spec->null_rate) return 0;
+    uint64_t id;
+    switch (type) {
+        case TYPE_INT:
+            id = draw_id(spec, rng);
+            if (spec->cardinality > 0) return sprintf(out, "%llu", (unsigned long long)id);
+            return sprintf(out, "%lld", (long long)(id % 2000000001ULL) - 1000000000LL);
+        case TYPE_FLOAT:
+            return sprintf(out, "%.3f", (double)(next_random(rng) % 100000000ULL) / 1000.0 - 50000.0);
+        case TYPE_BOOL:
+            return sprintf(out, "%s", next_random(rng) & 1 ? "true" : "false");
+        default:
+            id = draw_id(spec, rng);
+            const char *word = words[id % (sizeof(words) / sizeof(words[0]))];
+            if (to_unit(splitmix(id)) >= spec->quote_rate) return sprintf(out, "%s_%llu", word, (unsigned long long)id);
+            if (id & 1) return sprintf(out, "\"%s, %llu\"", word, (unsigned long long)id);
+            return sprintf(out, "\"%s \"\"%llu\"\"\"", word, (unsigned long long)id);
+    }
+}
+
+bool datagen_write(const DataSpec *spec, const char *path) {
+    FieldType *types = malloc((size_t)spec->cols * sizeof(FieldType));
+    char *buf = malloc(GEN_BUFFER_BYTES);
+    FILE *fp = fopen(path, "wb");
+    if (!types || !buf || !fp) {
+        printf(fp ? "Error: Memory allocation failed.\n" : "Error: cannot write '%s'.\n", path);
+        free(types);
+        free(buf);
+        if (fp) fclose(fp);
+        return false;
+    }
+    column_types(spec, types);
+
+    bool ok = true;
+    size_t pos = 0;
+    uint64_t rng = splitmix(spec->seed);
+    if (rng == 0) rng = 1; // xorshift never leaves 0
+    for (int64_t i = -1; i < spec->rows && ok; i++) {
+        for (int j = 0; j < spec->cols; j++) {
+            if (j > 0) buf[pos++] = ',';
+            if (i < 0) pos += sprintf(buf + pos, "%c%d", type_letter(types[j]), j);
+            else pos += write_cell(spec, types[j], &rng, buf + pos);
+            if (pos > GEN_BUFFER_BYTES - GEN_MAX_CELL - 2) {
+                ok = fwrite(buf, 1, pos, fp) == pos;
+                pos = 0;
+            }
+        }
+        buf[pos++] = '\n';
+    }
+    if (ok && pos > 0) ok = fwrite(buf, 1, pos, fp) == pos;
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) printf("Error: writing '%s' failed.\n", path);
+    free(types);
+    free(buf);
+    return ok;
+}
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "describe.h"
+#include "sketch.h"
+#include "stats.h"
+#include "threadpool.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
+#define BLOCK_ROWS 64 // one validity word
+
+static inline int lowest_bit(uint64_t x) {
+#ifdef __GNUC__
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+void moments_init(Moments *m) {
+    m->count = 0;
+    m->mean = 0;
+    m->m2 = 0;
+    m->min = INFINITY;
+    m->max = -INFINITY;
+}
+
+void moments_add(Moments *m, double v) {
+    m->count++;
+    double delta = v - m->mean;
+    m->mean += delta / m->count;
+    m->m2 += delta * (v - m->mean);
+    if (v < m->min) m->min = v;
+    if (v > m->max) m->max = v;
+}
+
+void moments_merge(Moments *dst, const Moments *src) {
+    if (src->count == 0) return;
+    if (dst->count == 0) {
+        *dst = *src;
+        return;
+    }
+    int64_t n = dst->count + src->count;
+    double delta = src->mean - dst->mean;
+    dst->mean += delta * src->count / n;
+    dst->m2 += src->m2 + delta * delta * ((double)dst->count * src->count / n);
+    dst->count = n;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+// Fold in a short block (at most a few hundred values) at once: sum and
+// range in one sweep, squared deviations from the block mean in a second
+// sweep while the block is still in cache, then one exact merge.
+void moments_add_block(Moments *m, const double *v, int n) {
+    if (n <= 0) return;
+    Moments b;
+    double sum = 0, min = v[0], max = v[0];
+    int i = 0;
+#ifdef HAVE_SSE2
+    __m128d vsum = _mm_setzero_pd(), vmin = _mm_set1_pd(v[0]), vmax = vmin;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(v + i);
+        vsum = _mm_add_pd(vsum, x);
+        vmin = _mm_min_pd(vmin, x);
+        vmax = _mm_max_pd(vmax, x);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, vsum);
+    sum = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, vmin);
+    min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, vmax);
+    max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+#endif
+    for (; i < n; i++) {
+        sum += v[i];
+        if (v[i] < min) min = v[i];
+        if (v[i] > max) max = v[i];
+    }
+
+    b.count = n;
+    b.mean = sum / n;
+    b.min = min;
+    b.max = max;
+    double m2 = 0;
+    for (i = 0; i < n; i++) {
+        double d = v[i] - b.mean;
+        m2 += d * d;
+    }
+    b.m2 = m2;
+    moments_merge(m, &b);
+}
+
+double moments_sd(const Moments *m) {
+    return m->count > 0 ? sqrt(m->m2 / m->count) : NAN;
+}
+
+// One pass over rows [from, to) of a numeric column: every 64-row
+// validity word selects the present values of its block, which go to the
+// moments and, when a sketch is given, to the sketch. from is a multiple
+// of 64.
+static bool describe_rows(const Column *col, int from, int to, Moments *m, QuantileSketch *sketch) {
+    double block[BLOCK_ROWS];
+    bool ok = true;
+    for (int base = from; base < to && ok; base += BLOCK_ROWS) {
+        int rows = to - base < BLOCK_ROWS ? to - base : BLOCK_ROWS;
+        uint64_t bits = col->validity[base / BLOCK_ROWS];
+        if (rows < BLOCK_ROWS) bits &= ((uint64_t)1 << rows) - 1;
+        if (!bits) continue;
+
+        const double *values;
+        int n = 0;
+        if (col->type == TYPE_FLOAT && bits == ~(uint64_t)0) {
+            values = col->floats + base; // dense block, read in place
+            n = BLOCK_ROWS;
+        } else {
+            for (; bits; bits &= bits - 1) {
+                int r = base + lowest_bit(bits);
+                block[n++] = col->type == TYPE_INT ? (double)col->ints[r] : col->floats[r];
+            }
+            values = block;
+        }
+        moments_add_block(m, values, n);
+        for (int i = 0; sketch && i < n && ok; i++) ok = sketch_add(sketch, values[i]);
+    }
+    return ok;
+}
+
+typedef struct
+{
+    const Column *col;
+    Moments *moments;
+    QuantileSketch *sketches; // NULL without quartiles
+    bool ok;
+} ChunkJob;
+
+static void describe_chunk(int c, void *ctx) {
+    ChunkJob *job = ctx;
+    int from = c * SKETCH_CHUNK_ROWS;
+    int to = from + SKETCH_CHUNK_ROWS < job->col->length ? from + SKETCH_CHUNK_ROWS : job->col->length;
+    if (!describe_rows(job->col, from, to, &job->moments[c], job->sketches ? &job->sketches[c] : NULL)) job->ok = false;
+}
+
+// A tall column is cut into fixed pieces that are summarized in parallel,
+// then merged in row order, so the result is the same on any thread count
+static bool describe_chunks(const Column *col, Moments *m, QuantileSketch *sketch) {
+    int chunks = (col->length + SKETCH_CHUNK_ROWS - 1) / SKETCH_CHUNK_ROWS;
+    ChunkJob job = {col, malloc(chunks * sizeof(Moments)), NULL, true};
+    if (sketch) job.sketches = calloc(chunks, sizeof(QuantileSketch));
+    if (!job.moments || (sketch && !job.sketches)) job.ok = false;
+    for (int c = 0; c < chunks && job.ok; c++) {
+        moments_init(&job.moments[c]);
+        if (sketch) job.ok = sketch_init(&job.sketches[c], sketch->k);
+    }
+    if (job.ok) parallel_for(chunks, describe_chunk, &job);
+    for (int c = 0; c < chunks && job.moments; c++) {
+        if (job.ok) moments_merge(m, &job.moments[c]);
+        if (job.ok && sketch) job.ok = sketch_merge(sketch, &job.sketches[c]);
+        if (job.sketches) sketch_free(&job.sketches[c]);
+    }
+    free(job.moments);
+    free(job.sketches);
+    return job.ok;
+}
+
+bool describe_column(const Column *col, ColumnSummary *out, int flags) {
+    out->numeric = column_is_numeric(col);
+    out->nulls = column_null_count(col);
+    out->count = col->length - out->nulls;
+    out->mean = out->sd = out->min = out->max = NAN;
+    out->quartiles[0] = out->quartiles[1] = out->quartiles[2] = NAN;
+    if (!out->numeric) return true;
+
+    QuantileSketch sketch;
+    bool quartiles = flags & DESCRIBE_QUARTILES;
+    if (quartiles && !sketch_init(&sketch, sketch_k_for_error(get_quantile_error()))) {
+        sketch_free(&sketch);
+        return false;
+    }
+
+    Moments m;
+    moments_init(&m);
+    bool ok;
+    if (col->length > SKETCH_CHUNK_ROWS) ok = describe_chunks(col, &m, quartiles ? &sketch : NULL);
+    else ok = describe_rows(col, 0, col->length, &m, quartiles ? &sketch : NULL);
+
+    if (m.count > 0) {
+        out->mean = m.mean;
+        out->sd = moments_sd(&m);
+        out->min = m.min;
+        out->max = m.max;
+    }
+    if (quartiles) {
+        const double levels[3] = {0.25, 0.50, 0.75};
+        if (ok) sketch_quantiles(&sketch, levels, out->quartiles, 3);
+        sketch_free(&sketch);
+    }
+    return ok;
+}
+
+typedef struct
+{
+    const Table *table;
+    ColumnSummary *out;
+    int flags;
+    bool ok;
+} DescribeJob;
+
+static void describe_task(int j, void *ctx) {
+    DescribeJob *job = ctx;
+    if (!describe_column(&job->table->columns[j], &job->out[j], job->flags)) job->ok = false;
+}
+
+ColumnSummary *describe_table(const Table *table, int flags) {
+    ColumnSummary *out = calloc(table->cols > 0 ? table->cols : 1, sizeof(ColumnSummary));
+    if (!out) return NULL;
+    DescribeJob job = {table, out, flags, true};
+    parallel_for(table->cols, describe_task, &job);
+    if (!job.ok) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+typedef struct
+{
+    const Table *table;
+    int *counts;
+} NullJob;
+
+static void null_task(int j, void *ctx) {
+    NullJob *job = ctx;
+    job->counts[j] = column_null_count(&job->table->columns[j]);
+}
+
+int *count_nulls(const Table *table) {
+    int *counts = calloc(table->cols > 0 ? table->cols : 1, sizeof(int));
+    if (!counts) return NULL;
+    NullJob job = {table, counts};
+    parallel_for(table->cols, null_task, &job);
+    return counts;
+}
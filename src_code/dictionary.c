@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dictionary.h"
+
+static int dictionary_limit = DEFAULT_DICTIONARY_LIMIT;
+
+void set_dictionary_limit(int values) {
+    if (values < 0) values = 0;
+    dictionary_limit = values > DICTIONARY_MAX_VALUES ? DICTIONARY_MAX_VALUES : values;
+}
+
+int get_dictionary_limit(void) {
+    return dictionary_limit;
+}
+
+static uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hash_text(const char *s, size_t *len) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    const char *p = s;
+    for (; *p; p++) h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    *len = (size_t)(p - s);
+    return mix(h);
+}
+
+static uint64_t hash_bytes(const char *s, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+    return mix(h);
+}
+
+typedef struct
+{
+    uint64_t hash;
+    int code; // -1 for an empty slot
+} DictSlot;
+
+bool dictionary_build(const Column *col, int limit, Dictionary *dict) {
+    memset(dict, 0, sizeof(*dict));
+    if (col->codes) {
+        dict->count = col->dict_count;
+        dict->bytes = col->bytes;
+        dict->offsets = col->offsets;
+        dict->codes = col->codes;
+        return true;
+    }
+    if (col->type != TYPE_STRING || col->length == 0) return false;
+    if (limit > DICTIONARY_MAX_VALUES) limit = DICTIONARY_MAX_VALUES;
+    if (limit > col->length / 2) limit = col->length / 2;
+    if (limit <= 0) return false;
+
+    size_t cap = 16;
+    while (cap < (size_t)limit * 2) cap <<= 1;
+    DictSlot *slots = malloc(cap * sizeof(DictSlot));
+    size_t *lengths = malloc((size_t)limit * sizeof(size_t));
+    int64_t *offsets = malloc((size_t)limit * sizeof(int64_t));
+    uint16_t *codes = malloc((size_t)col->length * sizeof(uint16_t));
+    dict->bytes = col->bytes;
+    dict->offsets = dict->owned_offsets = offsets;
+    dict->codes = dict->owned_codes = codes;
+    bool ok = slots && lengths && offsets && codes;
+    for (size_t s = 0; ok && s < cap; s++) slots[s].code = -1;
+
+    for (int i = 0; ok && i < col->length; i++) {
+        if (!column_is_valid(col, i)) {
+            codes[i] = 0;
+            continue;
+        }
+        const char *text = column_string_at(col, i);
+        size_t len;
+        uint64_t h = hash_text(text, &len);
+        size_t s = h & (cap - 1);
+        for (; slots[s].code >= 0; s = (s + 1) & (cap - 1)) {
+            int k = slots[s].code;
+            if (slots[s].hash == h && lengths[k] == len && memcmp(col->bytes + offsets[k], text, len) == 0) break;
+        }
+        if (slots[s].code < 0) {
+            if (dict->count == limit) {
+                ok = false;
+                break;
+            }
+            slots[s].hash = h;
+            slots[s].code = dict->count;
+            offsets[dict->count] = text - col->bytes;
+            lengths[dict->count++] = len;
+        }
+        codes[i] = (uint16_t)slots[s].code;
+    }
+    free(slots);
+    free(lengths);
+    if (!ok || dict->count == 0) {
+        dictionary_free(dict);
+        return false;
+    }
+    return true;
+}
+
+void dictionary_free(Dictionary *dict) {
+    free(dict->owned_offsets);
+    free(dict->owned_codes);
+    memset(dict, 0, sizeof(*dict));
+}
+
+/* =========================================================
+ * Encoding while loading
+ * ======================================================= */
+struct DictionarySlot
+{
+    uint64_t hash;
+    int code; // -1 for an empty slot
+    uint32_t length;
+};
+
+bool dictionary_encoder_init(DictionaryEncoder *enc, Column *col, int limit) {
+    memset(enc, 0, sizeof(*enc));
+    if (limit > DICTIONARY_MAX_VALUES) limit = DICTIONARY_MAX_VALUES;
+    if (limit <= 0 || !column_begin_dictionary(col)) return false;
+    enc->col = col;
+    enc->limit = limit;
+    enc->cap = 16;
+    while (enc->cap < (size_t)limit * 2) enc->cap <<= 1;
+    enc->slots = malloc(enc->cap * sizeof(struct DictionarySlot));
+    if (!enc->slots) return false;
+    for (size_t s = 0; s < enc->cap; s++) enc->slots[s].code = -1;
+    return true;
+}
+
+bool dictionary_encoder_push(DictionaryEncoder *enc, const char *text, size_t len) {
+    Column *col = enc->col;
+    if (!text) return column_push_null(col);
+    uint64_t h = hash_bytes(text, len);
+    size_t s = h & (enc->cap - 1);
+    for (; enc->slots[s].code >= 0; s = (s + 1) & (enc->cap - 1)) {
+        struct DictionarySlot *slot = &enc->slots[s];
+        if (slot->hash == h && slot->length == len &&
+            memcmp(col->bytes + col->offsets[slot->code], text, len) == 0) {
+            return column_push_code(col, slot->code);
+        }
+    }
+    if (col->dict_count >= enc->limit) return false;
+    int code = column_append_code(col, text, len);
+    if (code < 0) return false;
+    enc->slots[s] = (struct DictionarySlot){h, code, (uint32_t)len};
+    return column_push_code(col, code);
+}
+
+void dictionary_encoder_free(DictionaryEncoder *enc) {
+    free(enc->slots);
+    memset(enc, 0, sizeof(*enc));
+}
+
+/* =========================================================
+ * Value counts
+ * ======================================================= */
+static int by_count(const void *a, const void *b) {
+    const ValueCount *x = a, *y = b;
+    if (x->count != y->count) return x->count > y->count ? -1 : 1;
+    return (x->row > y->row) - (x->row < y->row);
+}
+
+// Encoded columns: one counter per code
+static int count_codes(const Column *col, ValueCount *values) {
+    for (int k = 0; k < col->dict_count; k++) values[k] = (ValueCount){-1, 0};
+    for (int i = 0; i < col->length; i++) {
+        if (!column_is_valid(col, i)) continue;
+        ValueCount *v = &values[col->codes[i]];
+        if (v->count++ == 0) v->row = i;
+    }
+    // Values no row uses any more (after a filter) are left out
+    int n = 0;
+    for (int k = 0; k < col->dict_count; k++) {
+        if (values[k].count > 0) values[n++] = values[k];
+    }
+    return n;
+}
+
+typedef struct
+{
+    uint64_t hash;
+    int value; // index into the values array, -1 for an empty slot
+} CountSlot;
+
+// Other columns: values are told apart by their text
+static int count_text(const Column *col, ValueCount *values) {
+    size_t cap = 16;
+    while (cap < (size_t)col->length * 2) cap <<= 1;
+    CountSlot *slots = malloc(cap * sizeof(CountSlot));
+    if (!slots) return -1;
+    for (size_t s = 0; s < cap; s++) slots[s].value = -1;
+
+    int n = 0;
+    char buf[64], other[64];
+    for (int i = 0; i < col->length; i++) {
+        if (!column_is_valid(col, i)) continue;
+        const char *text = column_text(col, i, buf, sizeof(buf));
+        size_t len;
+        uint64_t h = hash_text(text, &len);
+        size_t s = h & (cap - 1);
+        for (; slots[s].value >= 0; s = (s + 1) & (cap - 1)) {
+            if (slots[s].hash == h &&
+                strcmp(column_text(col, values[slots[s].value].row, other, sizeof(other)), text) == 0) {
+                break;
+            }
+        }
+        if (slots[s].value < 0) {
+            slots[s].hash = h;
+            slots[s].value = n;
+            values[n++] = (ValueCount){i, 0};
+        }
+        values[slots[s].value].count++;
+    }
+    free(slots);
+    return n;
+}
+
+int column_value_counts(const Column *col, ValueCount **out) {
+    *out = NULL;
+    size_t slots = col->codes ? (size_t)col->dict_count : (size_t)col->length;
+    ValueCount *values = malloc((slots > 0 ? slots : 1) * sizeof(ValueCount));
+    if (!values) return -1;
+    int n = col->codes ? count_codes(col, values) : count_text(col, values);
+    if (n < 0) {
+        free(values);
+        return -1;
+    }
+    qsort(values, (size_t)n, sizeof(ValueCount), by_count);
+    *out = values;
+    return n;
+}
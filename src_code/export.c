@@ -1,9 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include<math.h>
 #include "fileio.h"
 #include "export.h"
+#include "describe.h"
+#include "arrowipc.h"
+#include "parquet.h"
+#include "trace.h"
+#include "statcache.h"
+
+static bool export_compression = false;
+
+void set_export_compression(bool lz4) {
+    export_compression = lz4;
+}
+
+bool get_export_compression(void) {
+    return export_compression;
+}
 
 const char *field_type_to_str(FieldType type) {
     switch (type) {
@@ -16,15 +32,65 @@ const char *field_type_to_str(FieldType type) {
     }
 }
 
-void export_cleaned_data(const Table *table, const char *filename) {
-    if (!save_csv(table, filename)) {
+// Checked before exporting text as a UTF-8 string type
+bool is_utf8(const char *text, size_t len) {
+    const unsigned char *s = (const unsigned char *)text;
+    for (size_t i = 0; i < len;) {
+        unsigned c = s[i];
+        int extra = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : -1;
+        if (extra < 0 || len - i <= (size_t)extra) return false;
+        // No overlong forms, surrogates or code points past U+10FFFF
+        unsigned next = extra ? s[i + 1] : 0;
+        if ((extra == 1 && c < 0xC2) || (c == 0xE0 && next < 0xA0) || (c == 0xED && next >= 0xA0) ||
+            (c == 0xF0 && next < 0x90) || (c == 0xF4 && next >= 0x90) || c > 0xF4) {
+            return false;
+        }
+        for (int k = 1; k <= extra; k++) {
+            if ((s[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += 1 + extra;
+    }
+    return true;
+}
+
+static bool has_extension(const char *filename, const char *ext) {
+    size_t len = strlen(filename), ext_len = strlen(ext);
+    return len >= ext_len && strcasecmp(filename + len - ext_len, ext) == 0;
+}
+
+// The format follows the extension: .arrow/.feather, .parquet, else CSV
+bool export_cleaned_data(const Table *table, const char *filename) {
+    int scope = trace_begin("export");
+    bool ok;
+    if (has_extension(filename, ".arrow") || has_extension(filename, ".feather")) {
+        ok = write_table_file(table, filename, "wb", arrow_write_table, true);
+    } else if (has_extension(filename, ".parquet")) {
+        ok = write_table_file(table, filename, "wb", parquet_write_table, true);
+    } else {
+        ok = save_csv(table, filename);
+    }
+    trace_end(scope);
+    if (!ok) {
         fprintf(stderr, "Failed to export cleaned data to %s\n", filename);
     } else {
         printf("Cleaned data saved to: %s\n", filename);
     }
+    return ok;
 }
 
 void export_stats_csv(const Table *table, const char *filename) {
+    int scope = trace_begin("export_stats_csv");
+    const ColumnSummary *summary = table_summaries(table, 0);
+    if (summary) {
+        export_summary_csv(table, summary, filename);
+    } else {
+        fprintf(stderr, "Failed to export stats to %s\n", filename);
+    }
+    trace_end(scope);
+}
+
+// Write stats that were already computed, one summary per column
+void export_summary_csv(const Table *table, const ColumnSummary *summary, const char *filename) {
     FILE *fp = fopen(filename, "w");
     if (!fp) {
         fprintf(stderr, "Failed to export stats to %s\n", filename);
@@ -34,42 +100,19 @@ void export_stats_csv(const Table *table, const char *filename) {
     fprintf(fp, "Column,Non-NULL Count,Type,Min,Max,Mean,StdDev\n");
 
     for (int j = 0; j < table->cols; j++) {
-        int count = 0;
-        double sum = 0.0, sum_sq = 0.0;
-        double min = INFINITY, max = -INFINITY;
-
-        if (table->types[j] == TYPE_INT || table->types[j] == TYPE_FLOAT) {
-            for (int i = 1; i < table->rows; i++) {
-                if (table->data[i][j] && strlen(table->data[i][j]) > 0 && strcmp(table->data[i][j], "N/A") != 0) {
-                    double val = atof(table->data[i][j]);
-                    count++;
-                    sum += val;
-                    sum_sq += val * val;
-                    if (val < min) min = val;
-                    if (val > max) max = val;
-                }
-            }
-
-            double mean = count ? sum / count : 0;
-            double stddev = count ? sqrt((sum_sq / count) - (mean * mean)) : 0;
-
+        const ColumnSummary *s = &summary[j];
+        if (s->numeric) {
             fprintf(fp, "%s,%d,%s,%.2f,%.2f,%.2f,%.2f\n",
                 table->headers[j],
-                count,
-                field_type_to_str(table->types[j]),
-                min, max, mean, stddev
+                s->count,
+                field_type_to_str(table->columns[j].type),
+                s->min, s->max, s->mean, s->sd
             );
-
         } else {
-            for (int i = 1; i < table->rows; i++) {
-                if (table->data[i][j] && strlen(table->data[i][j]) > 0 && strcmp(table->data[i][j], "N/A") != 0)
-                    count++;
-            }
-
             fprintf(fp, "%s,%d,%s,,,,\n",
                 table->headers[j],
-                count,
-                field_type_to_str(table->types[j])
+                s->count,
+                field_type_to_str(table->columns[j].type)
             );
         }
     }
@@ -4,26 +4,23 @@
 #include <ctype.h>
 #include <libgen.h>
 #include "fileio.h"
-#define INITIAL_ROW_CAPACITY 1000
-#define MAX_LINE_LEN 1024
+#include "mapfile.h"
+#include "csvparse.h"
+#include "threadpool.h"
+#include "infer.h"
+#include "csvwrite.h"
+#include "dictionary.h"
+#include "trace.h"
+#include "statcache.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #define DATA_DIR "Data/"
 #define ALT_DATA_DIR "../Data/"//If there is problem with the file path
 //for each cell type of data
-FieldType type(const char *str) {
-    if (str == NULL || strlen(str) == 0) return TYPE_NULL;
-
-    if (strcasecmp(str, "true") ==0 || strcasecmp(str, "false")==0){ 
-        //More effective than the strcmp
-        return TYPE_BOOL;
-    }
-    char *endptr; 
-    strtol(str, &endptr, 10); //Convert from the string to the integer
-    if (*endptr == '\0') return TYPE_INT;
-    //if using the strtol doesn't work, we have to try to convert it to float
-    strtod(str, &endptr);
-    if (*endptr == '\0') return TYPE_FLOAT;
-    //If it doesn't return the float type, then it is a string
-    return TYPE_STRING;
+FieldType infer_type(const char *str) {
+    if (str == NULL) return TYPE_NULL;
+    return classify_field(str, strlen(str));
 }
 void get_directory(const char *filepath, char *out_dir, size_t max_len) {
     const char *last_slash = strrchr(filepath, '/');
@@ -41,243 +38,622 @@ void get_directory(const char *filepath, char *out_dir, size_t max_len) {
     strncpy(out_dir, filepath, len);
     out_dir[len] = '\0';
 }
-char *parse_field(char **line, char delim) {
-    char *start = *line;
-    char *field = NULL;
-    int len = 0;
-    bool in_quotes = false;
-
-    while (**line && (**line != delim || in_quotes)) {
-        if (**line == '"') {
-            in_quotes = !in_quotes;
-            (*line)++;
-            continue;
-        }
-        len++;
-        (*line)++;
+// Map the file as given, or from the data directories if that fails
+bool map_data_file(MappedFile *mf, const char *filename, bool writable) {
+    bool (*map)(MappedFile *, const char *) = writable ? map_file_writable : map_file;
+    if (map(mf, filename)) return true;
+
+    const char *dirs[] = {DATA_DIR, ALT_DATA_DIR};
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        char *full_path = malloc(strlen(dirs[i]) + strlen(filename) + 1);
+        if (!full_path) return false;
+        sprintf(full_path, "%s%s", dirs[i], filename);
+        bool ok = map(mf, full_path);
+        free(full_path);
+        if (ok) return true;
     }
+    return false;
+}
 
-    field = malloc(len + 1);
-    if (!field) return NULL;
-
-    strncpy(field, start, len);
-    field[len] = '\0';
+// Open the file as given, or from the data directories if that fails
+FILE *open_data_file(const char *filename, const char *mode) {
+    FILE *fp = fopen(filename, mode);
+    if (fp) return fp;
+
+    const char *dirs[] = {DATA_DIR, ALT_DATA_DIR};
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]) && !fp; i++) {
+        char *full_path = malloc(strlen(dirs[i]) + strlen(filename) + 1);
+        if (!full_path) return NULL;
+        sprintf(full_path, "%s%s", dirs[i], filename);
+        fp = fopen(full_path, mode);
+        free(full_path);
+    }
+    return fp;
+}
 
-    if (**line == delim) (*line)++;
+// Cells that are empty or a lone space are missing. They only clear a bit
+// in the column's validity bitmap, so text such as "N/A" stays a value.
+bool is_missing(const char *text, size_t len) {
+    return len == 0 || (len == 1 && isspace((unsigned char)text[0]));
+}
 
-    // Remove quotes if if it i si the the cell.
-    if (field[0] == '"' && field[len - 1] == '"') {
-        field[len - 1] = '\0';
-        memmove(field, field + 1, len - 1);
+// Text of one field straight from the input. Only fields holding quote
+// escapes are decoded into scratch. Returns NULL if the row is too short.
+static const char *field_text(const CsvIndex *idx, const char *data, int64_t row, int col,
+                              char *scratch, size_t *len) {
+    if (col >= csv_row_fields(idx, row)) return NULL;
+    const FieldSpan *span = &idx->fields[idx->row_start[row] + col];
+    if (span->flags & SPAN_ESCAPED) {
+        *len = csv_span_decode(data, span, scratch);
+        return scratch;
     }
+    *len = span->length;
+    return data + span->offset;
+}
 
-    return field;
+// Data row (1-based, the header is row 0) read as the s-th of `count`
+// samples out of `rows`: one from each of `count` equal strata
+static int64_t sample_row(int64_t s, int64_t count, int64_t rows) {
+    if (count >= rows) return 1 + s;
+    int64_t lo = s * rows / count, hi = (s + 1) * rows / count;
+    return 1 + lo + (int64_t)((uint64_t)(s * 2654435761u) % (uint64_t)(hi - lo));
 }
 
-bool load_csv(Table *table, const char *filename) {
-    FILE *fp = NULL;
-    char *full_path = NULL;
+static int64_t sample_count(const CsvIndex *idx, int sample) {
+    int64_t rows = idx->row_count - 1;
+    return sample > 0 && sample < rows ? sample : rows;
+}
 
-    // Try the provided filename first
-    fp = fopen(filename, "r");
-    if (!fp) {
-        full_path = malloc(strlen(DATA_DIR) + strlen(filename) + 1);
-        if (!full_path) return false;
-        sprintf(full_path, "%s%s", DATA_DIR, filename);
-        fp = fopen(full_path, "r");
-    }
-    if (!fp) {
-        free(full_path);
-        full_path = malloc(strlen(ALT_DATA_DIR) + strlen(filename) + 1);
-        if (!full_path) return false;
-        sprintf(full_path, "%s%s", ALT_DATA_DIR, filename);
-        fp = fopen(full_path, "r");
-    }
-    free(full_path);
-    if (!fp) return false;
+// Whether the cells tallied so far, out of `count`, already make the
+// column text whatever the rest hold
+static bool settled_as_text(const TypeTally *t, int64_t count) {
+    return (t->other == TYPE_STRING || t->numbers > 0) && !few_strays(t->others, count);
+}
 
-    table->rows = 0;
-    table->cols = 0;
-    table->capacity = INITIAL_ROW_CAPACITY;
-    table->data = malloc(table->capacity * sizeof(char **));
-    table->types = calloc(MAX_COLS, sizeof(FieldType));
-    table->headers = NULL;
+// A sampled type is checked against every row while the column is stored,
+// except text, which takes any value. Text found among numbers in the
+// sample may still be few strays over all rows, so it is not trusted.
+static bool sample_trusted(const TypeTally *t) {
+    FieldType type = tally_type(t);
+    return type != TYPE_NULL && !(type == TYPE_STRING && t->numbers > 0);
+}
 
-    char line[MAX_LINE_LEN];
-    bool first_row = true;
+// Tally of column j over the data rows (see tally_type). With `sample` > 0
+// only that many rows are read, spread over the file, so a column that
+// changes type part way through is still likely to be caught.
+static TypeTally scan_type(const CsvIndex *idx, const char *data, int j, char *scratch, int sample) {
+    int64_t rows = idx->row_count - 1;
+    int64_t count = sample_count(idx, sample);
+    TypeTally t;
+    tally_init(&t);
+    for (int64_t s = 0; s < count && !settled_as_text(&t, count); s++) {
+        int64_t r = sample_row(s, count, rows);
+        size_t len;
+        const char *text = field_text(idx, data, r, j, scratch, &len);
+        if (text && !is_missing(text, len)) tally_add(&t, classify_field(text, len));
+    }
+    return t;
+}
 
-    while (fgets(line, MAX_LINE_LEN, fp)) {
-        line[strcspn(line, "\n\r")] = '\0';
+// A value a numeric column cannot hold because it is no number at all, as
+// opposed to one that needs a wider type
+static bool is_stray(FieldType type, const char *text, size_t len) {
+    if (type != TYPE_INT && type != TYPE_FLOAT) return false;
+    FieldType cell = classify_field(text, len);
+    return cell != TYPE_INT && cell != TYPE_FLOAT;
+}
 
-        if (table->rows >= table->capacity) {
-            table->capacity *= 2;
-            char ***new_data = realloc(table->data, table->capacity * sizeof(char **));
-            if (!new_data) {
-                fclose(fp);
-                free_table(table);
-                return false;
+// Fill a string column as a dictionary encoded one: text with few distinct
+// values is stored once per value, with a small code per row. Gives up at
+// the first value over the limit (see dictionary_build).
+static bool build_encoded(Column *col, Arena *arena, const CsvIndex *idx, const char *data, int j, char *scratch) {
+    int rows = (int)(idx->row_count - 1);
+    int limit = get_dictionary_limit() < rows / 2 ? get_dictionary_limit() : rows / 2;
+    if (limit <= 0) return false;
+    column_init_in(col, TYPE_STRING, arena);
+    DictionaryEncoder enc = {0};
+    bool fits = column_reserve(col, rows) && dictionary_encoder_init(&enc, col, limit);
+    size_t len;
+    for (int64_t r = 1; r < idx->row_count && fits; r++) {
+        const char *text = field_text(idx, data, r, j, scratch, &len);
+        fits = dictionary_encoder_push(&enc, !text || is_missing(text, len) ? NULL : text, len);
+    }
+    dictionary_encoder_free(&enc);
+    if (!fits) column_free(col);
+    return fits;
+}
+
+// Fill one column from the index with the given type, confirming it while
+// the values are stored: if one does not fit, the guess was too narrow
+// (`complete` says whether it came from every row), so the column is
+// rebuilt with the type of every row. Stray text in a numeric column is
+// stored as N/A and counted in *strays.
+static bool fill_column(Column *col, Arena *arena, const CsvIndex *idx, const char *data, int j, char *scratch,
+                        FieldType type, bool complete, bool dictionary, int64_t *strays) {
+    int rows = (int)(idx->row_count - 1);
+    for (;;) {
+        *strays = 0;
+        if (type == TYPE_STRING && dictionary && build_encoded(col, arena, idx, data, j, scratch)) return true;
+        dictionary = true;
+        column_init_in(col, type, arena);
+        if (!column_reserve(col, rows > 0 ? rows : 1)) return false;
+        if (type == TYPE_STRING || type == TYPE_NULL) {
+            // Raw field lengths bound the decoded text, so one buffer suffices
+            int64_t bytes = rows;
+            for (int64_t r = 1; r < idx->row_count; r++) {
+                if (j < csv_row_fields(idx, r)) bytes += idx->fields[idx->row_start[r] + j].length;
             }
-            table->data = new_data;
+            if (!column_reserve_bytes(col, bytes)) return false;
         }
 
-        int col = 0;
-        char *ptr = line;
-        int fields_in_row = 0;
-
-        // Count fields in this row to determine allocation size
-        char *temp_ptr = ptr;
-        while (*temp_ptr) {
-            if (*temp_ptr == ',') fields_in_row++;
-            temp_ptr++;
+        bool fits = true;
+        int64_t values = 0;
+        size_t len;
+        for (int64_t r = 1; r < idx->row_count && fits; r++) {
+            const char *text = field_text(idx, data, r, j, scratch, &len);
+            if (!text || is_missing(text, len)) {
+                fits = column_push_null(col);
+                continue;
+            }
+            values++;
+            fits = column_push_text(col, text, len);
+            if (!fits && is_stray(type, text, len)) {
+                (*strays)++;
+                fits = column_push_null(col);
+            }
         }
-        fields_in_row = (fields_in_row > 0) ? fields_in_row + 1 : 1; // Account for the last field
+        if (fits && few_strays(*strays, values)) return true;
+        column_free(col);
+        // String storage takes any text, so failing here means out of memory
+        if (type == TYPE_STRING || type == TYPE_NULL) return false;
+        if (complete) {
+            type = TYPE_STRING;
+        } else {
+            TypeTally t = scan_type(idx, data, j, scratch, 0);
+            type = tally_type(&t);
+            complete = true;
+        }
+    }
+}
 
-        if (first_row && fields_in_row > table->cols) table->cols = fields_in_row;
+// Fill one column from the index. The type is guessed from a sample of the
+// rows (see sample_trusted).
+static bool build_column(Column *col, Arena *arena, const CsvIndex *idx, const char *data, int j, char *scratch,
+                         int64_t *strays) {
+    int rows = (int)(idx->row_count - 1);
+    int sample = get_infer_sample();
+    bool complete = sample <= 0 || sample >= rows;
+    TypeTally t = scan_type(idx, data, j, scratch, complete ? 0 : sample);
+    if (!complete && !sample_trusted(&t)) {
+        t = scan_type(idx, data, j, scratch, 0);
+        complete = true;
+    }
+    return fill_column(col, arena, idx, data, j, scratch, tally_type(&t), complete, true, strays);
+}
 
-        table->data[table->rows] = malloc(table->cols * sizeof(char *));
-        if (!table->data[table->rows]) {
-            fclose(fp);
-            free_table(table);
-            return false;
+/* =========================================================
+ * Wide tables
+ * ======================================================= */
+typedef enum
+{
+    WIDE_TODO,       // type known, storage not started
+    WIDE_DICTIONARY, // being filled through a dictionary
+    WIDE_PLAIN,      // being filled value by value
+    WIDE_RETRY,      // a value did not fit the sampled type
+    WIDE_DONE
+} WideState;
+
+typedef struct
+{
+    FieldType type;
+    TypeTally tally;
+    int64_t values, strays; // stray text stored as N/A (see fill_column)
+    bool complete;      // the type was read from every row
+    bool scan;          // taking part in the current type scan
+    bool no_dictionary; // too many distinct values for a dictionary
+    WideState state;
+    DictionaryEncoder enc;
+} WideColumn;
+
+// Type scan of the flagged columns of a block, row by row, so the index is
+// read in order. Same rows and result per column as scan_type.
+static void scan_block_types(const CsvIndex *idx, const char *data, int j0, WideColumn *w, int n, char *scratch,
+                             int sample) {
+    int64_t rows = idx->row_count - 1;
+    int64_t count = sample_count(idx, sample);
+    for (int k = 0; k < n; k++) {
+        if (w[k].scan) tally_init(&w[k].tally);
+    }
+    for (int64_t s = 0; s < count; s++) {
+        int64_t r = sample_row(s, count, rows);
+        for (int k = 0; k < n; k++) {
+            if (!w[k].scan || settled_as_text(&w[k].tally, count)) continue;
+            size_t len;
+            const char *text = field_text(idx, data, r, j0 + k, scratch, &len);
+            if (text && !is_missing(text, len)) tally_add(&w[k].tally, classify_field(text, len));
         }
+    }
+    for (int k = 0; k < n; k++) {
+        if (w[k].scan) w[k].type = tally_type(&w[k].tally);
+    }
+}
 
-        while (*ptr && col < table->cols) {
-            char *field = parse_field(&ptr, ',');
-            if (!field) {
-                fclose(fp);
-                free_table(table);
-                return false;
+// Start storage for the columns still to do: a dictionary for strings that
+// may take one, else typed vectors with room for every row and, for text,
+// every byte
+static bool start_block(Column *cols, Arena *arena, const CsvIndex *idx, int j0, WideColumn *w, int n) {
+    int rows = (int)(idx->row_count - 1);
+    int limit = get_dictionary_limit() < rows / 2 ? get_dictionary_limit() : rows / 2;
+    int64_t bytes[WIDE_BLOCK_COLS] = {0};
+    bool text = false;
+    for (int k = 0; k < n; k++) {
+        if (w[k].state != WIDE_TODO) continue;
+        if (w[k].type == TYPE_STRING && !w[k].no_dictionary && limit > 0) {
+            column_init_in(&cols[k], TYPE_STRING, arena);
+            memset(&w[k].enc, 0, sizeof(w[k].enc));
+            if (column_reserve(&cols[k], rows) && dictionary_encoder_init(&w[k].enc, &cols[k], limit)) {
+                w[k].state = WIDE_DICTIONARY;
+                continue;
             }
+            dictionary_encoder_free(&w[k].enc);
+            column_free(&cols[k]);
+        }
+        column_init_in(&cols[k], w[k].type, arena);
+        if (!column_reserve(&cols[k], rows > 0 ? rows : 1)) return false;
+        w[k].state = WIDE_PLAIN;
+        w[k].values = w[k].strays = 0;
+        if (w[k].type == TYPE_STRING || w[k].type == TYPE_NULL) {
+            bytes[k] = rows;
+            text = true;
+        }
+    }
+    for (int64_t r = 1; text && r < idx->row_count; r++) {
+        const FieldSpan *row = &idx->fields[idx->row_start[r] + j0];
+        int64_t fields = csv_row_fields(idx, r) - j0;
+        for (int k = 0; k < n && k < fields; k++) {
+            if (bytes[k] > 0) bytes[k] += row[k].length;
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        if (bytes[k] > 0 && !column_reserve_bytes(&cols[k], bytes[k])) return false;
+    }
+    return true;
+}
 
-            if (!field || strlen(field) == 0 || (strlen(field) == 1 && isspace(field[0]))) {
-                free(field);
-                field = strdup("N/A");
-                if (!field) {
-                    fclose(fp);
-                    free_table(table);
-                    return false;
-                }
+// Store the values of the started columns, row by row. A dictionary that
+// overflows sends its column back to be stored plainly; a value that does
+// not fit the sampled type, or too much stray text, sends it to the
+// one-column path.
+static bool fill_block(Column *cols, const CsvIndex *idx, const char *data, int j0, WideColumn *w, int n,
+                       char *scratch) {
+    bool ok = true;
+    for (int64_t r = 1; r < idx->row_count && ok; r++) {
+        for (int k = 0; k < n && ok; k++) {
+            if (w[k].state != WIDE_DICTIONARY && w[k].state != WIDE_PLAIN) continue;
+            size_t len = 0;
+            const char *text = field_text(idx, data, r, j0 + k, scratch, &len);
+            if (text && is_missing(text, len)) text = NULL;
+            if (w[k].state == WIDE_DICTIONARY) {
+                if (dictionary_encoder_push(&w[k].enc, text, len)) continue;
+                dictionary_encoder_free(&w[k].enc);
+                column_free(&cols[k]);
+                w[k].no_dictionary = true;
+                w[k].state = WIDE_TODO;
+                continue;
             }
-
-            table->data[table->rows][col] = field;
-
-            if (first_row) {
-                if (!table->headers) table->headers = malloc(table->cols * sizeof(char *));
-                table->headers[col] = strdup(field);
-            } else if (table->types && table->rows == 1) {
-                FieldType inferred = type(field);
-                if (inferred > table->types[col]) table->types[col] = inferred;
+            bool fits = text ? column_push_text(&cols[k], text, len) : column_push_null(&cols[k]);
+            if (text) w[k].values++;
+            if (!fits && text && is_stray(w[k].type, text, len)) {
+                w[k].strays++;
+                fits = column_push_null(&cols[k]);
             }
+            if (!fits) {
+                // String storage takes any text, so failing there means out of memory
+                ok = w[k].type != TYPE_STRING && w[k].type != TYPE_NULL;
+                column_free(&cols[k]);
+                w[k].state = WIDE_RETRY;
+            }
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        if (w[k].state == WIDE_PLAIN && !few_strays(w[k].strays, w[k].values)) {
+            column_free(&cols[k]);
+            w[k].state = WIDE_RETRY;
+        }
+        if (w[k].state == WIDE_DICTIONARY) dictionary_encoder_free(&w[k].enc);
+        if (w[k].state == WIDE_DICTIONARY || w[k].state == WIDE_PLAIN) w[k].state = WIDE_DONE;
+    }
+    return ok;
+}
 
-            col++;
+// Fill the n columns from j0 on together, reading each row of the index
+// once per pass instead of once per column. The result is the same as
+// build_column's for every column.
+static bool build_block(Table *table, const CsvIndex *idx, const char *data, int j0, int n, char *scratch,
+                        int64_t *strays) {
+    Column *cols = table->columns + j0;
+    WideColumn w[WIDE_BLOCK_COLS];
+    memset(w, 0, sizeof(w));
+    int rows = (int)(idx->row_count - 1);
+    int sample = get_infer_sample();
+    bool complete = sample <= 0 || sample >= rows;
+    for (int k = 0; k < n; k++) {
+        w[k].scan = true;
+        w[k].complete = complete;
+    }
+    scan_block_types(idx, data, j0, w, n, scratch, complete ? 0 : sample);
+    if (!complete) {
+        bool again = false;
+        for (int k = 0; k < n; k++) {
+            w[k].scan = !sample_trusted(&w[k].tally);
+            w[k].complete = w[k].complete || w[k].scan;
+            again = again || w[k].scan;
         }
+        if (again) scan_block_types(idx, data, j0, w, n, scratch, 0);
+    }
 
-        // Pad with N/A if row has fewer fields than table->cols
-        while (col < table->cols) {
-            table->data[table->rows][col] = strdup("N/A");
-            if (!table->data[table->rows][col]) {
-                fclose(fp);
-                free_table(table);
-                return false;
-            }
-            col++;
+    // Twice at most: strings with too many distinct values for a
+    // dictionary are stored plainly in a second pass
+    bool ok = true;
+    for (int pass = 0; pass < 2 && ok; pass++) {
+        bool todo = false;
+        for (int k = 0; k < n; k++) todo = todo || w[k].state == WIDE_TODO;
+        if (!todo) break;
+        ok = start_block(cols, table->arena, idx, j0, w, n) && fill_block(cols, idx, data, j0, w, n, scratch);
+    }
+    for (int k = 0; k < n; k++) {
+        if (w[k].state == WIDE_DICTIONARY) dictionary_encoder_free(&w[k].enc);
+    }
+    for (int k = 0; k < n && ok; k++) {
+        if (w[k].state != WIDE_RETRY) continue;
+        FieldType type = TYPE_STRING;
+        if (!w[k].complete) {
+            TypeTally t = scan_type(idx, data, j0 + k, scratch, 0);
+            type = tally_type(&t);
         }
+        ok = fill_column(&cols[k], table->arena, idx, data, j0 + k, scratch, type, true, true, &w[k].strays);
+    }
+    for (int k = 0; k < n; k++) strays[k] = w[k].strays;
+    return ok;
+}
 
-        table->rows++;
-        first_row = false;
+typedef struct
+{
+    Table *table;
+    const CsvIndex *idx;
+    const char *data;
+    int64_t *strays; // per column
+    bool ok;
+} BuildJob;
+
+// Columns are independent, so each one is filled by its own task
+static void build_task(int j, void *ctx) {
+    BuildJob *job = ctx;
+    char *scratch = malloc((size_t)job->idx->max_length + 1);
+    if (!scratch || !build_column(&job->table->columns[j], job->table->arena, job->idx, job->data, j, scratch,
+                                  &job->strays[j])) {
+        job->ok = false;
     }
+    free(scratch);
+}
 
-    fclose(fp);
-    return true;
+// Wide tables: one task per block of adjacent columns
+static void build_block_task(int b, void *ctx) {
+    BuildJob *job = ctx;
+    int j0 = b * WIDE_BLOCK_COLS;
+    int n = job->table->cols - j0 < WIDE_BLOCK_COLS ? job->table->cols - j0 : WIDE_BLOCK_COLS;
+    char *scratch = malloc((size_t)job->idx->max_length + 1);
+    if (!scratch || !build_block(job->table, job->idx, job->data, j0, n, scratch, job->strays + j0)) job->ok = false;
+    free(scratch);
 }
 
-bool save_csv(const Table *table, const char *filepath) {
-    FILE *fp = fopen(filepath, "w");
-    if (!fp) {
-        char *full_path = malloc(strlen(DATA_DIR) + strlen(filepath) + 1);
-        if (!full_path) return false;
-        sprintf(full_path, "%s%s", DATA_DIR, filepath);
-        fp = fopen(full_path, "w");
-        free(full_path);
+static bool read_csv(Table *table, const char *filename) {
+    MappedFile mf;
+    if (!map_data_file(&mf, filename, false)) return false;
+    trace_add(TRACE_BYTES_READ, (int64_t)mf.size);
+
+    CsvIndex idx;
+    int scope = trace_begin("index");
+    bool indexed = csv_index_build(&idx, mf.data, mf.size, ',');
+    trace_end(scope);
+    if (!indexed) {
+        unmap_file(&mf);
+        return false;
     }
 
-    if (!fp) {
-        char *alt_path = malloc(strlen(ALT_DATA_DIR) + strlen(filepath) + 1);
-        if (!alt_path) return false;
-        sprintf(alt_path, "%s%s", ALT_DATA_DIR, filepath);
-        fp = fopen(alt_path, "w");
-        free(alt_path);
+    table->rows = 0;
+    table->cols = 0;
+    table->columns = NULL;
+    table->headers = NULL;
+    table->arena = NULL;
+    table->mapping = NULL;
+    table->stats = NULL;
+    if (idx.row_count == 0) {
+        csv_index_free(&idx);
+        unmap_file(&mf);
+        return true;
     }
-
-    if (!fp) return false;
-
-    // Write headers
-    for (int j = 0; j < table->cols; j++) {
-        fprintf(fp, "%s", table->headers[j] ? table->headers[j] : "N/A");
-        if (j < table->cols - 1) fprintf(fp, ",");
+    if (idx.row_count - 1 > INT32_MAX) {
+        printf("Error: %s has too many rows.\n", filename);
+        csv_index_free(&idx);
+        unmap_file(&mf);
+        return false;
     }
-    fprintf(fp, "\n");
 
-    // Write data
-    for (int i = 0; i < table->rows; i++) {
-        for (int j = 0; j < table->cols; j++) {
-            fprintf(fp, "%s", table->data[i][j] ? table->data[i][j] : "N/A");
-            if (j < table->cols - 1) fprintf(fp, ",");
+    // The header decides the number of columns. Fields past its end are
+    // dropped, so a few ragged rows do not widen the table.
+    int64_t header = csv_row_fields(&idx, 0), longer = 0;
+    for (int64_t r = 1; r < idx.row_count; r++) {
+        if (csv_row_fields(&idx, r) > header) longer++;
+    }
+    if (header > INT32_MAX) {
+        printf("Error: %s has too many columns.\n", filename);
+        csv_index_free(&idx);
+        unmap_file(&mf);
+        return false;
+    }
+    if (longer > 0) {
+        printf("Warning: %lld rows have more fields than the header's %lld; the extra fields are dropped.\n",
+               (long long)longer, (long long)header);
+    }
+    table->cols = (int)header;
+    table->headers = calloc(table->cols, sizeof(char *));
+    table->columns = calloc(table->cols, sizeof(Column));
+    table->arena = arena_create();
+    char *scratch = malloc((size_t)idx.max_length + 1);
+    int64_t *strays = calloc(table->cols, sizeof(int64_t));
+    bool ok = table->headers && table->columns && table->arena && scratch && strays;
+
+    for (int j = 0; ok && j < table->cols; j++) {
+        size_t len;
+        const char *text = field_text(&idx, mf.data, 0, j, scratch, &len);
+        if (!text || is_missing(text, len)) {
+            text = "N/A";
+            len = 3;
+        }
+        table->headers[j] = arena_alloc(table->arena, len + 1);
+        if (!table->headers[j]) {
+            ok = false;
+            break;
         }
-        fprintf(fp, "\n");
+        memcpy(table->headers[j], text, len);
+        table->headers[j][len] = '\0';
+    }
+    if (ok) {
+        // A wide table is filled a block of columns at a time, row by row,
+        // to read the index in order; a narrow one a column at a time
+        BuildJob job = {table, &idx, mf.data, strays, true};
+        scope = trace_begin("build columns");
+        if (table->cols >= WIDE_TABLE_COLS) {
+            parallel_for((table->cols + WIDE_BLOCK_COLS - 1) / WIDE_BLOCK_COLS, build_block_task, &job);
+        } else {
+            parallel_for(table->cols, build_task, &job);
+        }
+        trace_end(scope);
+        ok = job.ok;
+    }
+    for (int j = 0; ok && j < table->cols; j++) {
+        if (strays[j] == 0) continue;
+        printf("Warning: %lld values in numeric column '%s' are not numbers; they are read as N/A.\n",
+               (long long)strays[j], table->headers[j]);
     }
+    table->rows = (int)(idx.row_count - 1);
+    trace_add(TRACE_ROWS_PARSED, table->rows);
+    trace_add(TRACE_CELLS, (int64_t)table->rows * table->cols);
+
+    free(scratch);
+    free(strays);
+    csv_index_free(&idx);
+    unmap_file(&mf);
+    if (!ok) free_table(table);
+    return ok;
+}
 
-    fclose(fp);
-    return true;
+bool load_csv(Table *table, const char *filename) {
+    int scope = trace_begin("load_csv");
+    bool ok = read_csv(table, filename);
+    trace_end(scope);
+    return ok;
 }
 
-int get_column_index(const Table *table, const char *column_name) {
-    for (int j = 0; j < table->cols; j++) {
-        if (table->headers && strcmp(table->headers[j], column_name) == 0) return j;
+// Write the table to `path` with `writer`. In atomic mode it goes to
+// path.tmp first and is renamed over `path` only once complete, so readers
+// never see a partly written file and a failed save leaves the old one in
+// place.
+bool write_table_file(const Table *table, const char *path, const char *mode, TableWriter writer, bool atomic) {
+    char *target = malloc(strlen(path) + 5);
+    if (!target) return false;
+    sprintf(target, atomic ? "%s.tmp" : "%s", path);
+
+    FILE *fp = fopen(target, mode);
+    if (!fp) {
+        free(target);
+        return false;
     }
-    return -1;
+    bool ok = writer(table, fp) && fflush(fp) == 0;
+    if (ok && trace_enabled()) trace_add(TRACE_BYTES_WRITTEN, ftell(fp));
+#ifndef _WIN32
+    if (ok && atomic) ok = fsync(fileno(fp)) == 0;
+#endif
+    if (fclose(fp) != 0) ok = false;
+
+    if (atomic) {
+#ifdef _WIN32
+        if (ok) remove(path); // rename does not replace files on Windows
+#endif
+        if (ok) ok = rename(target, path) == 0;
+        if (!ok) remove(target);
+    }
+    free(target);
+    return ok;
 }
 
-int *get_column_as_int(const Table *table, int col_index) {
-    int *array = malloc((table->rows - 1) * sizeof(int));
-    for (int i = 1; i < table->rows; i++) {
-        array[i - 1] = table->data[i][col_index] ? atoi(table->data[i][col_index]) : 0;
+// Save as given, or into the data directories if that fails
+static bool save_to(const Table *table, const char *filepath, bool atomic) {
+    if (write_table_file(table, filepath, "w", csv_write_table, atomic)) return true;
+
+    const char *dirs[] = {DATA_DIR, ALT_DATA_DIR};
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        char *full_path = malloc(strlen(dirs[i]) + strlen(filepath) + 1);
+        if (!full_path) return false;
+        sprintf(full_path, "%s%s", dirs[i], filepath);
+        bool ok = write_table_file(table, full_path, "w", csv_write_table, atomic);
+        free(full_path);
+        if (ok) return true;
     }
-    return array;
+    return false;
 }
 
-float *get_column_as_float(const Table *table, int col_index) {
-    float *array = malloc((table->rows - 1) * sizeof(float));
-    for (int i = 1; i < table->rows; i++) {
-        array[i - 1] = table->data[i][col_index] ? atof(table->data[i][col_index]) : 0.0f;
-    }
-    return array;
+bool save_csv(const Table *table, const char *filepath) {
+    int scope = trace_begin("save_csv");
+    bool ok = save_to(table, filepath, false);
+    trace_end(scope);
+    return ok;
+}
+
+bool save_csv_atomic(const Table *table, const char *filepath) {
+    int scope = trace_begin("save_csv");
+    bool ok = save_to(table, filepath, true);
+    trace_end(scope);
+    return ok;
 }
 
-bool *get_column_as_bool(const Table *table, int col_index) {
-    bool *array = malloc((table->rows - 1) * sizeof(bool));
-    for (int i = 1; i < table->rows; i++) {
-        array[i - 1] = table->data[i][col_index] && (strcasecmp(table->data[i][col_index], "true") == 0);
+int get_column_index(const Table *table, const char *column_name) {
+    for (int j = 0; j < table->cols; j++) {
+        if (table->headers && strcmp(table->headers[j], column_name) == 0) return j;
     }
-    return array;
+    return -1;
+}
+
+// Replace a column header. The old text stays in the arena until the
+// table is freed.
+bool table_set_header(Table *table, int col, const char *name) {
+    char *copy = arena_strdup(table->arena, name);
+    if (!copy) return false;
+    table->headers[col] = copy;
+    return true;
 }
 
 void free_table(Table *table) {
-    for (int i = 0; i < table->rows; i++) {
+    if (table->columns) {
+        // Arena storage goes with the arena; only malloc'd columns need freeing
         for (int j = 0; j < table->cols; j++) {
-            free(table->data[i][j]);
+            if (table->columns[j].arena != table->arena) column_free(&table->columns[j]);
         }
-        free(table->data[i]);
+        free(table->columns);
     }
-    free(table->data);
-    free(table->types);
-    if (table->headers) {
-        for (int j = 0; j < table->cols; j++) {
-            free(table->headers[j]);
-        }
-        free(table->headers);
+    table_stats_free(table);
+    free(table->headers);
+    arena_destroy(table->arena);
+    // Snapshot columns point into the mapping, so it goes after the arena
+    if (table->mapping) {
+        unmap_file(table->mapping);
+        free(table->mapping);
     }
+    table->columns = NULL;
+    table->headers = NULL;
+    table->arena = NULL;
+    table->mapping = NULL;
     table->rows = 0;
     table->cols = 0;
-    table->capacity = 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+#include "threadpool.h"
+#include "numparse.h"
+#include "statcache.h"
+
+typedef struct
+{
+    Table *table;
+    const uint64_t *keep;
+    int kept;
+} CompactJob;
+
+static void compact_task(int j, void *ctx) {
+    CompactJob *job = ctx;
+    column_compact(&job->table->columns[j], job->keep, job->kept);
+}
+
+int filter_rows_mask(Table *table, const uint64_t *keep) {
+    int kept = bitmap_count(keep, table->rows);
+    int removed = table->rows - kept;
+    if (removed == 0) return 0;
+
+    // Columns compact independently, so they run in parallel
+    CompactJob job = {table, keep, kept};
+    parallel_for(table->cols, compact_task, &job);
+    table->rows = kept;
+    table_stats_changed(table, -1);
+    return removed;
+}
+
+static uint64_t *new_mask(int rows) {
+    return calloc((size_t)(rows + 63) / 64 + 1, sizeof(uint64_t));
+}
+
+int filter_rows(Table *table, RowPredicate keep, void *ctx) {
+    uint64_t *mask = new_mask(table->rows);
+    if (!mask) return -1;
+    for (int i = 0; i < table->rows; i++) {
+        if (keep(table, i, ctx)) mask[i >> 6] |= (uint64_t)1 << (i & 63);
+    }
+    int removed = filter_rows_mask(table, mask);
+    free(mask);
+    return removed;
+}
+
+uint64_t *filter_mask_all(int rows) {
+    uint64_t *mask = new_mask(rows);
+    if (mask) memset(mask, 0xff, (size_t)(rows + 63) / 64 * sizeof(uint64_t));
+    return mask;
+}
+
+// The keep-bitmap of a null filter is the AND of validity bitmaps
+void filter_mask_nulls(const Table *table, int col, uint64_t *mask) {
+    int words = (table->rows + 63) / 64;
+    for (int j = 0; j < table->cols; j++) {
+        if (col >= 0 && j != col) continue;
+        const uint64_t *validity = table->columns[j].validity;
+        for (int w = 0; w < words; w++) mask[w] &= validity[w];
+    }
+}
+
+int filter_drop_nulls(Table *table, int col) {
+    uint64_t *mask = filter_mask_all(table->rows);
+    if (!mask) return -1;
+    filter_mask_nulls(table, col, mask);
+    int removed = filter_rows_mask(table, mask);
+    free(mask);
+    return removed;
+}
+
+static inline void keep_if(uint64_t *mask, int row, bool match) {
+    if (!match) mask[row >> 6] &= ~((uint64_t)1 << (row & 63));
+}
+
+void filter_mask_equals(const Table *table, int col, const char *text, uint64_t *mask) {
+    const Column *c = &table->columns[col];
+    size_t len = strlen(text);
+    int64_t iv;
+    double dv;
+    char buf[64];
+    if (c->codes) {
+        int code = column_find_code(c, text);
+        for (int i = 0; i < table->rows; i++) {
+            keep_if(mask, i, code >= 0 && c->codes[i] == code && column_is_valid(c, i));
+        }
+    } else if (c->type == TYPE_INT) {
+        bool ok = parse_int64(text, len, &iv);
+        for (int i = 0; i < table->rows; i++) {
+            keep_if(mask, i, ok && c->ints[i] == iv && column_is_valid(c, i));
+        }
+    } else if (c->type == TYPE_FLOAT) {
+        bool ok = parse_double(text, len, &dv);
+        for (int i = 0; i < table->rows; i++) {
+            keep_if(mask, i, ok && c->floats[i] == dv && column_is_valid(c, i));
+        }
+    } else {
+        for (int i = 0; i < table->rows; i++) {
+            keep_if(mask, i, column_is_valid(c, i) && strcmp(column_text(c, i, buf, sizeof(buf)), text) == 0);
+        }
+    }
+}
+
+int filter_equals(Table *table, int col, const char *text) {
+    uint64_t *mask = filter_mask_all(table->rows);
+    if (!mask) return -1;
+    filter_mask_equals(table, col, text, mask);
+    int removed = filter_rows_mask(table, mask);
+    free(mask);
+    return removed;
+}
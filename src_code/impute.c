@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "impute.h"
+#include "statcache.h"
+#include "threadpool.h"
+#include "numparse.h"
+
+ImputeMethod impute_method(const char *name, const char **value) {
+    if (strcmp(name, "mean") == 0) return IMPUTE_MEAN;
+    if (strcmp(name, "median") == 0) return IMPUTE_MEDIAN;
+    if (strcmp(name, "mode") == 0) return IMPUTE_MODE;
+    if (strcmp(name, "ffill") == 0) return IMPUTE_FFILL;
+    *value = name;
+    if (strncmp(name, "value=", 6) == 0 && name[6] != '\0') {
+        *value = name + 6;
+        return IMPUTE_CONSTANT;
+    }
+    FieldType type = infer_type(name);
+    if (type == TYPE_INT || type == TYPE_FLOAT || type == TYPE_BOOL) return IMPUTE_CONSTANT;
+    return IMPUTE_INVALID;
+}
+
+/* =========================================================
+ * Selection
+ * Quickselect with the median of three randomly placed values as pivot
+ * (fixed positions fall into patterns of repeated data) and a three-way
+ * partition, so runs of equal values shrink the range at once. If the
+ * range has not shrunk enough after 2*log2(n) rounds the rest is sorted,
+ * which bounds the worst case at O(n log n); the expected cost is O(n).
+ * ======================================================= */
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void swap_doubles(double *v, int i, int j) {
+    double t = v[i];
+    v[i] = v[j];
+    v[j] = t;
+}
+
+double select_kth(double *v, int n, int k) {
+    int lo = 0, hi = n - 1;
+    int budget = 2;
+    for (int m = n; m > 1; m >>= 1) budget += 2;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+    while (hi - lo > 16) {
+        if (budget-- == 0) {
+            qsort(v + lo, hi - lo + 1, sizeof(double), compare_doubles);
+            return v[k];
+        }
+        int pick[3];
+        for (int p = 0; p < 3; p++) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            pick[p] = lo + (int)(rng % (uint64_t)(hi - lo + 1));
+        }
+        double a = v[pick[0]], b = v[pick[1]], c = v[pick[2]];
+        double pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+        // v[lo..lt) < pivot, v[lt..i) == pivot, v(gt..hi] > pivot
+        int lt = lo, i = lo, gt = hi;
+        while (i <= gt) {
+            if (v[i] < pivot) swap_doubles(v, lt++, i++);
+            else if (v[i] > pivot) swap_doubles(v, i, gt--);
+            else i++;
+        }
+        if (k < lt) hi = lt - 1;
+        else if (k > gt) lo = gt + 1;
+        else return pivot;
+    }
+    // Insertion sort for the last few values
+    for (int i = lo + 1; i <= hi; i++) {
+        double x = v[i];
+        int j = i - 1;
+        while (j >= lo && v[j] > x) {
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = x;
+    }
+    return v[k];
+}
+
+/* =========================================================
+ * Fill values
+ * ======================================================= */
+// Upper median of the present values; NAN (with *error set) if none
+static double column_median(const Column *col, const char **error) {
+    double *values = malloc((size_t)(col->length > 0 ? col->length : 1) * sizeof(double));
+    if (!values) {
+        *error = "Memory allocation failed.";
+        return NAN;
+    }
+    int n = 0;
+    for (int i = 0; i < col->length; i++) {
+        if (!column_is_valid(col, i)) continue;
+        double v = col->type == TYPE_INT ? (double)col->ints[i] : col->floats[i];
+        if (!isnan(v)) values[n++] = v;
+    }
+    double median = NAN;
+    if (n > 0) median = select_kth(values, n, n / 2);
+    else *error = "No valid numerical values to calculate the median.";
+    free(values);
+    return median;
+}
+
+static uint64_t hash_row(const Column *col, int row) {
+    uint64_t h;
+    switch (col->type) {
+        case TYPE_INT:
+            h = (uint64_t)col->ints[row];
+            break;
+        case TYPE_FLOAT: {
+            double v = col->floats[row] == 0 ? 0 : col->floats[row]; // -0 == 0
+            memcpy(&h, &v, sizeof(h));
+            break;
+        }
+        case TYPE_BOOL:
+            h = col->bools[row];
+            break;
+        default: {
+            h = 1469598103934665603ULL; // FNV-1a
+            for (const char *s = column_string_at(col, row); *s; s++) {
+                h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+            }
+            break;
+        }
+    }
+    // Mix so that nearby integers spread over the table
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static bool same_value(const Column *col, int a, int b) {
+    switch (col->type) {
+        case TYPE_INT: return col->ints[a] == col->ints[b];
+        case TYPE_FLOAT: return col->floats[a] == col->floats[b];
+        case TYPE_BOOL: return col->bools[a] == col->bools[b];
+        default: return strcmp(column_string_at(col, a), column_string_at(col, b)) == 0;
+    }
+}
+
+typedef struct
+{
+    int row; // first row holding the value, -1 for an empty slot
+    int count;
+} ModeSlot;
+
+// Mode of a dictionary encoded column, counted per code
+static int code_mode_row(const Column *col, const char **error) {
+    int *counts = calloc((size_t)col->dict_count + 1, sizeof(int));
+    int *first = malloc(((size_t)col->dict_count + 1) * sizeof(int));
+    if (!counts || !first) {
+        free(counts);
+        free(first);
+        *error = "Memory allocation failed.";
+        return -1;
+    }
+    int best = -1, best_count = 0;
+    for (int i = 0; i < col->length; i++) {
+        if (!column_is_valid(col, i)) continue;
+        int code = col->codes[i];
+        if (counts[code] == 0) first[code] = i;
+        int count = ++counts[code];
+        if (count > best_count || (count == best_count && first[code] < best)) {
+            best = first[code];
+            best_count = count;
+        }
+    }
+    free(counts);
+    free(first);
+    if (best < 0) *error = "No values to calculate the mode.";
+    return best;
+}
+
+// Row holding the most frequent present value, counted in one pass with an
+// open-addressing hash table. Ties go to the value seen first. Returns -1
+// (with *error set) if there is no value.
+static int column_mode_row(const Column *col, const char **error) {
+    if (col->codes) return code_mode_row(col, error);
+    size_t cap = 16;
+    while (cap < (size_t)col->length * 2) cap <<= 1;
+    ModeSlot *slots = malloc(cap * sizeof(ModeSlot));
+    if (!slots) {
+        *error = "Memory allocation failed.";
+        return -1;
+    }
+    for (size_t s = 0; s < cap; s++) slots[s].row = -1;
+
+    int best = -1, best_count = 0;
+    for (int i = 0; i < col->length; i++) {
+        if (!column_is_valid(col, i)) continue;
+        size_t s = hash_row(col, i) & (cap - 1);
+        while (slots[s].row >= 0 && !same_value(col, slots[s].row, i)) s = (s + 1) & (cap - 1);
+        if (slots[s].row < 0) {
+            slots[s].row = i;
+            slots[s].count = 0;
+        }
+        int count = ++slots[s].count;
+        if (count > best_count || (count == best_count && slots[s].row < best)) {
+            best = slots[s].row;
+            best_count = count;
+        }
+    }
+    free(slots);
+    if (best < 0) *error = "No values to calculate the mode.";
+    return best;
+}
+
+/* =========================================================
+ * Filling
+ * ======================================================= */
+// Fill an encoded column in place by writing codes. Returns false, with
+// the column untouched, when `text` does not fit in the dictionary.
+static bool fill_codes(Column *col, const char *text, bool forward) {
+    if (forward) {
+        int last = -1;
+        for (int i = 0; i < col->length; i++) {
+            if (column_is_valid(col, i)) last = col->codes[i];
+            else if (last >= 0) column_set_code(col, i, last);
+        }
+        return true;
+    }
+    if (column_null_count(col) == 0) return true;
+    int code = column_add_code(col, text);
+    if (code < 0) return false;
+    for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+        column_set_code(col, i, code);
+    }
+    return true;
+}
+
+// Rebuild a string column with its N/A replaced by `text`, or by the value
+// above when `forward` is set
+static bool fill_strings(Column *col, const char *text, bool forward) {
+    if (col->codes && fill_codes(col, text, forward)) return true;
+    Column out;
+    column_init_in(&out, col->type, col->arena);
+    bool ok = column_reserve(&out, col->length > 0 ? col->length : 1) &&
+              column_reserve_bytes(&out, col->bytes_len + (int64_t)column_null_count(col) * (text ? strlen(text) + 1 : 0));
+    const char *last = NULL;
+    for (int i = 0; ok && i < col->length; i++) {
+        const char *s = column_get_string(col, i);
+        if (s) last = s;
+        else s = forward ? last : text;
+        ok = s ? column_push_string(&out, s, strlen(s)) : column_push_null(&out);
+    }
+    if (!ok) {
+        column_free(&out);
+        return false;
+    }
+    column_free(col);
+    *col = out;
+    return true;
+}
+
+// Replace every N/A in a column with the value written as `text`,
+// widening the column type when the value does not fit it
+static bool fill_constant(Column *col, const char *text) {
+    FieldType value_type = infer_type(text);
+    if (col->type == TYPE_INT && value_type == TYPE_FLOAT && !column_convert(col, TYPE_FLOAT)) return false;
+
+    if (col->type == TYPE_INT && value_type == TYPE_INT) {
+        int64_t v = 0;
+        parse_int64(text, strlen(text), &v);
+        for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+            column_set_int(col, i, v);
+        }
+        return true;
+    }
+    if (col->type == TYPE_FLOAT && (value_type == TYPE_INT || value_type == TYPE_FLOAT)) {
+        double v = 0;
+        parse_double(text, strlen(text), &v);
+        for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+            column_set_float(col, i, v);
+        }
+        return true;
+    }
+    if (col->type == TYPE_BOOL && value_type == TYPE_BOOL) {
+        bool v = strcasecmp(text, "true") == 0;
+        for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+            column_set_bool(col, i, v);
+        }
+        return true;
+    }
+
+    // Anything else ends up as text
+    return column_convert(col, TYPE_STRING) && fill_strings(col, text, false);
+}
+
+// Fill with a number; an int column only widens when the number is not whole
+static bool fill_number(Column *col, double v) {
+    if (col->type == TYPE_INT && v == floor(v) && fabs(v) < 9.2e18) {
+        for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+            column_set_int(col, i, (int64_t)v);
+        }
+        return true;
+    }
+    if (!column_convert(col, TYPE_FLOAT)) return false;
+    for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+        column_set_float(col, i, v);
+    }
+    return true;
+}
+
+// Copy row `from` into row `to` of a column with typed storage
+static inline void copy_value(Column *col, int from, int to) {
+    switch (col->type) {
+        case TYPE_INT: column_set_int(col, to, col->ints[from]); break;
+        case TYPE_FLOAT: column_set_float(col, to, col->floats[from]); break;
+        default: column_set_bool(col, to, col->bools[from]); break;
+    }
+}
+
+static bool fill_forward(Column *col) {
+    if (col->type == TYPE_STRING || col->type == TYPE_NULL) return fill_strings(col, NULL, true);
+    // Each N/A copies the row above, which is already filled unless it is
+    // one of the leading N/A
+    for (int i = column_next_null(col, 1); i >= 0; i = column_next_null(col, i + 1)) {
+        if (column_is_valid(col, i - 1)) copy_value(col, i - 1, i);
+    }
+    return true;
+}
+
+static bool fill_from_row(Column *col, int row) {
+    if (col->type == TYPE_STRING || col->type == TYPE_NULL) {
+        // The source text moves when the column is rebuilt, so copy it first
+        char *text = strdup(column_get_string(col, row));
+        bool ok = text && fill_strings(col, text, false);
+        free(text);
+        return ok;
+    }
+    for (int i = column_next_null(col, 0); i >= 0; i = column_next_null(col, i + 1)) {
+        copy_value(col, row, i);
+    }
+    return true;
+}
+
+// `mean` is the column's mean, for IMPUTE_MEAN
+static void impute_one(Column *col, ImputeSpec *spec, double mean) {
+    const char *error = NULL;
+    int first = column_next_null(col, 0);
+    bool ok = true;
+    spec->filled = 0;
+    spec->fill_text[0] = '\0';
+    if (first < 0) {
+        spec->error = NULL;
+        return;
+    }
+    int nulls = column_null_count(col);
+
+    switch (spec->method) {
+        case IMPUTE_CONSTANT:
+            ok = fill_constant(col, spec->value);
+            break;
+        case IMPUTE_MEAN:
+        case IMPUTE_MEDIAN: {
+            if (!column_is_numeric(col)) {
+                error = "Column is not numerical.";
+                break;
+            }
+            double v;
+            if (spec->method == IMPUTE_MEAN) {
+                v = mean;
+                if (isnan(v)) error = "No valid numerical values to calculate the mean.";
+            } else {
+                v = column_median(col, &error);
+            }
+            if (!error) ok = fill_number(col, v);
+            break;
+        }
+        case IMPUTE_MODE: {
+            int row = column_mode_row(col, &error);
+            if (row >= 0) ok = fill_from_row(col, row);
+            break;
+        }
+        case IMPUTE_FFILL:
+            ok = fill_forward(col);
+            break;
+        case IMPUTE_INVALID:
+            error = "Invalid fill option.";
+            break;
+    }
+    if (!ok) error = "Memory allocation failed.";
+    if (error) {
+        spec->error = error;
+        return;
+    }
+
+    spec->error = NULL;
+    spec->filled = nulls - column_null_count(col);
+    if (spec->method != IMPUTE_FFILL) {
+        char buf[64];
+        snprintf(spec->fill_text, sizeof(spec->fill_text), "%s", column_text(col, first, buf, sizeof(buf)));
+    }
+}
+
+typedef struct
+{
+    Table *table;
+    ImputeSpec *specs;
+    double *means;   // per spec, NAN unless IMPUTE_MEAN
+} ImputeJob;
+
+static void impute_task(int i, void *ctx) {
+    ImputeJob *job = ctx;
+    ImputeSpec *spec = &job->specs[i];
+    if (spec->error) return;   // rejected before the tasks started
+    impute_one(&job->table->columns[spec->col], spec, job->means[i]);
+}
+
+bool impute_columns(Table *table, ImputeSpec *specs, int count) {
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        specs[i].filled = 0;
+        specs[i].fill_text[0] = '\0';
+        specs[i].error = NULL;
+        if (specs[i].col < 0 || specs[i].col >= table->cols) specs[i].error = "Invalid column index.";
+        for (int j = 0; j < i && !specs[i].error; j++) {
+            if (specs[j].col == specs[i].col) specs[i].error = "Column listed twice.";
+        }
+        if (specs[i].method == IMPUTE_CONSTANT && !specs[i].value) specs[i].error = "No fill value.";
+        if (specs[i].error) ok = false;
+    }
+
+    // A bad spec only skips its own column; the others are still filled.
+    // Means come from the stats cache before the tasks start
+    ImputeJob job = {table, specs, malloc((size_t)count * sizeof(double))};
+    if (!job.means) {
+        for (int i = 0; i < count; i++) {
+            if (!specs[i].error) specs[i].error = "Memory allocation failed.";
+        }
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        job.means[i] = NAN;
+        if (specs[i].error || specs[i].method != IMPUTE_MEAN || !column_is_numeric(&table->columns[specs[i].col])) continue;
+        const ColumnSummary *s = table_column_summary(table, specs[i].col, 0);
+        if (s) job.means[i] = s->mean;
+    }
+
+    // Columns are independent, so each one is filled by its own task
+    parallel_for(count, impute_task, &job);
+    for (int i = 0; i < count; i++) {
+        if (specs[i].error) ok = false;
+        if (specs[i].filled > 0) table_stats_changed(table, specs[i].col);
+    }
+    free(job.means);
+    return ok;
+}
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "infer.h"
+
+static int infer_sample = DEFAULT_INFER_SAMPLE;
+
+void set_infer_sample(int rows) {
+    infer_sample = rows < 0 ? 0 : rows;
+}
+
+int get_infer_sample(void) {
+    return infer_sample;
+}
+
+FieldType widen_type(FieldType a, FieldType b) {
+    if (a == b || b == TYPE_NULL) return a;
+    if (a == TYPE_NULL) return b;
+    if ((a == TYPE_INT && b == TYPE_FLOAT) || (a == TYPE_FLOAT && b == TYPE_INT)) return TYPE_FLOAT;
+    return TYPE_STRING;
+}
+
+void tally_init(TypeTally *t) {
+    t->numeric = t->other = TYPE_NULL;
+    t->numbers = t->others = 0;
+}
+
+void tally_add(TypeTally *t, FieldType type) {
+    if (type == TYPE_INT || type == TYPE_FLOAT) {
+        t->numeric = widen_type(t->numeric, type);
+        t->numbers++;
+    } else if (type != TYPE_NULL) {
+        t->other = widen_type(t->other, type);
+        t->others++;
+    }
+}
+
+FieldType tally_type(const TypeTally *t) {
+    if (t->numbers > 0 && few_strays(t->others, t->numbers + t->others)) return t->numeric;
+    return t->numbers > 0 ? TYPE_STRING : t->other;
+}
+
+bool few_strays(int64_t strays, int64_t values) {
+    return strays * 100 <= values * MAX_STRAY_PERCENT;
+}
+
+// The strtol/strtod test the classifier stands in for. Used for the text
+// its number grammar does not cover, such as " 5", "0x1F" or "inf".
+static FieldType infer_slow(const char *text, size_t len) {
+    char small[64];
+    char *str = len < sizeof(small) ? small : malloc(len + 1);
+    if (!str) return TYPE_STRING;
+    memcpy(str, text, len);
+    str[len] = '\0';
+
+    FieldType type = TYPE_STRING;
+    char *endptr;
+    if (strcasecmp(str, "true") == 0 || strcasecmp(str, "false") == 0) {
+        type = TYPE_BOOL;
+    } else {
+        strtol(str, &endptr, 10);
+        if (*endptr == '\0') {
+            type = TYPE_INT;
+        } else {
+            strtod(str, &endptr);
+            if (*endptr == '\0') type = TYPE_FLOAT;
+        }
+    }
+    if (str != small) free(str);
+    return type;
+}
+
+/* =========================================================
+ * Number grammar
+ * [sign] digits [. digits] [(e|E) [sign] digits], where either the integer
+ * or the fraction digits may be missing, as a DFA over five byte classes.
+ * Every byte costs two table lookups and no branch on its value.
+ * ======================================================= */
+enum { C_OTHER, C_DIGIT, C_SIGN, C_DOT, C_EXP, CLASS_COUNT };
+enum { S_START, S_SIGN, S_INT, S_DOT, S_FRAC, S_EXP, S_EXP_SIGN, S_EXP_DIGITS, S_REJECT, STATE_COUNT };
+
+static const unsigned char next_state[STATE_COUNT][CLASS_COUNT] = {
+    //             OTHER     DIGIT         SIGN        DOT       EXP
+    [S_START]      = {S_REJECT, S_INT,        S_SIGN,     S_DOT,    S_REJECT},
+    [S_SIGN]       = {S_REJECT, S_INT,        S_REJECT,   S_DOT,    S_REJECT},
+    [S_INT]        = {S_REJECT, S_INT,        S_REJECT,   S_FRAC,   S_EXP},
+    [S_DOT]        = {S_REJECT, S_FRAC,       S_REJECT,   S_REJECT, S_REJECT},
+    [S_FRAC]       = {S_REJECT, S_FRAC,       S_REJECT,   S_REJECT, S_EXP},
+    [S_EXP]        = {S_REJECT, S_EXP_DIGITS, S_EXP_SIGN, S_REJECT, S_REJECT},
+    [S_EXP_SIGN]   = {S_REJECT, S_EXP_DIGITS, S_REJECT,   S_REJECT, S_REJECT},
+    [S_EXP_DIGITS] = {S_REJECT, S_EXP_DIGITS, S_REJECT,   S_REJECT, S_REJECT},
+    [S_REJECT]     = {S_REJECT, S_REJECT,     S_REJECT,   S_REJECT, S_REJECT},
+};
+
+static const unsigned char byte_class[256] = {
+    ['0'] = C_DIGIT, ['1'] = C_DIGIT, ['2'] = C_DIGIT, ['3'] = C_DIGIT, ['4'] = C_DIGIT,
+    ['5'] = C_DIGIT, ['6'] = C_DIGIT, ['7'] = C_DIGIT, ['8'] = C_DIGIT, ['9'] = C_DIGIT,
+    ['+'] = C_SIGN, ['-'] = C_SIGN, ['.'] = C_DOT, ['e'] = C_EXP, ['E'] = C_EXP,
+};
+
+FieldType classify_field(const char *text, size_t len) {
+    if (len == 0) return TYPE_NULL;
+
+    unsigned state = S_START;
+    for (size_t i = 0; i < len; i++) state = next_state[state][byte_class[(unsigned char)text[i]]];
+
+    // Longer integers may overflow, which strtol reports its own way
+    if (state == S_INT) return len <= 18 ? TYPE_INT : infer_slow(text, len);
+    if (state == S_FRAC || state == S_EXP_DIGITS) return TYPE_FLOAT;
+
+    if ((len == 4 && strncasecmp(text, "true", 4) == 0) || (len == 5 && strncasecmp(text, "false", 5) == 0)) {
+        return TYPE_BOOL;
+    }
+    // Leading spaces, hex, "inf" and "nan" still parse as numbers
+    const char *p = text + (text[0] == '+' || text[0] == '-');
+    const char *end = text + len;
+    if (isspace((unsigned char)text[0]) || (p < end && strchr("0iInN", *p))) return infer_slow(text, len);
+    return TYPE_STRING;
+}
@@ -0,0 +1,150 @@
+#include <string.h>
+#include "lz4.h"
+
+#define MIN_MATCH 4
+#define LAST_LITERALS 5   // a block ends with at least this many literals
+#define MATCH_LIMIT 12    // no match starts in the last 12 bytes
+#define MAX_OFFSET 65535
+#define HASH_BITS 14
+#define FRAME_BLOCK_SIZE (4 << 20)
+#define FRAME_MAGIC 0x184D2204u
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void write32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static inline uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+size_t lz4_block_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz4_frame_bound(size_t size) {
+    size_t blocks = size / FRAME_BLOCK_SIZE + 1;
+    return 7 + blocks * (4 + 16) + size + size / 255 + 4;
+}
+
+// Length field continuation: 255 per byte, then the remainder
+static uint8_t *write_length(uint8_t *op, size_t len) {
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t *write_sequence(uint8_t *op, const uint8_t *literals, size_t literal_len,
+                               size_t offset, size_t match_len) {
+    uint8_t *token = op++;
+    *token = (uint8_t)((literal_len >= 15 ? 15 : literal_len) << 4);
+    if (literal_len >= 15) op = write_length(op, literal_len - 15);
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+    if (match_len == 0) return op; // last sequence: literals only
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    size_t extra = match_len - MIN_MATCH;
+    *token |= (uint8_t)(extra >= 15 ? 15 : extra);
+    if (extra >= 15) op = write_length(op, extra - 15);
+    return op;
+}
+
+size_t lz4_compress_block(const void *src, size_t size, void *dst) {
+    const uint8_t *base = src, *ip = base, *anchor = base, *end = base + size;
+    uint8_t *op = dst;
+    uint32_t table[1 << HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    if (size > MATCH_LIMIT) {
+        const uint8_t *match_limit = end - MATCH_LIMIT;
+        const uint8_t *copy_limit = end - LAST_LITERALS;
+        // Positions are stored plus one so that zero means empty
+        while (ip < match_limit) {
+            uint32_t h = hash4(read32(ip));
+            uint32_t seen = table[h];
+            table[h] = (uint32_t)(ip - base) + 1;
+            const uint8_t *ref = base + (seen ? seen - 1 : 0);
+            if (!seen || ip - ref > MAX_OFFSET || read32(ref) != read32(ip)) {
+                // Skip faster through data that does not compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const uint8_t *m = ip + MIN_MATCH, *r = ref + MIN_MATCH;
+            while (m < copy_limit && *m == *r) {
+                m++;
+                r++;
+            }
+            op = write_sequence(op, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(m - ip));
+            // Index one position inside the match so runs keep matching
+            if (m - 2 > base && m < match_limit) table[hash4(read32(m - 2))] = (uint32_t)(m - 2 - base) + 1;
+            ip = anchor = m;
+        }
+    }
+    op = write_sequence(op, anchor, (size_t)(end - anchor), 0, 0);
+    return (size_t)(op - (uint8_t *)dst);
+}
+
+/* =========================================================
+ * Frame format: header, blocks of up to 4 MB, end mark
+ * ======================================================= */
+#define PRIME1 2654435761u
+#define PRIME2 2246822519u
+#define PRIME3 3266489917u
+#define PRIME4 668265263u
+#define PRIME5 374761393u
+
+static inline uint32_t rotl32(uint32_t v, int r) {
+    return (v << r) | (v >> (32 - r));
+}
+
+// xxHash32 of a few bytes (fewer than 16), as the frame header checksum needs
+static uint32_t xxh32_short(const uint8_t *p, size_t len) {
+    uint32_t h = PRIME5 + (uint32_t)len;
+    for (; len >= 4; p += 4, len -= 4) h = rotl32(h + read32(p) * PRIME3, 17) * PRIME4;
+    for (; len > 0; p++, len--) h = rotl32(h + *p * PRIME5, 11) * PRIME1;
+    h ^= h >> 15;
+    h *= PRIME2;
+    h ^= h >> 13;
+    h *= PRIME3;
+    h ^= h >> 16;
+    return h;
+}
+
+size_t lz4_compress_frame(const void *src, size_t size, void *dst) {
+    uint8_t *op = dst;
+    write32(op, FRAME_MAGIC);
+    op[4] = 0x60; // version 1, independent blocks, no checksums or size
+    op[5] = 0x70; // 4 MB blocks
+    op[6] = (uint8_t)(xxh32_short(op + 4, 2) >> 8);
+    op += 7;
+
+    const uint8_t *ip = src;
+    for (size_t left = size; left > 0;) {
+        size_t n = left < FRAME_BLOCK_SIZE ? left : FRAME_BLOCK_SIZE;
+        size_t packed = lz4_compress_block(ip, n, op + 4);
+        if (packed >= n) {
+            // Stored as is, flagged by the high bit of the size
+            memcpy(op + 4, ip, n);
+            write32(op, (uint32_t)n | 0x80000000u);
+            packed = n;
+        } else {
+            write32(op, (uint32_t)packed);
+        }
+        op += 4 + packed;
+        ip += n;
+        left -= n;
+    }
+    write32(op, 0);
+    return (size_t)(op + 4 - (uint8_t *)dst);
+}
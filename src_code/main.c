@@ -8,6 +8,16 @@
 #include "Investigate.h"
 #include "data_preparation.h"
 #include "export.h"
+#include "threadpool.h"
+#include "profile.h"
+#include "infer.h"
+#include "numparse.h"
+#include "snapshot.h"
+#include "dictionary.h"
+#include "pipeline.h"
+#include "bench.h"
+#include "csvparse.h"
+#include "trace.h"
 
 
 
@@ -20,31 +30,148 @@ void intro() {
     printf("Explore the features below through our interactive menu.\n\n");
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     Table table = {0};
     char filename[256];
     char choice[10];
     int sub_choice, num, col;
     char value[256];
+
+    // -t N / --threads N: worker threads for loading (0 = one per CPU)
+    // --profile FILE: stream FILE into Data/output_stats.csv and exit
+    // --batch KB: input read per batch in profile mode
+    // --exact / --quantile-error EPS: exact or approximate quartiles
+    // --infer-sample N: rows sampled to guess column types (0 = every row)
+    // --bench-parse N: time the number parser against libc on N fields
+    // --scan MODE: CSV tokenizer (auto, scalar, block, sse2, avx2)
+    // --check-scan FILE: index FILE with every tokenizer and compare them
+    // --compress: LZ4-compress Arrow and Parquet exports
+    // --dict-limit N: most distinct strings kept as a dictionary (0 = never)
+    // --pipeline SPEC / --pipeline-file FILE: run steps without the menus
+    //   e.g. "load big.csv -> fill_na(score, median) -> drop_na -> export out.parquet"
+    //   "export FILE COL..." writes only the listed columns
+    // --data SPEC: shape of generated data, e.g.
+    //   "rows=1e6 cols=12 mix=4:4:3:1 nulls=0.05 quoted=0.1 card=1000 seed=7"
+    // --generate FILE: write a generated CSV and exit
+    // --bench REPORT [--repeat N]: time the main operations on generated data
+    //   and write REPORT (.json, otherwise CSV)
+    // --trace FILE: write a Chrome trace of loads, menu operations and saves
+    // --trace-report FILE: the same scopes and counters as a JSON report
+    const char *profile_file = NULL;
+    const char *pipeline_spec = NULL, *pipeline_file = NULL;
+    const char *generate_file = NULL, *bench_report = NULL;
+    const char *trace_file = NULL, *trace_report = NULL;
+    const char *check_file = NULL;
+    int bench_repeat = DEFAULT_BENCH_REPEAT;
+    DataSpec data_spec;
+    datagen_default(&data_spec);
+    size_t batch_bytes = PROFILE_BATCH_BYTES;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            set_thread_count(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        } else if (strcmp(argv[i], "--exact") == 0) {
+            set_quantile_error(0);
+        } else if (strcmp(argv[i], "--quantile-error") == 0 && i + 1 < argc) {
+            set_quantile_error(atof(argv[++i]));
+        } else if (strcmp(argv[i], "--infer-sample") == 0 && i + 1 < argc) {
+            set_infer_sample(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            set_export_compression(true);
+        } else if (strcmp(argv[i], "--dict-limit") == 0 && i + 1 < argc) {
+            set_dictionary_limit(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc) {
+            pipeline_spec = argv[++i];
+        } else if (strcmp(argv[i], "--pipeline-file") == 0 && i + 1 < argc) {
+            pipeline_file = argv[++i];
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            if (!datagen_parse(&data_spec, argv[++i])) return 1;
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            generate_file = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            bench_report = argv[++i];
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            bench_repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "--trace-report") == 0 && i + 1 < argc) {
+            trace_report = argv[++i];
+        } else if (strcmp(argv[i], "--bench-parse") == 0 && i + 1 < argc) {
+            numparse_benchmark(atoi(argv[++i]));
+            return 0;
+        } else if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            ScanMode mode = SCAN_AUTO;
+            while (mode < SCAN_MODES && strcmp(csv_scan_mode_name(mode), name) != 0) mode++;
+            if (mode == SCAN_MODES) {
+                printf("Unknown scan mode '%s'.\n", name);
+                return 1;
+            }
+            csv_set_scan_mode(mode);
+        } else if (strcmp(argv[i], "--check-scan") == 0 && i + 1 < argc) {
+            check_file = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            batch_bytes = (size_t)atoi(argv[++i]) * 1024;
+        } else {
+            printf("Usage: %s [-t threads] [--exact | --quantile-error eps] [--infer-sample rows] [--compress] [--dict-limit n] [--pipeline spec | --pipeline-file file] [--data spec] [--generate file | --bench report [--repeat n]] [--trace file] [--trace-report file] [--bench-parse n] [--scan mode] [--check-scan file] [--profile file [--batch KB]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (trace_file || trace_report) trace_enable(trace_report, trace_file);
+    if (generate_file) {
+        return datagen_write(&data_spec, generate_file) ? 0 : 1;
+    }
+    if (check_file) {
+        return check_scan_modes(check_file) ? 0 : 1;
+    }
+    if (bench_report) {
+        return run_benchmarks(&data_spec, bench_repeat, bench_report) ? 0 : 1;
+    }
+    if (profile_file) {
+        bool ok;
+        TRACE_CALL("profile", ok = profile_csv_stream(profile_file, "../Data/output_stats.csv", batch_bytes));
+        return ok ? 0 : 1;
+    }
+    if (pipeline_spec || pipeline_file) {
+        Pipeline pipeline;
+        bool ok = pipeline_spec ? pipeline_parse(&pipeline, pipeline_spec) : pipeline_parse_file(&pipeline, pipeline_file);
+        if (ok) TRACE_CALL("pipeline", ok = pipeline_run(&pipeline));
+        pipeline_free(&pipeline);
+        return ok ? 0 : 1;
+    }
     intro();
     
     printf("Enter CSV filename: ");
     fgets(filename, sizeof(filename), stdin);
     filename[strcspn(filename, "\n")] = 0;
 
-    if (!load_csv(&table, filename)) {
-        printf("Failed to load CSV file.\n");
-        return 1;
+    // A snapshot saved with [7] reopens without parsing and brings its stats
+    if (is_snapshot(filename)) {
+        ColumnSummary *stats;
+        if (!snapshot_load(&table, filename, &stats)) {
+            printf("Failed to load snapshot.\n");
+            return 1;
+        }
+        export_summary_csv(&table, stats, "../Data/initial_stats.csv");
+        free(stats);
+    } else {
+        if (!load_csv(&table, filename)) {
+            printf("Failed to load CSV file.\n");
+            return 1;
+        }
+        export_stats_csv(&table, "../Data/initial_stats.csv");
     }
-    export_stats_csv(&table, "../Data/initial_stats.csv");
     while (1) {
         printf("\nMain Menu:\n");
         printf("[1] View data: head(num), tail(num)\n");
         printf("[2] View stats: info, stat\n");
-        printf("[3] Investigate: column, count_isna(col), na_count, find_outlier()\n");
+        printf("[3] Investigate: column, count_isna(col), na_count, find_outlier(), value_counts(col)\n");
         printf("[4] Clean data (Preprocess): isna, find_na, fill_na, drop_na\n");
         printf("[5] Prepare Data: bucket_col(), outlier_detection(), scale_to_range(col,a,b)\n");
         printf("[6] Quit\n");
+        printf("[7] Save snapshot\n");
+        printf("[8] Export cleaned data (.csv, .arrow/.feather, .parquet)\n");
         printf("Enter choice: ");
         fgets(choice, sizeof(choice), stdin);
         choice[strcspn(choice, "\n")] = 0;
@@ -69,8 +196,8 @@ int main() {
                     continue;
                 }
                 while (getchar() != '\n');
-                if (sub_choice == 1) print_head(&table, num);
-                else if (sub_choice == 2) print_tail(&table, num);
+                if (sub_choice == 1) TRACE_CALL("head", print_head(&table, num));
+                else if (sub_choice == 2) TRACE_CALL("tail", print_tail(&table, num));
             }
 
         } else if (strcmp(choice, "2") == 0) {
@@ -84,9 +211,9 @@ int main() {
                 choice[strcspn(choice, "\n")] = 0;
 
                 if (strcmp(choice, "a") == 0) {
-                    print_info(&table);
+                    TRACE_CALL("info", print_info(&table));
                 } else if (strcmp(choice, "b") == 0) {
-                    print_stats(&table);
+                    TRACE_CALL("print_stats", print_stats(&table));
                 } else if (strcmp(choice, "x") == 0) {
                     break;
                 } else {
@@ -101,23 +228,30 @@ int main() {
                 printf("[b] count_isna(col)\n");
                 printf("[c] na_count()\n");
                 printf("[d] find_outlier()\n");
+                printf("[e] value_counts(col)\n");
                 printf("[x] Exit to Main Menu\n");
                 printf("Enter choice: ");
                 fgets(choice, sizeof(choice), stdin);
                 choice[strcspn(choice, "\n")] = 0;
 
                 if (strcmp(choice, "a") == 0) {
-                    list_columns(&table);
+                    TRACE_CALL("list_columns", list_columns(&table));
                 } else if (strcmp(choice, "b") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
                         while (getchar() != '\n');
-                        count_isna(&table, col);
+                        TRACE_CALL("count_isna", count_isna(&table, col));
                     }
                 } else if (strcmp(choice, "c") == 0) {
-                    na_count(&table);
+                    TRACE_CALL("na_count", na_count(&table));
                 } else if (strcmp(choice, "d") == 0) {
-                    find_outlier(&table);
+                    TRACE_CALL("find_outlier", find_outlier(&table));
+                } else if (strcmp(choice, "e") == 0) {
+                    printf("Enter column index: ");
+                    if (scanf("%d", &col) == 1) {
+                        while (getchar() != '\n');
+                        TRACE_CALL("value_counts", value_counts(&table, col, 20));
+                    }
                 } else if (strcmp(choice, "x") == 0) {
                     break;
                 } else {
@@ -132,39 +266,68 @@ int main() {
                 printf("[b] find_na(col)\n");
                 printf("[c] fill_na(col, value)\n");
                 printf("[d] drop_na(col)\n");
+                printf("[f] drop_na_any()\n");
+                printf("[g] fill_na(cols, value)\n");
+                printf("[h] keep rows where col == value\n");
                 printf("[x] Exit to Main Menu\n");
                 printf("Enter choice: ");
                 fgets(choice, sizeof(choice), stdin);
                 choice[strcspn(choice, "\n")] = 0;
 
                 if (strcmp(choice, "a") == 0) {
-                    isna(&table);
+                    TRACE_CALL("isna", isna(&table));
                 } else if (strcmp(choice, "b") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
                         while (getchar() != '\n');
-                        find_na(&table, col);
+                        TRACE_CALL("find_na", find_na(&table, col));
                     }
                 } else if (strcmp(choice, "c") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
                         while (getchar() != '\n');
-                        printf("Enter value (0, mean, median): ");
+                        printf("Enter value (mean, median, mode, ffill, a number, true/false or value=TEXT): ");
                         fgets(value, sizeof(value), stdin);
                         value[strcspn(value, "\n")] = 0;
-                        fill_na(&table, col, value);
+                        TRACE_CALL("fill_na", fill_na(&table, col, value));
                     }
                 } else if (strcmp(choice, "d") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
                         while (getchar() != '\n');
-                        drop_na(&table, col);
+                        TRACE_CALL("drop_na", drop_na(&table, col));
                     }
                 } else if (strcmp(choice, "e") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
                         while (getchar() != '\n');
-                        convert_to_num(&table, col);
+                        TRACE_CALL("convert_to_num", convert_to_num(&table, col));
+                    }
+                } else if (strcmp(choice, "f") == 0) {
+                    TRACE_CALL("drop_na_any", drop_na_any(&table));
+                } else if (strcmp(choice, "g") == 0) {
+                    printf("Enter column indices separated by spaces: ");
+                    fgets(value, sizeof(value), stdin);
+                    int *cols = malloc(sizeof(value) * sizeof(int));
+                    int count = 0;
+                    char *p = value, *end;
+                    for (long c = strtol(p, &end, 10); cols && end != p; c = strtol(p, &end, 10)) {
+                        cols[count++] = (int)c;
+                        p = end;
+                    }
+                    printf("Enter value (mean, median, mode, ffill, a number, true/false or value=TEXT): ");
+                    fgets(value, sizeof(value), stdin);
+                    value[strcspn(value, "\n")] = 0;
+                    if (cols) TRACE_CALL("fill_na_columns", fill_na_columns(&table, cols, count, value));
+                    free(cols);
+                } else if (strcmp(choice, "h") == 0) {
+                    printf("Enter column index: ");
+                    if (scanf("%d", &col) == 1) {
+                        while (getchar() != '\n');
+                        printf("Enter value: ");
+                        fgets(value, sizeof(value), stdin);
+                        value[strcspn(value, "\n")] = 0;
+                        TRACE_CALL("keep_equal", keep_equal(&table, col, value));
                     }
                 } else if (strcmp(choice, "x") == 0) {
                     break;
@@ -192,11 +355,11 @@ int main() {
                         int buckets;
                         if (scanf("%d", &buckets) == 1) {
                             while (getchar() != '\n');
-                            bucket_col(&table, col, buckets, 1);
+                            TRACE_CALL("bucket_col", bucket_col(&table, col, buckets, 1));
                         }
                     }
                 } else if (strcmp(choice, "b") == 0) {
-                    outlier_detection(&table);
+                    TRACE_CALL("outlier_detection", outlier_detection(&table));
                 } else if (strcmp(choice, "c") == 0) {
                     printf("Enter column index: ");
                     if (scanf("%d", &col) == 1) {
@@ -207,7 +370,7 @@ int main() {
                         printf("Enter max (b): ");
                         scanf("%lf", &b);
                         while (getchar() != '\n');
-                        scale_to_range(&table, col, a, b, 1);
+                        TRACE_CALL("scale_to_range", scale_to_range(&table, col, a, b, 1));
                     }
                 } else if (strcmp(choice, "x") == 0) {
                     break;
@@ -217,12 +380,23 @@ int main() {
             }
 
         } else if (strcmp(choice, "6") == 0) {
-            save_csv(&table, "../Data/output_cleaned.csv");
+            save_csv_atomic(&table, "../Data/output_cleaned.csv");
             export_stats_csv(&table, "../Data/output_stats.csv");
             printf("Cleaned data saved to 'Data/output_cleaned.csv'.\n");
             printf("Statistics saved to 'Data/output_stats.csv'.\n");
             free_table(&table);
             break;
+        } else if (strcmp(choice, "7") == 0) {
+            printf("Enter snapshot filename: ");
+            fgets(value, sizeof(value), stdin);
+            value[strcspn(value, "\n")] = 0;
+            if (snapshot_save(&table, value)) printf("Snapshot saved to '%s'.\n", value);
+            else printf("Error: Could not write snapshot '%s'.\n", value);
+        } else if (strcmp(choice, "8") == 0) {
+            printf("Enter output filename: ");
+            fgets(value, sizeof(value), stdin);
+            value[strcspn(value, "\n")] = 0;
+            export_cleaned_data(&table, value);
         } else {
             printf("Invalid main menu choice.\n");
         }
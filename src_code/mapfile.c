@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Fallback for files that cannot be mapped (pipes, special files)
+static bool read_whole_file(MappedFile *mf, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    size_t cap = 1 << 16, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) {
+        fclose(fp);
+        return false;
+    }
+    size_t n;
+    while ((n = fread(buf + len, 1, cap - len, fp)) > 0) {
+        len += n;
+        if (len == cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                fclose(fp);
+                return false;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(fp);
+    mf->data = buf;
+    mf->size = len;
+    mf->mapped = false;
+    return true;
+}
+
+#ifdef _WIN32
+
+static bool map_file_mode(MappedFile *mf, const char *path, bool writable) {
+    memset(mf, 0, sizeof(*mf));
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return read_whole_file(mf, path);
+    }
+    HANDLE map = CreateFileMappingA(file, NULL, writable ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    const char *data = map ? MapViewOfFile(map, writable ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!data) {
+        if (map) CloseHandle(map);
+        CloseHandle(file);
+        return read_whole_file(mf, path);
+    }
+    mf->data = data;
+    mf->size = (size_t)size.QuadPart;
+    mf->mapped = true;
+    mf->file_handle = file;
+    mf->map_handle = map;
+    return true;
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->mapped) {
+        UnmapViewOfFile(mf->data);
+        CloseHandle(mf->map_handle);
+        CloseHandle(mf->file_handle);
+    } else {
+        free((void *)mf->data);
+    }
+    memset(mf, 0, sizeof(*mf));
+}
+
+#else
+
+static bool map_file_mode(MappedFile *mf, const char *path, bool writable) {
+    memset(mf, 0, sizeof(*mf));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return read_whole_file(mf, path);
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return read_whole_file(mf, path);
+
+    if (!writable) madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    mf->data = data;
+    mf->size = (size_t)st.st_size;
+    mf->mapped = true;
+    return true;
+}
+
+void unmap_file(MappedFile *mf) {
+    if (mf->mapped) munmap((void *)mf->data, mf->size);
+    else free((void *)mf->data);
+    memset(mf, 0, sizeof(*mf));
+}
+
+#endif
+
+bool map_file(MappedFile *mf, const char *path) {
+    return map_file_mode(mf, path, false);
+}
+
+bool map_file_writable(MappedFile *mf, const char *path) {
+    return map_file_mode(mf, path, true);
+}
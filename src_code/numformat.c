@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "numformat.h"
+#include "numparse.h"
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// Digits of v, written backwards from `end`. Returns the first digit.
+static char *write_digits(uint64_t v, char *end) {
+    char *p = end;
+    while (v >= 100) {
+        p -= 2;
+        memcpy(p, digit_pairs + (v % 100) * 2, 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + v * 2, 2);
+    } else {
+        *--p = (char)('0' + v);
+    }
+    return p;
+}
+
+int format_int64(int64_t v, char *buf) {
+    char tmp[24];
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    char *first = write_digits(u, tmp + sizeof(tmp));
+    int len = (int)(tmp + sizeof(tmp) - first);
+    char *p = buf;
+    if (v < 0) *p++ = '-';
+    memcpy(p, first, len);
+    p[len] = '\0';
+    return (int)(p - buf) + len;
+}
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+};
+
+// %.15g, %.16g or %.17g, whichever is first to read back as v. %g drops
+// trailing zeros, so %.15g already gives the shortest text whenever 15
+// digits are enough.
+static int format_slow(double v, char *buf) {
+    int len = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        len = snprintf(buf, NUMBER_TEXT_LEN, "%.*g", precision, v);
+        double back;
+        if (!isfinite(v) || (parse_double(buf, len, &back) && back == v)) break;
+    }
+    return len;
+}
+
+// Most values in data files are short decimals: v == m / 10^k for an
+// integer m of at most 15 digits. The smallest such k is found by
+// rounding v * 10^k and checking that m / 10^k (an exact division, so the
+// same value parse_double would give) is v again. With at most 15 digits,
+// that m is also what %.15g prints. Anything else goes through printf.
+int format_double(double v, char *buf) {
+    double a = fabs(v);
+    if (a == 0) {
+        strcpy(buf, signbit(v) ? "-0" : "0");
+        return (int)strlen(buf);
+    }
+    if (!(a >= 1e-5 && a < 1e15)) return format_slow(v, buf);
+
+    uint64_t m = 0;
+    int k = 0;
+    for (;; k++) {
+        if (k >= (int)(sizeof(powers_of_ten) / sizeof(powers_of_ten[0]))) return format_slow(v, buf);
+        double scaled = a * powers_of_ten[k];
+        if (scaled >= 1e15) return format_slow(v, buf);
+        m = (uint64_t)(scaled + 0.5);
+        if ((double)m / powers_of_ten[k] == a) break;
+    }
+
+    char tmp[24];
+    char *first = write_digits(m, tmp + sizeof(tmp));
+    int digits = (int)(tmp + sizeof(tmp) - first);
+    int exponent = digits - 1 - k; // of the leading digit, as %g sees it
+    if (exponent < -4) return format_slow(v, buf);
+
+    char *p = buf;
+    if (v < 0) *p++ = '-';
+    if (k == 0) {
+        memcpy(p, first, digits);
+        p += digits;
+    } else if (k >= digits) {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', k - digits);
+        p += k - digits;
+        memcpy(p, first, digits);
+        p += digits;
+    } else {
+        memcpy(p, first, digits - k);
+        p += digits - k;
+        *p++ = '.';
+        memcpy(p, first + digits - k, k);
+        p += k;
+    }
+    *p = '\0';
+    return (int)(p - buf);
+}
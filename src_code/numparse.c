@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <float.h>
+#include "numparse.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HAVE_SWAR 1
+#endif
+
+// The fast path needs every double operation rounded once, to double
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define EXACT_DOUBLE_MATH 1
+#endif
+
+// strtoll/strtod on a NUL-terminated copy, for the text the fast paths skip
+static bool parse_libc(const char *text, size_t len, bool integer, int64_t *iout, double *dout) {
+    char small[64];
+    char *str = len < sizeof(small) ? small : malloc(len + 1);
+    if (!str) return false;
+    memcpy(str, text, len);
+    str[len] = '\0';
+    char *endptr;
+    if (integer) *iout = strtoll(str, &endptr, 10);
+    else *dout = strtod(str, &endptr);
+    bool ok = len > 0 && *endptr == '\0';
+    if (str != small) free(str);
+    return ok;
+}
+
+#ifdef HAVE_SWAR
+// Eight bytes that are all ASCII digits
+static inline bool eight_digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL) &&
+           (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) == 0x3030303030303030ULL);
+}
+
+// Value of eight ASCII digits, first digit in the lowest byte: pairs, then
+// quads, then the whole word are combined with three multiplies
+static inline uint32_t eight_digit_value(uint64_t v) {
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (uint32_t)v;
+}
+#endif
+
+// Fold the digits at p into *value, at most `max` of them. Returns the
+// number of digits read.
+static inline size_t read_digits(const char *p, const char *end, uint64_t *value, size_t max) {
+    const char *start = p;
+    uint64_t v = *value;
+#ifdef HAVE_SWAR
+    while (end - p >= 8 && (size_t)(p - start) + 8 <= max) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        if (!eight_digits(word)) break;
+        v = v * 100000000 + eight_digit_value(word);
+        p += 8;
+    }
+#endif
+    while (p < end && (size_t)(p - start) < max && (unsigned)(*p - '0') < 10) {
+        v = v * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    *value = v;
+    return (size_t)(p - start);
+}
+
+bool parse_int64(const char *text, size_t len, int64_t *out) {
+    const char *p = text, *end = text + len;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    // Up to 18 digits cannot overflow; longer runs saturate the libc way
+    uint64_t v = 0;
+    size_t digits = read_digits(p, end, &v, 18);
+    if (digits == 0 || p + digits != end) return parse_libc(text, len, true, out, NULL);
+    *out = negative ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
+// Exact powers of ten as doubles
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define MAX_EXACT_MANTISSA ((uint64_t)1 << 53)
+
+// Decimal text is mantissa * 10^exponent. When the mantissa fits in 53
+// bits and 10^|exponent| is an exact double, one IEEE multiply or divide of
+// two exact values is correctly rounded (Clinger's fast path). Everything
+// else goes to strtod.
+bool parse_double(const char *text, size_t len, double *out) {
+    const char *p = text, *end = text + len;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    size_t int_digits = read_digits(p, end, &mantissa, 19);
+    p += int_digits;
+    size_t frac_digits = 0;
+    if (p < end && *p == '.') {
+        p++;
+        frac_digits = read_digits(p, end, &mantissa, 19 - int_digits);
+        p += frac_digits;
+    }
+    int64_t exponent = -(int64_t)frac_digits;
+    if (int_digits + frac_digits == 0) return parse_libc(text, len, false, NULL, out);
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool exp_negative = false;
+        if (p < end && (*p == '-' || *p == '+')) exp_negative = *p++ == '-';
+        uint64_t e = 0;
+        size_t exp_digits = read_digits(p, end, &e, 4);
+        if (exp_digits == 0) return parse_libc(text, len, false, NULL, out);
+        p += exp_digits;
+        exponent += exp_negative ? -(int64_t)e : (int64_t)e;
+    }
+    // Leftover bytes: more than 19 digits, or not plain decimal text
+    if (p != end) return parse_libc(text, len, false, NULL, out);
+
+    double value;
+#ifndef EXACT_DOUBLE_MATH
+    if (mantissa != 0) return parse_libc(text, len, false, NULL, out);
+#endif
+    if (mantissa == 0) {
+        value = 0;
+    } else if (mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 && exponent <= 22) {
+        value = (double)mantissa;
+        value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+    } else if (mantissa <= MAX_EXACT_MANTISSA && exponent > 22 && exponent <= 22 + 15) {
+        // Move part of the exponent into the mantissa while that stays exact
+        uint64_t scaled = mantissa;
+        for (int64_t e = exponent; e > 22; e--) {
+            scaled *= 10;
+            if (scaled > MAX_EXACT_MANTISSA) return parse_libc(text, len, false, NULL, out);
+        }
+        value = (double)scaled * powers_of_ten[22];
+    } else {
+        return parse_libc(text, len, false, NULL, out);
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+/* =========================================================
+ * Microbenchmark
+ * ======================================================= */
+static double seconds_since(clock_t start) {
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Fields of the kind found in CSV files, packed back to back
+static char *make_fields(int count, bool integer, size_t **offsets) {
+    char *buf = malloc((size_t)count * 24 + 1);
+    *offsets = malloc(((size_t)count + 1) * sizeof(size_t));
+    if (!buf || !*offsets) {
+        free(buf);
+        free(*offsets);
+        return NULL;
+    }
+    uint64_t rng = 88172645463325252ULL;
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        (*offsets)[i] = pos;
+        if (integer) {
+            pos += sprintf(buf + pos, "%lld", (long long)(rng % 2000000000) - 1000000000);
+        } else {
+            int decimals = (int)(rng >> 60) % 7;
+            pos += sprintf(buf + pos, "%.*f", decimals, (double)(rng % 100000000) / 1000.0 - 50000.0);
+        }
+    }
+    (*offsets)[count] = pos;
+    return buf;
+}
+
+static void bench_kind(int count, bool integer) {
+    size_t *offsets;
+    char *buf = make_fields(count, integer, &offsets);
+    if (!buf) {
+        printf("Error: Memory allocation failed.\n");
+        return;
+    }
+    // libc needs NUL-terminated text, so give it its own copy of each field
+    char *terminated = malloc(offsets[count] + count);
+    if (!terminated) {
+        printf("Error: Memory allocation failed.\n");
+        free(buf);
+        free(offsets);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(terminated + offsets[i] + i, buf + offsets[i], offsets[i + 1] - offsets[i]);
+        terminated[offsets[i + 1] + i] = '\0';
+    }
+
+    double libc_sum = 0, fast_sum = 0;
+    int mismatches = 0;
+    clock_t start = clock();
+    for (int i = 0; i < count; i++) {
+        const char *s = terminated + offsets[i] + i;
+        libc_sum += integer ? (double)strtoll(s, NULL, 10) : strtod(s, NULL);
+    }
+    double libc_time = seconds_since(start);
+
+    start = clock();
+    for (int i = 0; i < count; i++) {
+        int64_t iv;
+        double dv = 0;
+        if (integer && parse_int64(buf + offsets[i], offsets[i + 1] - offsets[i], &iv)) dv = (double)iv;
+        else if (!integer) parse_double(buf + offsets[i], offsets[i + 1] - offsets[i], &dv);
+        fast_sum += dv;
+    }
+    double fast_time = seconds_since(start);
+
+    for (int i = 0; i < count; i++) {
+        const char *s = terminated + offsets[i] + i;
+        int64_t iv;
+        double dv;
+        size_t len = offsets[i + 1] - offsets[i];
+        if (integer ? !parse_int64(buf + offsets[i], len, &iv) || iv != strtoll(s, NULL, 10)
+                    : !parse_double(buf + offsets[i], len, &dv) || dv != strtod(s, NULL)) {
+            mismatches++;
+        }
+    }
+
+    double mb = offsets[count] / (1024.0 * 1024.0);
+    printf("%-6s %d fields, %.1f MB\n", integer ? "int" : "float", count, mb);
+    printf("  libc: %.3f s (%.0f MB/s)\n", libc_time, libc_time > 0 ? mb / libc_time : 0);
+    printf("  fast: %.3f s (%.0f MB/s)\n", fast_time, fast_time > 0 ? mb / fast_time : 0);
+    printf("  mismatches: %d%s\n", mismatches, libc_sum == fast_sum ? "" : " (sums differ)");
+    free(terminated);
+    free(buf);
+    free(offsets);
+}
+
+void numparse_benchmark(int count) {
+    if (count <= 0) count = 1000000;
+    bench_kind(count, true);
+    bench_kind(count, false);
+}
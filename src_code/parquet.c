@@ -0,0 +1,470 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "parquet.h"
+#include "dictionary.h"
+#include "export.h"
+#include "lz4.h"
+#include "threadpool.h"
+
+#define PARQUET_MAGIC "PAR1"
+
+// Enumerations from parquet.thrift
+enum { PQ_BOOLEAN = 0, PQ_INT64 = 2, PQ_DOUBLE = 5, PQ_BYTE_ARRAY = 6 };
+enum { ENC_PLAIN = 0, ENC_RLE = 3, ENC_RLE_DICTIONARY = 8 };
+enum { PAGE_DATA = 0, PAGE_DICTIONARY = 2 };
+enum { CODEC_UNCOMPRESSED = 0, CODEC_LZ4_RAW = 7 };
+enum { OPTIONAL = 1, CONVERTED_UTF8 = 0 };
+
+/* =========================================================
+ * Byte buffers and the Thrift compact protocol
+ * ======================================================= */
+typedef struct
+{
+    uint8_t *data;
+    size_t len, cap;
+    bool failed;
+} ByteBuf;
+
+static uint8_t *buf_grow(ByteBuf *b, size_t n) {
+    if (b->failed) return NULL;
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 4096;
+        while (cap < b->len + n) cap *= 2;
+        uint8_t *data = realloc(b->data, cap);
+        if (!data) {
+            b->failed = true;
+            return NULL;
+        }
+        b->data = data;
+        b->cap = cap;
+    }
+    uint8_t *p = b->data + b->len;
+    b->len += n;
+    return p;
+}
+
+static void buf_append(ByteBuf *b, const void *data, size_t n) {
+    uint8_t *p = buf_grow(b, n);
+    if (p && n > 0) memcpy(p, data, n);
+}
+
+static void buf_le(ByteBuf *b, uint64_t v, int size) {
+    uint8_t *p = buf_grow(b, (size_t)size);
+    for (int i = 0; p && i < size; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void buf_varint(ByteBuf *b, uint64_t v) {
+    for (; v >= 0x80; v >>= 7) buf_le(b, (v & 0x7F) | 0x80, 1);
+    buf_le(b, v, 1);
+}
+
+// Compact protocol type codes
+enum { T_TRUE = 1, T_FALSE = 2, T_I32 = 5, T_I64 = 6, T_BINARY = 8, T_LIST = 9, T_STRUCT = 12 };
+
+#define THRIFT_DEPTH 8
+
+typedef struct
+{
+    ByteBuf out;
+    int last[THRIFT_DEPTH]; // last field id written at each struct level
+    int depth;
+} Thrift;
+
+static void th_field(Thrift *t, int id, int type) {
+    int delta = id - t->last[t->depth];
+    if (delta > 0 && delta <= 15) {
+        buf_le(&t->out, (uint64_t)(delta << 4 | type), 1);
+    } else {
+        buf_le(&t->out, (uint64_t)type, 1);
+        buf_varint(&t->out, (uint64_t)((id << 1) ^ (id >> 15)));
+    }
+    t->last[t->depth] = id;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static void th_i32(Thrift *t, int id, int32_t v) {
+    th_field(t, id, T_I32);
+    buf_varint(&t->out, zigzag(v));
+}
+
+static void th_i64(Thrift *t, int id, int64_t v) {
+    th_field(t, id, T_I64);
+    buf_varint(&t->out, zigzag(v));
+}
+
+static void th_binary_value(Thrift *t, const void *data, size_t len) {
+    buf_varint(&t->out, len);
+    buf_append(&t->out, data, len);
+}
+
+static void th_binary(Thrift *t, int id, const void *data, size_t len) {
+    th_field(t, id, T_BINARY);
+    th_binary_value(t, data, len);
+}
+
+// A struct as a field (id > 0) or as a list element (id 0)
+static void th_begin(Thrift *t, int id) {
+    if (id > 0) th_field(t, id, T_STRUCT);
+    t->last[++t->depth] = 0;
+}
+
+static void th_end(Thrift *t) {
+    buf_le(&t->out, 0, 1);
+    t->depth--;
+}
+
+static void th_list(Thrift *t, int id, int elem_type, size_t count) {
+    th_field(t, id, T_LIST);
+    if (count < 15) {
+        buf_le(&t->out, (uint64_t)(count << 4 | (size_t)elem_type), 1);
+    } else {
+        buf_le(&t->out, 0xF0 | (uint64_t)elem_type, 1);
+        buf_varint(&t->out, count);
+    }
+}
+
+/* =========================================================
+ * RLE / bit-packing hybrid
+ * Runs of eight or more equal values become RLE runs; everything else
+ * is bit-packed eight values at a time. Only the final group is padded.
+ * ======================================================= */
+static int run_length(const uint32_t *v, int n, int i) {
+    int j = i + 1;
+    while (j < n && v[j] == v[i]) j++;
+    return j - i;
+}
+
+static void encode_hybrid(ByteBuf *b, const uint32_t *v, int n, int width) {
+    int value_bytes = (width + 7) / 8;
+    for (int i = 0; i < n;) {
+        int run = run_length(v, n, i);
+        if (run >= 8) {
+            buf_varint(b, (uint64_t)run << 1);
+            buf_le(b, v[i], value_bytes);
+            i += run;
+            continue;
+        }
+        int end = i;
+        while (end < n && (end == i || run_length(v, n, end) < 8)) end += 8;
+        if (end > n) end = n;
+        int groups = (end - i + 7) / 8;
+        buf_varint(b, (uint64_t)groups << 1 | 1);
+        uint8_t *p = buf_grow(b, (size_t)groups * (size_t)width);
+        if (!p) return;
+        memset(p, 0, (size_t)groups * (size_t)width);
+        uint64_t bit = 0;
+        for (int k = i; k < end; k++, bit += (uint64_t)width) {
+            for (int w = 0; w < width; w++) {
+                if ((v[k] >> w) & 1) p[(bit + (uint64_t)w) >> 3] |= (uint8_t)(1 << ((bit + (uint64_t)w) & 7));
+            }
+        }
+        i = end;
+    }
+}
+
+static int bit_width(uint32_t max) {
+    int w = 1;
+    while (w < 32 && (max >> w) != 0) w++;
+    return w;
+}
+
+/* =========================================================
+ * Column chunks
+ * ======================================================= */
+typedef struct
+{
+    ByteBuf bytes;           // pages, headers included
+    int type;                // PQ_*
+    bool text;               // BYTE_ARRAY holding UTF-8
+    bool dictionary;
+    int64_t dict_page_size;  // bytes of the dictionary page at the start
+    int64_t uncompressed;    // sizes the metadata reports
+    int64_t nulls;
+    bool has_range;
+    double min, max;         // numbers only
+    int64_t imin, imax;
+    bool failed;
+} Chunk;
+
+typedef struct
+{
+    const Table *table;
+    Chunk *chunks;
+    bool compress;
+    int dict_limit;
+} ParquetJob;
+
+// Page header and body, compressed if asked
+static void write_page(Chunk *c, ByteBuf *body, int page_type, int values, int encoding, bool compress) {
+    ByteBuf packed = {0};
+    const ByteBuf *data = body;
+    if (compress) {
+        uint8_t *p = buf_grow(&packed, lz4_block_bound(body->len));
+        if (p) packed.len = lz4_compress_block(body->data, body->len, p);
+        data = &packed;
+    }
+    Thrift t = {0};
+    th_i32(&t, 1, page_type);
+    th_i32(&t, 2, (int32_t)body->len);
+    th_i32(&t, 3, (int32_t)data->len);
+    if (page_type == PAGE_DATA) {
+        th_begin(&t, 5);
+        th_i32(&t, 1, values);
+        th_i32(&t, 2, encoding);
+        th_i32(&t, 3, ENC_RLE); // definition levels
+        th_i32(&t, 4, ENC_RLE); // repetition levels (none)
+        th_end(&t);
+    } else {
+        th_begin(&t, 7);
+        th_i32(&t, 1, values);
+        th_i32(&t, 2, ENC_PLAIN);
+        th_end(&t);
+    }
+    buf_le(&t.out, 0, 1);
+    if (t.out.failed || data->failed || body->failed) c->failed = true;
+    buf_append(&c->bytes, t.out.data, t.out.len);
+    buf_append(&c->bytes, data->data, data->len);
+    c->uncompressed += (int64_t)(t.out.len + body->len);
+    free(t.out.data);
+    free(packed.data);
+    body->len = 0;
+}
+
+static void put_text(ByteBuf *body, const char *s) {
+    size_t len = strlen(s);
+    buf_le(body, len, 4);
+    buf_append(body, s, len);
+}
+
+static void encode_chunk(int j, void *ctx) {
+    ParquetJob *job = ctx;
+    const Column *col = &job->table->columns[j];
+    Chunk *c = &job->chunks[j];
+    int rows = job->table->rows;
+    c->nulls = column_null_count(col);
+
+    switch (col->type) {
+        case TYPE_INT: c->type = PQ_INT64; break;
+        case TYPE_FLOAT: c->type = PQ_DOUBLE; break;
+        case TYPE_BOOL: c->type = PQ_BOOLEAN; break;
+        default: c->type = PQ_BYTE_ARRAY; break;
+    }
+
+    Dictionary dict = {0};
+    c->dictionary = col->type == TYPE_STRING && dictionary_build(col, job->dict_limit, &dict);
+    ByteBuf body = {0};
+    c->text = true;
+    if (c->dictionary) {
+        for (int k = 0; k < dict.count; k++) {
+            const char *s = dictionary_value(&dict, k);
+            c->text = c->text && is_utf8(s, strlen(s));
+            put_text(&body, s);
+        }
+        write_page(c, &body, PAGE_DICTIONARY, dict.count, ENC_PLAIN, job->compress);
+        c->dict_page_size = (int64_t)c->bytes.len;
+    }
+
+    uint32_t *levels = malloc((size_t)PARQUET_PAGE_ROWS * sizeof(uint32_t));
+    uint32_t *codes = malloc((size_t)PARQUET_PAGE_ROWS * sizeof(uint32_t));
+    if (!levels || !codes) c->failed = true;
+    int width = c->dictionary ? bit_width((uint32_t)(dict.count - 1)) : 0;
+
+    for (int start = 0; !c->failed && start < rows; start += PARQUET_PAGE_ROWS) {
+        int end = rows - start > PARQUET_PAGE_ROWS ? start + PARQUET_PAGE_ROWS : rows;
+        int present = 0;
+        for (int i = start; i < end; i++) {
+            levels[i - start] = column_is_valid(col, i);
+            present += (int)levels[i - start];
+        }
+        // Definition levels, prefixed with their length
+        size_t length_at = body.len;
+        buf_le(&body, 0, 4);
+        encode_hybrid(&body, levels, end - start, 1);
+        if (!body.failed) {
+            uint32_t n = (uint32_t)(body.len - length_at - 4);
+            for (int b = 0; b < 4; b++) body.data[length_at + b] = (uint8_t)(n >> (8 * b));
+        }
+
+        if (c->dictionary) {
+            int n = 0;
+            for (int i = start; i < end; i++) {
+                if (column_is_valid(col, i)) codes[n++] = (uint32_t)dict.codes[i];
+            }
+            buf_le(&body, (uint64_t)width, 1);
+            encode_hybrid(&body, codes, n, width);
+        } else if (col->type == TYPE_BOOL) {
+            uint8_t *bits = buf_grow(&body, ((size_t)present + 7) / 8);
+            if (bits) memset(bits, 0, ((size_t)present + 7) / 8);
+            for (int i = start, n = 0; bits && i < end; i++) {
+                if (column_is_valid(col, i)) {
+                    bits[n >> 3] |= (uint8_t)((col->bools[i] != 0) << (n & 7));
+                    n++;
+                }
+            }
+        } else {
+            for (int i = start; i < end; i++) {
+                if (!column_is_valid(col, i)) continue;
+                if (col->type == TYPE_INT) {
+                    int64_t v = col->ints[i];
+                    buf_le(&body, (uint64_t)v, 8);
+                    if (!c->has_range || v < c->imin) c->imin = v;
+                    if (!c->has_range || v > c->imax) c->imax = v;
+                    c->has_range = true;
+                } else if (col->type == TYPE_FLOAT) {
+                    double v = col->floats[i];
+                    uint64_t bitsv;
+                    memcpy(&bitsv, &v, sizeof(bitsv));
+                    buf_le(&body, bitsv, 8);
+                    if (isnan(v)) continue;
+                    if (!c->has_range || v < c->min) c->min = v;
+                    if (!c->has_range || v > c->max) c->max = v;
+                    c->has_range = true;
+                } else {
+                    const char *s = column_get_string(col, i);
+                    c->text = c->text && is_utf8(s, strlen(s));
+                    put_text(&body, s);
+                }
+            }
+        }
+        write_page(c, &body, PAGE_DATA, end - start, c->dictionary ? ENC_RLE_DICTIONARY : ENC_PLAIN, job->compress);
+    }
+    free(levels);
+    free(codes);
+    free(body.data);
+    dictionary_free(&dict);
+    if (c->bytes.failed) c->failed = true;
+}
+
+/* =========================================================
+ * File metadata
+ * ======================================================= */
+static void write_statistics(Thrift *t, const Chunk *c) {
+    th_begin(t, 12);
+    th_i64(t, 3, c->nulls);
+    if (c->has_range) {
+        uint8_t lo[8], hi[8];
+        uint64_t a, b;
+        if (c->type == PQ_INT64) {
+            a = (uint64_t)c->imin;
+            b = (uint64_t)c->imax;
+        } else {
+            // -0 and 0 compare equal, so widen the bounds to take both
+            double min = c->min == 0 ? -0.0 : c->min, max = c->max == 0 ? 0.0 : c->max;
+            memcpy(&a, &min, 8);
+            memcpy(&b, &max, 8);
+        }
+        for (int i = 0; i < 8; i++) {
+            lo[i] = (uint8_t)(a >> (8 * i));
+            hi[i] = (uint8_t)(b >> (8 * i));
+        }
+        th_binary(t, 5, hi, 8); // max_value
+        th_binary(t, 6, lo, 8); // min_value
+    }
+    th_end(t);
+}
+
+static void write_metadata(Thrift *t, const Table *table, const Chunk *chunks, const int64_t *offsets, bool compress) {
+    th_i32(t, 1, 1);
+
+    th_list(t, 2, T_STRUCT, (size_t)table->cols + 1);
+    th_begin(t, 0);
+    th_binary(t, 4, "schema", 6);
+    th_i32(t, 5, table->cols);
+    th_end(t);
+    for (int j = 0; j < table->cols; j++) {
+        const char *name = table->headers[j] ? table->headers[j] : "N/A";
+        th_begin(t, 0);
+        th_i32(t, 1, chunks[j].type);
+        th_i32(t, 3, OPTIONAL);
+        th_binary(t, 4, name, strlen(name));
+        if (chunks[j].type == PQ_BYTE_ARRAY && chunks[j].text) {
+            th_i32(t, 6, CONVERTED_UTF8);
+            th_begin(t, 10); // logicalType: STRING
+            th_begin(t, 1);
+            th_end(t);
+            th_end(t);
+        }
+        th_end(t);
+    }
+    th_i64(t, 3, table->rows);
+
+    int64_t total = 0;
+    for (int j = 0; j < table->cols; j++) total += chunks[j].uncompressed;
+    th_list(t, 4, T_STRUCT, 1);
+    th_begin(t, 0);
+    th_list(t, 1, T_STRUCT, (size_t)table->cols);
+    for (int j = 0; j < table->cols; j++) {
+        const Chunk *c = &chunks[j];
+        const char *name = table->headers[j] ? table->headers[j] : "N/A";
+        th_begin(t, 0);
+        th_i64(t, 2, offsets[j]);
+        th_begin(t, 3);
+        th_i32(t, 1, c->type);
+        th_list(t, 2, T_I32, c->dictionary ? 3 : 2);
+        buf_varint(&t->out, zigzag(ENC_PLAIN));
+        buf_varint(&t->out, zigzag(ENC_RLE));
+        if (c->dictionary) buf_varint(&t->out, zigzag(ENC_RLE_DICTIONARY));
+        th_list(t, 3, T_BINARY, 1);
+        th_binary_value(t, name, strlen(name));
+        th_i32(t, 4, compress ? CODEC_LZ4_RAW : CODEC_UNCOMPRESSED);
+        th_i64(t, 5, table->rows);
+        th_i64(t, 6, c->uncompressed);
+        th_i64(t, 7, (int64_t)c->bytes.len);
+        th_i64(t, 9, offsets[j] + c->dict_page_size);
+        if (c->dictionary) th_i64(t, 11, offsets[j]);
+        write_statistics(t, c);
+        th_end(t);
+        th_end(t);
+    }
+    th_i64(t, 2, total);
+    th_i64(t, 3, table->rows);
+    th_end(t);
+
+    th_binary(t, 6, "csv_tool", 8);
+    // Type-defined sort order for every column, which makes readers trust
+    // min_value/max_value
+    th_list(t, 7, T_STRUCT, (size_t)table->cols);
+    for (int j = 0; j < table->cols; j++) {
+        th_begin(t, 0);
+        th_begin(t, 1);
+        th_end(t);
+        th_end(t);
+    }
+    buf_le(&t->out, 0, 1);
+}
+
+bool parquet_write_table(const Table *table, FILE *fp) {
+    int cols = table->cols;
+    ParquetJob job = {table, calloc(cols > 0 ? cols : 1, sizeof(Chunk)),
+                      get_export_compression(), get_dictionary_limit()};
+    int64_t *offsets = malloc(((size_t)cols + 1) * sizeof(int64_t));
+    bool ok = job.chunks && offsets;
+    if (ok) parallel_for(cols, encode_chunk, &job);
+
+    ok = ok && fwrite(PARQUET_MAGIC, 1, 4, fp) == 4;
+    int64_t pos = 4;
+    for (int j = 0; ok && j < cols; j++) {
+        const Chunk *c = &job.chunks[j];
+        offsets[j] = pos;
+        ok = !c->failed && (c->bytes.len == 0 || fwrite(c->bytes.data, 1, c->bytes.len, fp) == c->bytes.len);
+        pos += (int64_t)c->bytes.len;
+    }
+
+    Thrift t = {0};
+    if (ok) {
+        write_metadata(&t, table, job.chunks, offsets, job.compress);
+        uint8_t length[4];
+        for (int i = 0; i < 4; i++) length[i] = (uint8_t)(t.out.len >> (8 * i));
+        ok = !t.out.failed && fwrite(t.out.data, 1, t.out.len, fp) == t.out.len &&
+             fwrite(length, 1, 4, fp) == 4 && fwrite(PARQUET_MAGIC, 1, 4, fp) == 4;
+    }
+    free(t.out.data);
+    for (int j = 0; job.chunks && j < cols; j++) free(job.chunks[j].bytes.data);
+    free(job.chunks);
+    free(offsets);
+    return ok;
+}
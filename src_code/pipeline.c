@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pipeline.h"
+#include "snapshot.h"
+#include "plan.h"
+
+#define MAX_STEP_TOKENS 64
+
+/* =========================================================
+ * Parsing
+ * ======================================================= */
+// Length of the step separator at s, 0 if there is none
+static size_t step_break(const char *s) {
+    if (*s == ';' || *s == '|' || *s == '\n') return 1;
+    if (s[0] == '-' && s[1] == '>') return 2;
+    if ((unsigned char)s[0] == 0xe2 && (unsigned char)s[1] == 0x86 && (unsigned char)s[2] == 0x92) return 3; // →
+    return 0;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '(' || c == ')';
+}
+
+static bool parse_number(const char *text, double *out) {
+    char *end;
+    *out = strtod(text, &end);
+    return end != text && *end == '\0';
+}
+
+static bool add_step(Pipeline *p, char **tok, int n) {
+    int number = p->count + 1;
+    if (p->count == MAX_PIPELINE_STEPS) {
+        printf("Pipeline: more than %d steps.\n", MAX_PIPELINE_STEPS);
+        return false;
+    }
+    PipelineStep step = {0};
+    const char *name = tok[0];
+    int args = n - 1;
+    bool ok;
+    if (strcmp(name, "load") == 0) {
+        step.kind = STEP_LOAD;
+        step.text = tok[1];
+        ok = args == 1;
+    } else if (strcmp(name, "fill_na") == 0) {
+        step.kind = STEP_FILL_NA;
+        step.column = tok[1];
+        step.text = tok[2];
+        ok = args == 2;
+    } else if (strcmp(name, "drop_na") == 0) {
+        step.kind = STEP_DROP_NA;
+        step.column = args == 1 ? tok[1] : NULL;
+        ok = args <= 1;
+    } else if (strcmp(name, "keep") == 0) {
+        step.kind = STEP_KEEP;
+        step.column = tok[1];
+        step.text = tok[2];
+        ok = args == 2;
+    } else if (strcmp(name, "scale_to_range") == 0 || strcmp(name, "scale") == 0) {
+        step.kind = STEP_SCALE;
+        step.column = tok[1];
+        ok = args == 3 && parse_number(tok[2], &step.a) && parse_number(tok[3], &step.b);
+    } else if (strcmp(name, "bucket_col") == 0 || strcmp(name, "bucket") == 0) {
+        step.kind = STEP_BUCKET;
+        step.column = tok[1];
+        ok = args == 2 && parse_number(tok[2], &step.a) && step.a >= 1 && step.a <= 1e6;
+        step.buckets = (int)step.a;
+    } else if (strcmp(name, "export") == 0) {
+        step.kind = STEP_EXPORT;
+        step.text = tok[1];
+        step.column = args > 1 ? tok[2] : NULL;
+        step.ncolumns = args - 1;
+        ok = args >= 1;
+    } else {
+        printf("Pipeline step %d: unknown step '%s'.\n", number, name);
+        return false;
+    }
+    if (!ok) {
+        printf("Pipeline step %d: wrong arguments for %s.\n", number, name);
+        return false;
+    }
+    if ((step.kind == STEP_LOAD) != (p->count == 0)) {
+        printf("Pipeline step %d: a pipeline starts with one load step.\n", number);
+        return false;
+    }
+    p->steps[p->count++] = step;
+    return true;
+}
+
+bool pipeline_parse(Pipeline *p, const char *spec) {
+    memset(p, 0, sizeof(*p));
+    // Tokens are copied with a terminator in place of the separator after
+    // them, so only the last one can need a byte more than the spec
+    p->buffer = malloc(strlen(spec) + 2);
+    if (!p->buffer) return false;
+    char *out = p->buffer;
+    char *tok[MAX_STEP_TOKENS];
+    int n = 0;
+    const char *s = spec;
+    for (;;) {
+        while (is_space(*s)) s++;
+        if (*s == '#') {
+            while (*s && *s != '\n') s++;
+            continue;
+        }
+        size_t brk = step_break(s);
+        if (*s == '\0' || brk) {
+            if (n > 0 && !add_step(p, tok, n)) break;
+            n = 0;
+            if (*s == '\0') {
+                if (p->count > 0) return true;
+                printf("Pipeline: no steps given.\n");
+                break;
+            }
+            s += brk;
+            continue;
+        }
+        if (n == MAX_STEP_TOKENS) {
+            printf("Pipeline step %d: too many arguments.\n", p->count + 1);
+            break;
+        }
+        tok[n++] = out;
+        if (*s == '"' || *s == '\'') {
+            char quote = *s++;
+            while (*s && *s != quote) *out++ = *s++;
+            if (*s == '\0') {
+                printf("Pipeline step %d: unterminated quote.\n", p->count + 1);
+                break;
+            }
+            s++;
+        } else {
+            while (*s && !is_space(*s) && *s != '#' && !step_break(s)) *out++ = *s++;
+        }
+        *out++ = '\0';
+    }
+    pipeline_free(p);
+    return false;
+}
+
+bool pipeline_parse_file(Pipeline *p, const char *path) {
+    memset(p, 0, sizeof(*p));
+    FILE *fp = open_data_file(path, "rb");
+    if (!fp) {
+        printf("Pipeline: cannot open '%s'.\n", path);
+        return false;
+    }
+    size_t cap = 4096, len = 0, n;
+    char *spec = malloc(cap);
+    while (spec && (n = fread(spec + len, 1, cap - len - 1, fp)) > 0) {
+        len += n;
+        if (len + 1 == cap) {
+            char *bigger = realloc(spec, cap * 2);
+            if (!bigger) {
+                free(spec);
+                spec = NULL;
+                break;
+            }
+            spec = bigger;
+            cap *= 2;
+        }
+    }
+    fclose(fp);
+    if (!spec) return false;
+    spec[len] = '\0';
+    bool ok = pipeline_parse(p, spec);
+    free(spec);
+    return ok;
+}
+
+void pipeline_free(Pipeline *p) {
+    free(p->buffer);
+    memset(p, 0, sizeof(*p));
+}
+
+/* =========================================================
+ * Running
+ * ======================================================= */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// A column given by header name, or else by index
+static int resolve_column(const Table *table, const char *text) {
+    int col = get_column_index(table, text);
+    if (col >= 0) return col;
+    char *end;
+    long index = strtol(text, &end, 10);
+    if (end != text && *end == '\0' && index >= 0 && index < table->cols) return (int)index;
+    printf("Pipeline: no column '%s'.\n", text);
+    return -1;
+}
+
+static bool load_table(Table *table, const char *path) {
+    if (is_snapshot(path)) return snapshot_load(table, path, NULL);
+    return load_csv(table, path);
+}
+
+// Record a step; `cols` holds its resolved columns
+static bool record_step(Plan *plan, const PipelineStep *step, const int *cols) {
+    switch (step->kind) {
+        case STEP_FILL_NA: return plan_fill_na(plan, cols[0], step->text);
+        case STEP_DROP_NA: return plan_drop_na(plan, step->column ? cols[0] : -1);
+        case STEP_KEEP: return plan_keep(plan, cols[0], step->text);
+        case STEP_SCALE: return plan_scale(plan, cols[0], step->a, step->b);
+        case STEP_BUCKET: return plan_bucket(plan, cols[0], step->buckets);
+        case STEP_EXPORT: return plan_export(plan, step->text, cols, step->ncolumns);
+        case STEP_LOAD: break;
+    }
+    return false;
+}
+
+// Resolve the columns of every step after the load and record it. Export
+// column names follow one another in the tokenized spec.
+static bool build_plan(Plan *plan, const Pipeline *p, int *cols) {
+    for (int i = 1; i < p->count; i++) {
+        const PipelineStep *step = &p->steps[i];
+        int n = step->kind == STEP_EXPORT ? step->ncolumns : step->column != NULL;
+        const char *name = step->column;
+        for (int k = 0; k < n; k++, name += strlen(name) + 1) {
+            cols[k] = resolve_column(plan->table, name);
+            if (cols[k] < 0) return false;
+        }
+        if (!record_step(plan, step, cols)) return false;
+        cols += n;
+    }
+    return true;
+}
+
+bool pipeline_run(const Pipeline *p) {
+    Table table = {0};
+    Plan *plan = malloc(sizeof(Plan));
+    int *cols = malloc(MAX_PIPELINE_STEPS * MAX_STEP_TOKENS * sizeof(int));
+    if (!plan || !cols) {
+        free(plan);
+        free(cols);
+        return false;
+    }
+    double start = now_ms();
+    bool ok = load_table(&table, p->steps[0].text);
+    double load_ms = now_ms() - start;
+    int loaded = table.rows;
+    if (!ok) printf("Pipeline: load failed.\n");
+
+    // Columns may be named, so the plan is made once the table is loaded
+    plan_init(plan, &table);
+    if (ok) ok = build_plan(plan, p, cols);
+    if (ok) ok = plan_run(plan);
+    double total = now_ms() - start;
+
+    printf("\n%-5s %-16s %5s %10s %10s %10s\n", "#", "Action", "Steps", "Rows in", "Rows out", "ms");
+    printf("%-5d %-16s %5d %10d %10d %10.1f\n", 1, "load", 1, 0, loaded, load_ms);
+    for (int i = 0; i < plan->nactions; i++) {
+        const PlanAction *a = &plan->actions[i];
+        printf("%-5d %-16s %5d %10d %10d %10.1f\n", i + 2, a->name, a->ops, a->rows_in, a->rows_out, a->ms);
+    }
+    printf("%-5s %-16s %5d %10s %10d %10.1f\n", "", "total", p->count, "", table.rows, total);
+    free_table(&table);
+    free(cols);
+    free(plan);
+    return ok;
+}
@@ -0,0 +1,499 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "plan.h"
+#include "filter.h"
+#include "impute.h"
+#include "export.h"
+#include "threadpool.h"
+#include "statcache.h"
+
+/* =========================================================
+ * Recording
+ * ======================================================= */
+void plan_init(Plan *plan, Table *table) {
+    memset(plan, 0, sizeof(*plan));
+    plan->table = table;
+}
+
+static bool record(Plan *plan, PlanOp op) {
+    int cols = plan->table->cols;
+    if (plan->count == MAX_PLAN_OPS) {
+        printf("Plan: more than %d steps.\n", MAX_PLAN_OPS);
+        return false;
+    }
+    bool ok = op.col < cols && (op.col >= 0 || op.kind == OP_DROP_NA || op.kind == OP_EXPORT);
+    for (int i = 0; i < op.ncolumns; i++) {
+        if (op.columns[i] < 0 || op.columns[i] >= cols) ok = false;
+    }
+    if (!ok) {
+        printf("Plan step %d: invalid column.\n", plan->count + 1);
+        return false;
+    }
+    plan->ops[plan->count++] = op;
+    return true;
+}
+
+bool plan_fill_na(Plan *plan, int col, const char *method) {
+    const char *value;
+    if (impute_method(method, &value) == IMPUTE_INVALID) {
+        printf("Plan step %d: invalid fill option '%s'.\n", plan->count + 1, method);
+        return false;
+    }
+    return record(plan, (PlanOp){.kind = OP_FILL_NA, .col = col, .text = method});
+}
+
+bool plan_drop_na(Plan *plan, int col) {
+    return record(plan, (PlanOp){.kind = OP_DROP_NA, .col = col < 0 ? -1 : col});
+}
+
+bool plan_keep(Plan *plan, int col, const char *value) {
+    return record(plan, (PlanOp){.kind = OP_KEEP, .col = col, .text = value});
+}
+
+bool plan_scale(Plan *plan, int col, double a, double b) {
+    return record(plan, (PlanOp){.kind = OP_SCALE, .col = col, .a = a, .b = b});
+}
+
+bool plan_bucket(Plan *plan, int col, int buckets) {
+    return record(plan, (PlanOp){.kind = OP_BUCKET, .col = col, .buckets = buckets});
+}
+
+bool plan_export(Plan *plan, const char *filename, const int *columns, int ncolumns) {
+    PlanOp op = {.kind = OP_EXPORT, .col = -1, .text = filename};
+    if (ncolumns > 0) {
+        op.columns = columns;
+        op.ncolumns = ncolumns;
+    }
+    return record(plan, op);
+}
+
+/* =========================================================
+ * Optimizing
+ * ======================================================= */
+static void set_live(bool *live, bool *used, int col) {
+    live[col] = true;
+    used[col] = true;
+}
+
+// Walk the steps backwards from the exports. A transform or fill is dead
+// when its column is not read again before an export writes it; a filter
+// is dead when no export follows. used[] ends up set for every column an
+// export or a live step reads.
+static int mark_dead(Plan *plan, bool *live, bool *used) {
+    int cols = plan->table->cols, dead = 0;
+    bool exported = false;
+    for (int i = plan->count - 1; i >= 0; i--) {
+        PlanOp *op = &plan->ops[i];
+        switch (op->kind) {
+            case OP_EXPORT:
+                for (int j = 0; j < (op->columns ? op->ncolumns : cols); j++) {
+                    set_live(live, used, op->columns ? op->columns[j] : j);
+                }
+                exported = true;
+                break;
+            case OP_DROP_NA:
+            case OP_KEEP:
+                op->dead = !exported;
+                if (op->dead) break;
+                for (int j = 0; j < (op->col < 0 ? cols : 1); j++) {
+                    set_live(live, used, op->col < 0 ? j : op->col);
+                }
+                break;
+            default:
+                op->dead = !live[op->col];
+                break;
+        }
+        if (op->dead) dead++;
+    }
+    return dead;
+}
+
+// Free the columns nothing reads and renumber the rest. index[j] is the
+// new position of column j, -1 once it is gone.
+static int drop_unused(Plan *plan, const bool *used, int *index) {
+    Table *table = plan->table;
+    int n = 0;
+    for (int j = 0; j < table->cols; j++) {
+        if (!used[j]) {
+            column_free(&table->columns[j]);
+            index[j] = -1;
+            continue;
+        }
+        index[j] = n;
+        table->columns[n] = table->columns[j];
+        if (table->headers) table->headers[n] = table->headers[j];
+        n++;
+    }
+    int dropped = table->cols - n;
+    table->cols = n;
+    for (int i = 0; i < plan->count; i++) {
+        PlanOp *op = &plan->ops[i];
+        if (!op->dead && op->col >= 0) op->col = index[op->col];
+    }
+    return dropped;
+}
+
+/* =========================================================
+ * Running
+ * ======================================================= */
+// Scale/bucket steps of one column that have not touched its data yet.
+// maps[k] (or the bucket range, for a final bucket) is known once the
+// range step k looks at has been measured.
+typedef struct
+{
+    int length, resolved;
+    const PlanOp *ops[MAX_PLAN_CHAIN];
+    Rescale maps[MAX_PLAN_CHAIN];
+    double lo, hi;     // range of a final bucket step
+    double vmin, vmax; // last measured range of the column's own values
+    bool found;
+} Chain;
+
+typedef struct
+{
+    Plan *plan;
+    Table *table;
+    const int *index; // original column -> current column
+    Chain *chains;    // one per column
+    int *work;        // column list scratch, one entry per column
+    uint64_t *mask;   // rows the filters so far keep, NULL for every row
+    bool ok;
+} Run;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void log_action(Run *run, const char *name, int ops, int rows_in, int rows_out, double start) {
+    Plan *plan = run->plan;
+    if (plan->nactions == MAX_PLAN_ACTIONS) return;
+    plan->actions[plan->nactions++] = (PlanAction){name, ops, rows_in, rows_out, now_ms() - start};
+}
+
+static void fail(Run *run, const char *what, int col) {
+    const char *name = run->table->headers ? run->table->headers[col] : NULL;
+    printf("Plan: %s failed for column %s.\n", what, name ? name : "?");
+    run->ok = false;
+}
+
+static int selected_rows(const Run *run) {
+    return run->mask ? bitmap_count(run->mask, run->table->rows) : run->table->rows;
+}
+
+static void measure_task(int i, void *ctx) {
+    Run *run = ctx;
+    int col = run->work[i];
+    Chain *chain = &run->chains[col];
+    chain->found = numeric_range(&run->table->columns[col], run->mask, &chain->vmin, &chain->vmax);
+}
+
+// Each held-back step needs the range of its input over the rows kept at
+// that point. The maps before it are monotone, so that is the column's own
+// range pushed through them.
+static void resolve_chain(Chain *chain) {
+    for (int k = chain->resolved; k < chain->length; k++) {
+        const PlanOp *op = chain->ops[k];
+        double lo = chain->vmin, hi = chain->vmax;
+        rescaled_range(chain->maps, k, &lo, &hi);
+        if (op->kind == OP_SCALE) {
+            chain->maps[k] = rescale_for(op->a, op->b, lo, hi);
+        } else {
+            if (fabs(hi - lo) < 1e-12) hi = lo + 1.0;
+            chain->lo = lo;
+            chain->hi = hi;
+        }
+    }
+    chain->resolved = chain->length;
+}
+
+// Find the ranges the waiting steps need, one scan per column and all
+// columns at once. Must run before the kept rows change.
+static void measure(Run *run) {
+    int n = 0;
+    for (int j = 0; j < run->table->cols; j++) {
+        if (run->chains[j].resolved < run->chains[j].length) run->work[n++] = j;
+    }
+    if (n == 0) return;
+    double start = now_ms();
+    parallel_for(n, measure_task, run);
+    for (int i = 0; i < n && run->ok; i++) {
+        Chain *chain = &run->chains[run->work[i]];
+        if (!chain->found) {
+            const PlanOp *op = chain->ops[chain->resolved];
+            fail(run, op->kind == OP_SCALE ? "scale_to_range (no numeric data)" : "bucket_col (no numeric data)",
+                 run->work[i]);
+        }
+        resolve_chain(chain);
+    }
+    int rows = selected_rows(run);
+    log_action(run, "range scan", n, rows, rows, start);
+}
+
+// Remove the rows the filters rejected, once, from every column
+static void compact(Run *run) {
+    if (!run->mask) return;
+    int rows = run->table->rows;
+    double start = now_ms();
+    int removed = filter_rows_mask(run->table, run->mask);
+    free(run->mask);
+    run->mask = NULL;
+    if (removed > 0) log_action(run, "compact", 0, rows, rows - removed, start);
+}
+
+static void apply_task(int i, void *ctx) {
+    Run *run = ctx;
+    int j = run->work[i];
+    Chain *chain = &run->chains[j];
+    Column *col = &run->table->columns[j];
+    const PlanOp *last = chain->ops[chain->length - 1];
+    if (last->kind == OP_BUCKET) {
+        chain->found = bucket_numbers(col, chain->maps, chain->length - 1, chain->lo, chain->hi, last->buckets);
+    } else {
+        chain->found = rescale_numbers(col, chain->maps, chain->length);
+    }
+}
+
+// Bring the listed columns (every column when cols is NULL) up to date:
+// drop the filtered rows, then run each waiting chain as one pass over its
+// column, the columns side by side.
+static void settle(Run *run, const int *cols, int count) {
+    compact(run);
+    measure(run);
+    if (!run->ok) return;
+    int n = 0, steps = 0;
+    for (int i = 0; i < (cols ? count : run->table->cols); i++) {
+        int j = cols ? cols[i] : i;
+        if (run->chains[j].length == 0) continue;
+        steps += run->chains[j].length;
+        run->work[n++] = j;
+    }
+    if (n == 0) return;
+    double start = now_ms();
+    parallel_for(n, apply_task, run);
+    for (int i = 0; i < n; i++) {
+        Chain *chain = &run->chains[run->work[i]];
+        if (!chain->found && run->ok) fail(run, "scale/bucket", run->work[i]);
+        chain->length = chain->resolved = 0;
+    }
+    log_action(run, "scale/bucket", steps, run->table->rows, run->table->rows, start);
+}
+
+static bool listed(const int *cols, int n, int col) {
+    for (int i = 0; i < n; i++) {
+        if (cols[i] == col) return true;
+    }
+    return false;
+}
+
+// Consecutive fills of different columns, run as one parallel stage
+static int run_fills(Run *run, int first) {
+    Plan *plan = run->plan;
+    ImputeSpec specs[MAX_PLAN_OPS];
+    int cols[MAX_PLAN_OPS];
+    int n = 0, i;
+    for (i = first; i < plan->count; i++) {
+        const PlanOp *op = &plan->ops[i];
+        if (op->dead) continue;
+        if (op->kind != OP_FILL_NA || listed(cols, n, op->col)) break;
+        cols[n] = op->col;
+        specs[n] = (ImputeSpec){.col = op->col};
+        specs[n].method = impute_method(op->text, &specs[n].value);
+        n++;
+    }
+    // Fills read whole columns, so they wait for the filters and for the
+    // transforms of the columns they fill
+    settle(run, cols, n);
+    if (!run->ok) return i;
+    int rows = run->table->rows;
+    double start = now_ms();
+    run->ok = impute_columns(run->table, specs, n);
+    for (int k = 0; k < n; k++) {
+        if (specs[k].error) {
+            const char *name = run->table->headers ? run->table->headers[specs[k].col] : NULL;
+            printf("Column %s: %s\n", name ? name : "?", specs[k].error);
+        }
+    }
+    log_action(run, "fill_na", n, rows, rows, start);
+    return i;
+}
+
+// Consecutive drop_na/keep steps: each only narrows the keep-mask, which
+// is applied when something needs the rows gone
+static int run_filters(Run *run, int first) {
+    Plan *plan = run->plan;
+    int cols[MAX_PLAN_OPS];
+    int n = 0, steps = 0, i;
+    for (i = first; i < plan->count; i++) {
+        const PlanOp *op = &plan->ops[i];
+        if (op->dead) continue;
+        if (op->kind != OP_DROP_NA && op->kind != OP_KEEP) break;
+        steps++;
+        // Nulls stay nulls through scaling and bucketing, but keep compares
+        // values, so it needs them transformed
+        if (op->kind == OP_KEEP && run->chains[op->col].length > 0 && !listed(cols, n, op->col)) {
+            cols[n++] = op->col;
+        }
+    }
+    measure(run);
+    if (n > 0) settle(run, cols, n);
+    if (!run->ok) return i;
+
+    int rows = selected_rows(run);
+    double start = now_ms();
+    if (!run->mask) run->mask = filter_mask_all(run->table->rows);
+    if (!run->mask) {
+        printf("Plan: out of memory.\n");
+        run->ok = false;
+        return i;
+    }
+    for (int k = first; k < i; k++) {
+        const PlanOp *op = &plan->ops[k];
+        if (op->dead) continue;
+        if (op->kind == OP_DROP_NA) filter_mask_nulls(run->table, op->col, run->mask);
+        else filter_mask_equals(run->table, op->col, op->text, run->mask);
+    }
+    log_action(run, "filter", steps, rows, selected_rows(run), start);
+    return i;
+}
+
+static bool can_defer(const Run *run, const PlanOp *op) {
+    const Chain *chain = &run->chains[op->col];
+    if (!column_is_numeric(&run->table->columns[op->col]) || chain->length == MAX_PLAN_CHAIN) return false;
+    // Bucket labels are text, so nothing can follow a bucket in a chain
+    if (chain->length > 0 && chain->ops[chain->length - 1]->kind == OP_BUCKET) return false;
+    if (op->kind == OP_SCALE) return fabs(op->a - op->b) >= 1e-12;
+    return op->buckets >= 1;
+}
+
+// Hold a scale/bucket step back when its column can take it as a map;
+// otherwise (strings, errors) run it as the menus would
+static void run_transform(Run *run, const PlanOp *op) {
+    if (can_defer(run, op)) {
+        Chain *chain = &run->chains[op->col];
+        chain->ops[chain->length++] = op;
+        return;
+    }
+    settle(run, &op->col, 1);
+    if (!run->ok) return;
+    int rows = run->table->rows;
+    double start = now_ms();
+    if (op->kind == OP_SCALE) {
+        run->ok = scale_to_range(run->table, op->col, op->a, op->b, 1);
+        log_action(run, "scale_to_range", 1, rows, rows, start);
+    } else {
+        run->ok = bucket_col(run->table, op->col, op->buckets, 1);
+        log_action(run, "bucket_col", 1, rows, rows, start);
+    }
+}
+
+static void run_export(Run *run, const PlanOp *op) {
+    // Only the exported columns need their transforms now
+    int n = 0;
+    for (int i = 0; i < op->ncolumns; i++) {
+        int j = run->index[op->columns[i]];
+        if (!listed(run->work, n, j)) run->work[n++] = j;
+    }
+    int *cols = op->columns ? malloc((size_t)n * sizeof(int)) : NULL;
+    if (op->columns && !cols) {
+        printf("Plan: out of memory.\n");
+        run->ok = false;
+        return;
+    }
+    if (cols) memcpy(cols, run->work, (size_t)n * sizeof(int));
+    settle(run, cols, n);
+    free(cols);
+    if (!run->ok) return;
+
+    Table view = *run->table;
+    view.stats = NULL; // the cache indexes the whole table
+    int rows = view.rows;
+    double start = now_ms();
+    if (op->columns) {
+        // A view of the listed columns, in the order given
+        view.cols = op->ncolumns;
+        view.columns = malloc((size_t)view.cols * sizeof(Column));
+        view.headers = run->table->headers ? malloc((size_t)view.cols * sizeof(char *)) : NULL;
+        if (!view.columns || (run->table->headers && !view.headers)) {
+            free(view.columns);
+            free(view.headers);
+            printf("Plan: out of memory.\n");
+            run->ok = false;
+            return;
+        }
+        for (int i = 0; i < view.cols; i++) {
+            int j = run->index[op->columns[i]];
+            view.columns[i] = run->table->columns[j];
+            if (view.headers) view.headers[i] = run->table->headers[j];
+        }
+    }
+    run->ok = export_cleaned_data(&view, op->text);
+    if (op->columns) {
+        free(view.columns);
+        free(view.headers);
+    }
+    log_action(run, "export", 1, rows, rows, start);
+}
+
+bool plan_run(Plan *plan) {
+    Table *table = plan->table;
+    int cols = table->cols;
+    bool *live = calloc((size_t)cols + 1, sizeof(bool));
+    bool *used = calloc((size_t)cols + 1, sizeof(bool));
+    int *index = malloc(((size_t)cols + 1) * sizeof(int));
+    int *work = malloc(((size_t)cols + 1) * sizeof(int));
+    Chain *chains = calloc((size_t)cols + 1, sizeof(Chain));
+    Run run = {plan, table, index, chains, work, NULL, true};
+    if (!live || !used || !index || !work || !chains) {
+        printf("Plan: out of memory.\n");
+        run.ok = false;
+    }
+
+    if (run.ok) {
+        double start = now_ms();
+        int dead = mark_dead(plan, live, used);
+        int dropped = drop_unused(plan, used, index);
+        printf("Plan: %d steps, %d skipped; %d of %d columns unused.\n", plan->count, dead, dropped, cols);
+        if (dead > 0 || dropped > 0) log_action(&run, "prune", dead, table->rows, table->rows, start);
+    }
+
+    for (int i = 0; run.ok && i < plan->count;) {
+        const PlanOp *op = &plan->ops[i];
+        if (op->dead) {
+            i++;
+            continue;
+        }
+        switch (op->kind) {
+            case OP_FILL_NA:
+                i = run_fills(&run, i);
+                break;
+            case OP_DROP_NA:
+            case OP_KEEP:
+                i = run_filters(&run, i);
+                break;
+            case OP_SCALE:
+            case OP_BUCKET:
+                run_transform(&run, op);
+                i++;
+                break;
+            case OP_EXPORT:
+                run_export(&run, op);
+                i++;
+                break;
+        }
+    }
+
+    // Fused passes rewrite columns behind the cache's back
+    table_stats_changed(table, -1);
+    free(run.mask);
+    free(chains);
+    free(work);
+    free(index);
+    free(used);
+    free(live);
+    return run.ok;
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <math.h>
+#include "fileio.h"
+#include "csvparse.h"
+#include "export.h"
+#include "stats.h"
+#include "profile.h"
+#include "infer.h"
+#include "numparse.h"
+#include "trace.h"
+
+// Running statistics of one column
+typedef struct
+{
+    char *name;
+    TypeTally tally; // gives the type the same way load_csv does
+    int64_t non_null;
+    int64_t nulls;
+    Moments moments; // of the numeric values
+    QuantileSketch sketch; // quartiles of the numeric values
+} ColumnProfile;
+
+typedef struct
+{
+    ColumnProfile *cols;
+    int ncols;
+    int64_t rows;    // data rows seen so far
+    char *scratch;   // NUL-terminated copy of the current field
+    size_t scratch_len;
+} Profiler;
+
+static bool add_number(ColumnProfile *p, double v) {
+    moments_add(&p->moments, v);
+    return sketch_add(&p->sketch, v);
+}
+
+// Fold one cell into the column. `text` is NUL-terminated, or NULL when
+// the row has no such field. Numbers are summarised whatever the type
+// turns out to be; if the column ends up numeric, its other cells are
+// strays that load_csv would read as N/A.
+static bool profile_value(ColumnProfile *p, const char *text, size_t len) {
+    if (!text || is_missing(text, len)) {
+        p->nulls++;
+        return true;
+    }
+    p->non_null++;
+    FieldType type = classify_field(text, len);
+    tally_add(&p->tally, type);
+
+    int64_t i;
+    double v;
+    if (type == TYPE_INT && parse_int64(text, len, &i)) return add_number(p, (double)i);
+    if (type == TYPE_FLOAT && parse_double(text, len, &v)) return add_number(p, v);
+    return true;
+}
+
+// Text of field j of a row, copied into the scratch buffer
+static const char *row_field(Profiler *prof, const CsvIndex *idx, const char *data,
+                             int64_t row, int j, size_t *len) {
+    if (j >= csv_row_fields(idx, row)) return NULL;
+    const FieldSpan *span = &idx->fields[idx->row_start[row] + j];
+    *len = csv_span_decode(data, span, prof->scratch);
+    prof->scratch[*len] = '\0';
+    return prof->scratch;
+}
+
+static bool read_header(Profiler *prof, const CsvIndex *idx, const char *data) {
+    prof->ncols = (int)csv_row_fields(idx, 0);
+    prof->cols = calloc(prof->ncols, sizeof(ColumnProfile));
+    if (!prof->cols) return false;
+    for (int j = 0; j < prof->ncols; j++) {
+        size_t len = 0;
+        const char *text = row_field(prof, idx, data, 0, j, &len);
+        if (is_missing(text, len)) text = "N/A";
+        ColumnProfile *p = &prof->cols[j];
+        p->name = strdup(text);
+        if (!p->name) return false;
+        tally_init(&p->tally);
+        moments_init(&p->moments);
+        if (!sketch_init(&p->sketch, sketch_k_for_error(get_quantile_error()))) return false;
+    }
+    return true;
+}
+
+static bool profile_rows(Profiler *prof, const CsvIndex *idx, const char *data, int64_t rows) {
+    if (idx->max_length + (size_t)1 > prof->scratch_len) {
+        char *scratch = realloc(prof->scratch, idx->max_length + (size_t)1);
+        if (!scratch) return false;
+        prof->scratch = scratch;
+        prof->scratch_len = idx->max_length + (size_t)1;
+    }
+
+    int64_t r = 0;
+    if (!prof->cols && rows > 0) {
+        if (!read_header(prof, idx, data)) return false;
+        r = 1;
+    }
+    for (; r < rows; r++) {
+        for (int j = 0; j < prof->ncols; j++) {
+            size_t len = 0;
+            const char *text = row_field(prof, idx, data, r, j, &len);
+            if (!profile_value(&prof->cols[j], text, len)) return false;
+        }
+        prof->rows++;
+    }
+    return true;
+}
+
+// First byte of row r; plain quoted fields point past their opening quote
+static size_t row_offset(const CsvIndex *idx, const char *data, int64_t r) {
+    size_t offset = (size_t)idx->fields[idx->row_start[r]].offset;
+    if (offset > 0 && data[offset - 1] == '"') offset--;
+    return offset;
+}
+
+static bool write_profile(const Profiler *prof, const char *stats_path) {
+    FILE *fp = fopen(stats_path, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to export stats to %s\n", stats_path);
+        return false;
+    }
+
+    fprintf(fp, "Column,Non-NULL Count,Type,Min,Max,Mean,StdDev,Null Count,25%%,50%%,75%%\n");
+    const double levels[3] = {0.25, 0.50, 0.75};
+    for (int j = 0; j < prof->ncols; j++) {
+        const ColumnProfile *p = &prof->cols[j];
+        FieldType type = tally_type(&p->tally);
+        if (type == TYPE_INT || type == TYPE_FLOAT) {
+            const Moments *m = &p->moments;
+            double stddev = m->count ? moments_sd(m) : 0;
+            double q[3];
+            sketch_quantiles(&p->sketch, levels, q, 3);
+            fprintf(fp, "%s,%" PRId64 ",%s,%.2f,%.2f,%.2f,%.2f,%" PRId64 ",%.2f,%.2f,%.2f\n",
+                p->name, m->count, field_type_to_str(type),
+                m->min, m->max, m->mean, stddev, p->nulls + p->tally.others, q[0], q[1], q[2]);
+        } else {
+            fprintf(fp, "%s,%" PRId64 ",%s,,,,,%" PRId64 ",,,\n",
+                p->name, p->non_null, field_type_to_str(type), p->nulls);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+bool profile_csv_stream(const char *filename, const char *stats_path, size_t batch_bytes) {
+    FILE *in = open_data_file(filename, "rb");
+    if (!in) {
+        printf("Could not open %s\n", filename);
+        return false;
+    }
+
+    Profiler prof = {0};
+    size_t cap = batch_bytes > 0 ? batch_bytes : PROFILE_BATCH_BYTES;
+    size_t len = 0;
+    char *buf = malloc(cap);
+    bool ok = buf != NULL, eof = false;
+
+    while (ok && !eof) {
+        if (len == cap) {
+            // A single row fills the whole buffer
+            char *bigger = realloc(buf, cap * 2);
+            if (!bigger) {
+                ok = false;
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+        size_t got = fread(buf + len, 1, cap - len, in);
+        trace_add(TRACE_BYTES_READ, (int64_t)got);
+        len += got;
+        if (ferror(in)) {
+            ok = false;
+            break;
+        }
+        eof = feof(in);
+
+        CsvIndex idx;
+        if (!csv_index_build(&idx, buf, len, ',')) {
+            ok = false;
+            break;
+        }
+        // Unless this is the end of the input, the last row may continue
+        // in the next batch, so it is carried over and parsed again
+        int64_t rows = idx.row_count;
+        size_t keep = 0;
+        if (!eof && rows > 0) {
+            rows--;
+            keep = len - row_offset(&idx, buf, rows);
+        }
+        ok = profile_rows(&prof, &idx, buf, rows);
+        trace_add(TRACE_ROWS_PARSED, rows);
+        csv_index_free(&idx);
+
+        memmove(buf, buf + len - keep, keep);
+        len = keep;
+    }
+    fclose(in);
+
+    if (ok) ok = write_profile(&prof, stats_path);
+    if (ok) {
+        printf("Profiled %" PRId64 " rows, %d columns\n", prof.rows, prof.ncols);
+        printf("Stats exported to: %s\n", stats_path);
+    } else {
+        printf("Failed to profile %s\n", filename);
+    }
+
+    for (int j = 0; j < prof.ncols && prof.cols; j++) {
+        free(prof.cols[j].name);
+        sketch_free(&prof.cols[j].sketch);
+    }
+    free(prof.cols);
+    free(prof.scratch);
+    free(buf);
+    return ok;
+}
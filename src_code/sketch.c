@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sketch.h"
+
+#define SKETCH_DECAY (2.0 / 3.0) // each level below the top holds 2/3 as many items
+#define SKETCH_MIN_CAPACITY 2
+#define SKETCH_RNG_SEED 0x9E3779B97F4A7C15ull
+
+typedef struct
+{
+    double value;
+    int64_t weight;
+} WeightedValue;
+
+static int cmp_values(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_weighted(const void *a, const void *b) {
+    return cmp_values(&((const WeightedValue *)a)->value, &((const WeightedValue *)b)->value);
+}
+
+// Deterministic, so repeated runs give the same answers
+static uint64_t next_random(QuantileSketch *s) {
+    s->rng ^= s->rng << 13;
+    s->rng ^= s->rng >> 7;
+    s->rng ^= s->rng << 17;
+    return s->rng;
+}
+
+static int level_capacity(const QuantileSketch *s, int h) {
+    int cap = (int)ceil(s->k * pow(SKETCH_DECAY, s->levels - 1 - h));
+    return cap < SKETCH_MIN_CAPACITY ? SKETCH_MIN_CAPACITY : cap;
+}
+
+static bool add_level(QuantileSketch *s) {
+    int levels = s->levels + 1;
+    double **items = realloc(s->items, levels * sizeof(double *));
+    if (!items) return false;
+    s->items = items;
+    int *sizes = realloc(s->sizes, levels * sizeof(int));
+    if (!sizes) return false;
+    s->sizes = sizes;
+    int *caps = realloc(s->caps, levels * sizeof(int));
+    if (!caps) return false;
+    s->caps = caps;
+
+    s->items[s->levels] = NULL;
+    s->sizes[s->levels] = 0;
+    s->caps[s->levels] = 0;
+    s->levels = levels;
+
+    // Lower levels shrink as the sketch grows taller
+    s->max_size = 0;
+    for (int h = 0; h < s->levels; h++) s->max_size += level_capacity(s, h);
+    return true;
+}
+
+static bool push_item(QuantileSketch *s, int h, double value) {
+    if (s->sizes[h] == s->caps[h]) {
+        int cap = s->caps[h] ? s->caps[h] * 2 : (s->k > 0 ? s->k : 64);
+        double *items = realloc(s->items[h], cap * sizeof(double));
+        if (!items) return false;
+        s->items[h] = items;
+        s->caps[h] = cap;
+    }
+    s->items[h][s->sizes[h]++] = value;
+    s->size++;
+    return true;
+}
+
+// Sort level h and promote one item of every adjacent pair to level h + 1.
+// With an odd count the smallest item stays behind.
+static bool compact_level(QuantileSketch *s, int h) {
+    if (h + 1 == s->levels && !add_level(s)) return false;
+    double *items = s->items[h];
+    int size = s->sizes[h];
+    qsort(items, size, sizeof(double), cmp_values);
+
+    int keep = size % 2;
+    int offset = (int)(next_random(s) & 1);
+    for (int i = keep; i + 1 < size; i += 2) {
+        if (!push_item(s, h + 1, items[i + offset])) return false;
+    }
+    s->size -= size - keep;
+    s->sizes[h] = keep;
+    return true;
+}
+
+// Compact the lowest full level until the sketch fits its capacity again
+static bool compress(QuantileSketch *s) {
+    while (s->size >= s->max_size) {
+        int h = 0;
+        while (s->sizes[h] < level_capacity(s, h)) h++;
+        if (!compact_level(s, h)) return false;
+    }
+    return true;
+}
+
+bool sketch_init(QuantileSketch *s, int k) {
+    memset(s, 0, sizeof(*s));
+    s->k = k > 0 ? k : 0;
+    s->rng = SKETCH_RNG_SEED;
+    return add_level(s);
+}
+
+void sketch_free(QuantileSketch *s) {
+    for (int h = 0; h < s->levels; h++) free(s->items[h]);
+    free(s->items);
+    free(s->sizes);
+    free(s->caps);
+    memset(s, 0, sizeof(*s));
+}
+
+bool sketch_add(QuantileSketch *s, double value) {
+    if (!push_item(s, 0, value)) return false;
+    s->n++;
+    return s->k == 0 || compress(s);
+}
+
+bool sketch_merge(QuantileSketch *dst, const QuantileSketch *src) {
+    while (dst->levels < src->levels) {
+        if (!add_level(dst)) return false;
+    }
+    for (int h = 0; h < src->levels; h++) {
+        for (int i = 0; i < src->sizes[h]; i++) {
+            if (!push_item(dst, h, src->items[h][i])) return false;
+        }
+    }
+    dst->n += src->n;
+    return dst->k == 0 || compress(dst);
+}
+
+// Retained values with their weights, sorted by value
+static WeightedValue *sorted_items(const QuantileSketch *s, int *count) {
+    *count = s->size;
+    WeightedValue *all = malloc((*count > 0 ? *count : 1) * sizeof(WeightedValue));
+    if (!all) return NULL;
+    int n = 0;
+    for (int h = 0; h < s->levels; h++) {
+        for (int i = 0; i < s->sizes[h]; i++) {
+            all[n].value = s->items[h][i];
+            all[n].weight = (int64_t)1 << h;
+            n++;
+        }
+    }
+    qsort(all, n, sizeof(WeightedValue), cmp_weighted);
+    return all;
+}
+
+static double rank_in(const WeightedValue *all, int count, int64_t rank) {
+    int64_t seen = 0;
+    for (int i = 0; i < count; i++) {
+        seen += all[i].weight;
+        if (seen > rank) return all[i].value;
+    }
+    return all[count - 1].value;
+}
+
+double sketch_value_at(const QuantileSketch *s, int64_t rank) {
+    if (s->n == 0) return NAN;
+    int count;
+    WeightedValue *all = sorted_items(s, &count);
+    if (!all) return NAN;
+    double v = rank_in(all, count, rank);
+    free(all);
+    return v;
+}
+
+double sketch_quantile(const QuantileSketch *s, double q) {
+    return sketch_value_at(s, (int64_t)(q * (s->n - 1)));
+}
+
+void sketch_quantiles(const QuantileSketch *s, const double *qs, double *out, int count) {
+    int retained_count;
+    WeightedValue *all = s->n > 0 ? sorted_items(s, &retained_count) : NULL;
+    for (int i = 0; i < count; i++) {
+        out[i] = all ? rank_in(all, retained_count, (int64_t)(qs[i] * (s->n - 1))) : NAN;
+    }
+    free(all);
+}
+
+int sketch_k_for_error(double eps) {
+    if (eps <= 0) return 0;
+    int k = (int)ceil(2.0 / eps);
+    return k < SKETCH_MIN_CAPACITY ? SKETCH_MIN_CAPACITY : k;
+}
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "snapshot.h"
+#include "dictionary.h"
+#include "trace.h"
+#include "statcache.h"
+
+#define SECTION_ALIGN 64
+#define BYTE_ORDER_MARK 0x01020304u
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; // BYTE_ORDER_MARK as written by this machine
+    int64_t rows;
+    int64_t cols;
+    int64_t file_size;
+} SnapshotHeader;
+
+// One per column, right after the header. Sections are given as offsets
+// from the start of the file; 0 means the section is absent.
+typedef struct
+{
+    int32_t type;
+    int32_t name_length;
+    int64_t name;
+    int64_t validity;
+    int64_t values;      // ints, floats or bools
+    int64_t offsets;     // string columns: one per row, or per value when encoded
+    int64_t codes;       // dictionary encoded columns
+    int64_t bytes;
+    int64_t bytes_length;
+    int64_t dict_count;  // values in the dictionary
+    // Stats as describe_column gives them
+    int32_t numeric;
+    int32_t count;
+    int32_t nulls;
+    int32_t reserved;
+    double mean, sd, min, max;
+} SnapshotColumn;
+
+static size_t value_size(FieldType type) {
+    switch (type) {
+        case TYPE_INT: return sizeof(int64_t);
+        case TYPE_FLOAT: return sizeof(double);
+        case TYPE_BOOL: return sizeof(uint8_t);
+        default: return 0;
+    }
+}
+
+static const void *value_data(const Column *col) {
+    switch (col->type) {
+        case TYPE_INT: return col->ints;
+        case TYPE_FLOAT: return col->floats;
+        case TYPE_BOOL: return col->bools;
+        default: return NULL;
+    }
+}
+
+static size_t offset_count(const SnapshotColumn *d, int64_t rows) {
+    return d->codes ? (size_t)d->dict_count : (size_t)rows;
+}
+
+// Room a section takes in the file. Column buffers end up in the table's
+// arena pools when a column is rewritten, so each one is padded to the
+// size of its pool class.
+static int64_t section_size(size_t bytes) {
+    return bytes == 0 ? 0 : (int64_t)arena_class_size(bytes);
+}
+
+static int64_t align_up(int64_t pos) {
+    return (pos + SECTION_ALIGN - 1) & ~(int64_t)(SECTION_ALIGN - 1);
+}
+
+// Assign file offsets to every section, in file order
+typedef struct
+{
+    int64_t pos;
+} Layout;
+
+static int64_t place(Layout *l, size_t bytes) {
+    if (bytes == 0) return 0;
+    int64_t at = align_up(l->pos);
+    l->pos = at + section_size(bytes);
+    return at;
+}
+
+static bool write_section(FILE *fp, int64_t *pos, int64_t at, const void *data, size_t bytes) {
+    static const char zeros[SECTION_ALIGN];
+    if (at == 0) return true;
+    for (; *pos < at; (*pos)++) {
+        if (fputc(0, fp) == EOF) return false;
+    }
+    if (bytes > 0 && fwrite(data, 1, bytes, fp) != bytes) return false;
+    *pos += bytes;
+    // Pool padding
+    for (int64_t pad = section_size(bytes) - (int64_t)bytes; pad > 0;) {
+        size_t n = pad < SECTION_ALIGN ? (size_t)pad : SECTION_ALIGN;
+        if (fwrite(zeros, 1, n, fp) != n) return false;
+        pad -= n;
+        *pos += n;
+    }
+    return true;
+}
+
+static bool write_snapshot(const Table *table, FILE *fp) {
+    const ColumnSummary *summary = table_summaries(table, 0);
+    SnapshotColumn *dir = calloc(table->cols > 0 ? table->cols : 1, sizeof(SnapshotColumn));
+    if ((!summary && table->cols > 0) || !dir) {
+        free(dir);
+        return false;
+    }
+
+    Layout layout = {sizeof(SnapshotHeader) + (int64_t)table->cols * sizeof(SnapshotColumn)};
+    size_t words = (size_t)(table->rows + 63) / 64;
+    for (int j = 0; j < table->cols; j++) {
+        const Column *col = &table->columns[j];
+        SnapshotColumn *d = &dir[j];
+        const char *name = table->headers[j] ? table->headers[j] : "N/A";
+        d->type = col->type;
+        d->name_length = (int32_t)strlen(name);
+        d->name = place(&layout, d->name_length + 1);
+        d->validity = place(&layout, words * sizeof(uint64_t));
+        if (col->type == TYPE_STRING || col->type == TYPE_NULL) {
+            if (col->codes) {
+                d->dict_count = col->dict_count;
+                d->codes = place(&layout, (size_t)table->rows * sizeof(uint16_t));
+            }
+            d->offsets = place(&layout, offset_count(d, table->rows) * sizeof(int64_t));
+            d->bytes_length = col->bytes_len;
+            d->bytes = place(&layout, (size_t)col->bytes_len);
+        } else {
+            d->values = place(&layout, (size_t)table->rows * value_size(col->type));
+        }
+        const ColumnSummary *s = &summary[j];
+        d->numeric = s->numeric;
+        d->count = s->count;
+        d->nulls = s->nulls;
+        d->mean = s->mean;
+        d->sd = s->sd;
+        d->min = s->min;
+        d->max = s->max;
+    }
+
+    SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, BYTE_ORDER_MARK,
+                             table->rows, table->cols, align_up(layout.pos)};
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              (table->cols == 0 || fwrite(dir, sizeof(SnapshotColumn), table->cols, fp) == (size_t)table->cols);
+    int64_t pos = sizeof(header) + (int64_t)table->cols * sizeof(SnapshotColumn);
+    for (int j = 0; ok && j < table->cols; j++) {
+        const Column *col = &table->columns[j];
+        const SnapshotColumn *d = &dir[j];
+        const char *name = table->headers[j] ? table->headers[j] : "N/A";
+        ok = write_section(fp, &pos, d->name, name, d->name_length + 1) &&
+             write_section(fp, &pos, d->validity, col->validity, words * sizeof(uint64_t)) &&
+             write_section(fp, &pos, d->values, value_data(col), (size_t)table->rows * value_size(col->type)) &&
+             write_section(fp, &pos, d->codes, col->codes, (size_t)table->rows * sizeof(uint16_t)) &&
+             write_section(fp, &pos, d->offsets, col->offsets, offset_count(d, table->rows) * sizeof(int64_t)) &&
+             write_section(fp, &pos, d->bytes, col->bytes, (size_t)col->bytes_len);
+    }
+    for (; ok && pos < header.file_size; pos++) ok = fputc(0, fp) != EOF;
+    free(dir);
+    return ok;
+}
+
+bool snapshot_save(const Table *table, const char *path) {
+    int scope = trace_begin("snapshot_save");
+    bool ok = write_table_file(table, path, "wb", write_snapshot, true);
+    trace_end(scope);
+    return ok;
+}
+
+bool is_snapshot(const char *path) {
+    FILE *fp = open_data_file(path, "rb");
+    if (!fp) return false;
+    char magic[8] = {0};
+    bool found = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                 memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+    fclose(fp);
+    return found;
+}
+
+// Section [at, at + bytes) lies inside the file, or is absent and empty
+static bool section_ok(const MappedFile *mf, int64_t at, size_t bytes) {
+    if (at == 0) return bytes == 0;
+    return at > 0 && at % SECTION_ALIGN == 0 && (uint64_t)at + (uint64_t)section_size(bytes) <= mf->size;
+}
+
+static bool check_column(const MappedFile *mf, const SnapshotHeader *h, const SnapshotColumn *d) {
+    size_t rows = (size_t)h->rows;
+    if (d->type < TYPE_STRING || d->type > TYPE_NULL || d->name_length < 0) return false;
+    if (!section_ok(mf, d->name, (size_t)d->name_length + 1) || mf->data[d->name + d->name_length] != '\0') {
+        return false;
+    }
+    if (!section_ok(mf, d->validity, (rows + 63) / 64 * sizeof(uint64_t))) return false;
+    if (d->type == TYPE_STRING || d->type == TYPE_NULL) {
+        bool encoded = d->codes != 0;
+        if (encoded && (d->dict_count <= 0 || d->dict_count > DICTIONARY_MAX_VALUES ||
+                        !section_ok(mf, d->codes, rows * sizeof(uint16_t)))) {
+            return false;
+        }
+        if (d->bytes_length < 0 || !section_ok(mf, d->offsets, offset_count(d, h->rows) * sizeof(int64_t)) ||
+            !section_ok(mf, d->bytes, (size_t)d->bytes_length)) {
+            return false;
+        }
+        // Every value must start inside the bytes, which end in a terminator,
+        // and every code must name a value. Null rows keep an offset too and
+        // compaction measures each row up to the next one's, so the whole
+        // array must rise and stay within the bytes.
+        const int64_t *offsets = (const int64_t *)(mf->data + d->offsets);
+        const uint16_t *codes = (const uint16_t *)(mf->data + d->codes);
+        const uint64_t *validity = (const uint64_t *)(mf->data + d->validity);
+        if (d->bytes_length > 0 && mf->data[d->bytes + d->bytes_length - 1] != '\0') return false;
+        size_t count = offset_count(d, h->rows);
+        for (size_t k = 0; k < count; k++) {
+            if (offsets[k] < (k > 0 ? offsets[k - 1] : 0) || offsets[k] > d->bytes_length) return false;
+        }
+        for (size_t k = 0; encoded && k < (size_t)d->dict_count; k++) {
+            if (offsets[k] >= d->bytes_length) return false;
+        }
+        for (size_t r = 0; r < rows; r++) {
+            bool valid = (validity[r >> 6] >> (r & 63)) & 1;
+            if (!valid) continue;
+            if (encoded ? codes[r] >= d->dict_count : offsets[r] >= d->bytes_length) return false;
+        }
+        return true;
+    }
+    return section_ok(mf, d->values, rows * value_size(d->type));
+}
+
+static bool open_snapshot(Table *table, const char *path, ColumnSummary **stats) {
+    memset(table, 0, sizeof(*table));
+    if (stats) *stats = NULL;
+    MappedFile *mf = malloc(sizeof(MappedFile));
+    if (!mf) return false;
+    if (!map_data_file(mf, path, true)) {
+        free(mf);
+        return false;
+    }
+    trace_add(TRACE_BYTES_READ, (int64_t)mf->size);
+
+    const SnapshotHeader *h = (const SnapshotHeader *)mf->data;
+    const SnapshotColumn *dir = (const SnapshotColumn *)(mf->data + sizeof(SnapshotHeader));
+    bool ok = mf->size >= sizeof(SnapshotHeader) && memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+              h->version == SNAPSHOT_VERSION && h->byte_order == BYTE_ORDER_MARK &&
+              h->rows >= 0 && h->rows <= INT32_MAX && h->cols >= 0 && h->cols <= INT32_MAX &&
+              (uint64_t)h->file_size == mf->size &&
+              sizeof(SnapshotHeader) + (uint64_t)h->cols * sizeof(SnapshotColumn) <= mf->size;
+    for (int64_t j = 0; ok && j < h->cols; j++) ok = check_column(mf, h, &dir[j]);
+    if (!ok) {
+        printf("Error: %s is not a valid snapshot.\n", path);
+        unmap_file(mf);
+        free(mf);
+        return false;
+    }
+
+    table->rows = (int)h->rows;
+    table->cols = (int)h->cols;
+    table->mapping = mf;
+    table->arena = arena_create();
+    table->headers = calloc(table->cols > 0 ? table->cols : 1, sizeof(char *));
+    table->columns = calloc(table->cols > 0 ? table->cols : 1, sizeof(Column));
+    if (stats) *stats = calloc(table->cols > 0 ? table->cols : 1, sizeof(ColumnSummary));
+    if (!table->arena || !table->headers || !table->columns || (stats && !*stats)) {
+        if (stats) {
+            free(*stats);
+            *stats = NULL;
+        }
+        free_table(table);
+        return false;
+    }
+
+    // The mapping is private, so columns may be modified where they lie
+    char *base = (char *)mf->data;
+#define SECTION(at) ((at) ? base + (at) : NULL)
+    for (int j = 0; j < table->cols; j++) {
+        const SnapshotColumn *d = &dir[j];
+        Column *col = &table->columns[j];
+        column_init_in(col, (FieldType)d->type, table->arena);
+        col->length = col->capacity = table->rows;
+        col->validity = (uint64_t *)SECTION(d->validity);
+        switch (col->type) {
+            case TYPE_INT: col->ints = (int64_t *)SECTION(d->values); break;
+            case TYPE_FLOAT: col->floats = (double *)SECTION(d->values); break;
+            case TYPE_BOOL: col->bools = (uint8_t *)SECTION(d->values); break;
+            default:
+                col->offsets = (int64_t *)SECTION(d->offsets);
+                col->codes = (uint16_t *)SECTION(d->codes);
+                col->dict_count = (int)d->dict_count;
+                col->bytes = SECTION(d->bytes);
+                col->bytes_len = col->bytes_cap = d->bytes_length;
+                break;
+        }
+        table->headers[j] = base + d->name;
+        if (stats) {
+            ColumnSummary *s = &(*stats)[j];
+            s->numeric = d->numeric;
+            s->count = d->count;
+            s->nulls = d->nulls;
+            s->mean = d->mean;
+            s->sd = d->sd;
+            s->min = d->min;
+            s->max = d->max;
+            s->quartiles[0] = s->quartiles[1] = s->quartiles[2] = NAN;
+        }
+    }
+#undef SECTION
+    // The stored stats are current, so nothing needs describing again
+    if (stats) table_stats_seed(table, *stats, 0);
+    return true;
+}
+
+bool snapshot_load(Table *table, const char *path, ColumnSummary **stats) {
+    int scope = trace_begin("snapshot_load");
+    bool ok = open_snapshot(table, path, stats);
+    trace_end(scope);
+    return ok;
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+#include "statcache.h"
+#include "stats.h"
+#include "threadpool.h"
+
+#define STALE -1
+
+struct StatsCache
+{
+    int cols;
+    double quantile_error; // error the quartiles were sketched at
+    ColumnSummary *summary;
+    int *made;             // DESCRIBE_* flags of each entry, STALE if none
+};
+
+// The cache is not part of the table's value, so reading functions that
+// take a const table may still fill it
+static StatsCache *cache_of(const Table *table) {
+    Table *t = (Table *)table;
+    StatsCache *c = t->stats;
+    if (c && c->cols == t->cols && c->quantile_error == get_quantile_error()) return c;
+
+    table_stats_free(t);
+    int n = t->cols > 0 ? t->cols : 1;
+    c = malloc(sizeof(StatsCache));
+    if (!c) return NULL;
+    c->cols = t->cols;
+    c->quantile_error = get_quantile_error();
+    c->summary = calloc(n, sizeof(ColumnSummary));
+    c->made = malloc(n * sizeof(int));
+    if (!c->summary || !c->made) {
+        free(c->summary);
+        free(c->made);
+        free(c);
+        return NULL;
+    }
+    for (int j = 0; j < n; j++) c->made[j] = STALE;
+    t->stats = c;
+    return c;
+}
+
+static bool is_current(const StatsCache *c, int col, int flags) {
+    return c->made[col] != STALE && (c->made[col] & flags) == flags;
+}
+
+typedef struct
+{
+    const Table *table;
+    StatsCache *cache;
+    const int *cols;
+    int flags;
+    bool ok;
+} RefreshJob;
+
+static void refresh_task(int i, void *ctx) {
+    RefreshJob *job = ctx;
+    int j = job->cols[i];
+    if (describe_column(&job->table->columns[j], &job->cache->summary[j], job->flags)) {
+        job->cache->made[j] = job->flags;
+    } else {
+        job->ok = false;
+    }
+}
+
+const ColumnSummary *table_summaries(const Table *table, int flags) {
+    StatsCache *c = cache_of(table);
+    int *stale = c ? malloc((size_t)(table->cols > 0 ? table->cols : 1) * sizeof(int)) : NULL;
+    if (!stale) return NULL;
+    int n = 0;
+    for (int j = 0; j < table->cols; j++) {
+        if (!is_current(c, j, flags)) stale[n++] = j;
+    }
+    RefreshJob job = {table, c, stale, flags, true};
+    if (n > 0) parallel_for(n, refresh_task, &job);
+    free(stale);
+    return job.ok ? c->summary : NULL;
+}
+
+const ColumnSummary *table_column_summary(const Table *table, int col, int flags) {
+    StatsCache *c = cache_of(table);
+    if (!c || col < 0 || col >= table->cols) return NULL;
+    if (!is_current(c, col, flags)) {
+        if (!describe_column(&table->columns[col], &c->summary[col], flags)) return NULL;
+        c->made[col] = flags;
+    }
+    return &c->summary[col];
+}
+
+const ColumnSummary *table_cached_summary(const Table *table, int col) {
+    const StatsCache *c = table->stats;
+    if (!c || c->cols != table->cols || col < 0 || col >= c->cols || c->made[col] == STALE) return NULL;
+    return &c->summary[col];
+}
+
+void table_stats_changed(Table *table, int col) {
+    StatsCache *c = table->stats;
+    if (!c || col >= c->cols) return;
+    if (col >= 0) {
+        c->made[col] = STALE;
+        return;
+    }
+    for (int j = 0; j < c->cols; j++) c->made[j] = STALE;
+}
+
+void table_stats_seed(Table *table, const ColumnSummary *summary, int flags) {
+    StatsCache *c = cache_of(table);
+    if (!c) return;
+    for (int j = 0; j < table->cols; j++) {
+        c->summary[j] = summary[j];
+        c->made[j] = flags;
+    }
+}
+
+void table_stats_free(Table *table) {
+    StatsCache *c = table->stats;
+    if (!c) return;
+    free(c->summary);
+    free(c->made);
+    free(c);
+    table->stats = NULL;
+}
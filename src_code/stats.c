@@ -3,110 +3,133 @@
 #include <math.h>
 #include <string.h>
 #include "stats.h"
+#include "threadpool.h"
+#include "statcache.h"
 
-double calculate_mean(float *vals, int size) {
-    if (size == 0) return NAN;
-    double sum = 0;
-    int valid_count = 0;
-    for (int i = 0; i < size; i++) {
-        if (!isnan(vals[i])) {
-            sum += vals[i];
-            valid_count++;
-        }
-    }
-    return valid_count > 0 ? sum / valid_count : NAN;
+static double quantile_error = DEFAULT_QUANTILE_ERROR;
+
+// Single statistics read from the fused describe pass
+static ColumnSummary summarize(const Column *col) {
+    ColumnSummary s;
+    if (!describe_column(col, &s, 0)) s.mean = s.sd = s.min = s.max = NAN;
+    return s;
 }
 
-double calculate_sd(float *vals, int size) {
-    if (size == 0) return NAN;
-    double mean = calculate_mean(vals, size);
-    double sum_sq = 0;
-    int valid_count = 0;
-    for (int i = 0; i < size; i++) {
-        if (!isnan(vals[i])) {
-            sum_sq += pow(vals[i] - mean, 2);
-            valid_count++;
-        }
-    }
-    return valid_count > 0 ? sqrt(sum_sq / valid_count) : NAN;
+double calculate_mean(const Column *col) {
+    return summarize(col).mean;
 }
 
-double calculate_min(float *vals, int size) {
-    if (size == 0) return NAN;
-    double min = NAN;
-    int i;
-    for (i = 0; i < size; i++) {
-        if (!isnan(vals[i])) {
-            min = vals[i];
-            break;
-        }
-    }
-    if (isnan(min)) return NAN;
-    for (; i < size; i++) {
-        if (!isnan(vals[i]) && vals[i] < min) min = vals[i];
+double calculate_sd(const Column *col) {
+    return summarize(col).sd;
+}
+
+double calculate_min(const Column *col) {
+    return summarize(col).min;
+}
+
+double calculate_max(const Column *col) {
+    return summarize(col).max;
+}
+
+void set_quantile_error(double eps) {
+    quantile_error = eps < 0 ? 0 : eps;
+}
+
+double get_quantile_error(void) {
+    return quantile_error;
+}
+
+typedef struct
+{
+    const Column *col;
+    QuantileSketch *parts;
+    bool ok;
+} SketchJob;
+
+static void sketch_chunk(int c, void *ctx) {
+    SketchJob *job = ctx;
+    int end = (c + 1) * SKETCH_CHUNK_ROWS;
+    if (end > job->col->length) end = job->col->length;
+    double v;
+    for (int i = c * SKETCH_CHUNK_ROWS; i < end; i++) {
+        if (column_get_number(job->col, i, &v) && !sketch_add(&job->parts[c], v)) job->ok = false;
     }
-    return min;
 }
 
-double calculate_max(float *vals, int size) {
-    if (size == 0) return NAN;
-    double max = NAN;
-    int i;
-    for (i = 0; i < size; i++) {
-        if (!isnan(vals[i])) {
-            max = vals[i];
-            break;
+// Quantile sketch of the numeric values of a column at the configured
+// error. Long columns are sketched in parallel chunks that are then merged.
+// The sketch must be freed afterwards even if this fails.
+bool column_sketch(const Column *col, QuantileSketch *s) {
+    int k = sketch_k_for_error(quantile_error);
+    if (!sketch_init(s, k)) return false;
+
+    int chunks = (col->length + SKETCH_CHUNK_ROWS - 1) / SKETCH_CHUNK_ROWS;
+    if (chunks <= 1) {
+        double v;
+        for (int i = 0; i < col->length; i++) {
+            if (column_get_number(col, i, &v) && !sketch_add(s, v)) return false;
         }
+        return true;
     }
-    if (isnan(max)) return NAN;
-    for (; i < size; i++) {
-        if (!isnan(vals[i]) && vals[i] > max) max = vals[i];
+
+    SketchJob job = {col, calloc(chunks, sizeof(QuantileSketch)), true};
+    if (!job.parts) return false;
+    for (int c = 0; c < chunks && job.ok; c++) job.ok = sketch_init(&job.parts[c], k);
+    if (job.ok) parallel_for(chunks, sketch_chunk, &job);
+    for (int c = 0; c < chunks; c++) {
+        if (job.ok) job.ok = sketch_merge(s, &job.parts[c]);
+        sketch_free(&job.parts[c]);
     }
-    return max;
+    free(job.parts);
+    return job.ok;
 }
 
-int cmp_doubles(const void *a, const void *b) {
-    double x = *(const double *)a;
-    double y = *(const double *)b;
-    return (x > y) - (x < y);
+static inline bool outside(double v, double lo, double hi, bool positive_only) {
+    return (v < lo || v > hi) && (!positive_only || v > 0);
 }
 
-double calculate_quantile(float *vals, int size, double quantile) {
-    if (size == 0) return NAN;
-    double *valid_vals = malloc(size * sizeof(double));
-    if (!valid_vals) return NAN;
-    int valid_count = 0;
-    for (int i = 0; i < size; i++) {
-        if (!isnan(vals[i])) {
-            valid_vals[valid_count++] = vals[i];
-        }
+int column_values_outside(const Column *col, double lo, double hi, bool positive_only, RowValue **out) {
+    double v;
+    int count = 0;
+    for (int i = 0; i < col->length; i++) {
+        if (column_get_number(col, i, &v) && outside(v, lo, hi, positive_only)) count++;
     }
-    if (valid_count == 0) {
-        free(valid_vals);
+    *out = malloc((count > 0 ? count : 1) * sizeof(RowValue));
+    if (!*out) return -1;
+    int n = 0;
+    for (int i = 0; i < col->length && n < count; i++) {
+        if (column_get_number(col, i, &v) && outside(v, lo, hi, positive_only)) (*out)[n++] = (RowValue){i + 1, v};
+    }
+    return count;
+}
+
+double calculate_quantile(const Column *col, double quantile) {
+    QuantileSketch s;
+    if (!column_sketch(col, &s)) {
+        sketch_free(&s);
         return NAN;
     }
-    qsort(valid_vals, valid_count, sizeof(double), cmp_doubles);
-    int idx = (int)(quantile * (valid_count - 1));
-    double result = valid_vals[idx];
-    free(valid_vals);
+    double result = sketch_quantile(&s, quantile);
+    sketch_free(&s);
     return result;
 }
 
 void print_info(const Table *table) {
-    if (!table || !table->headers || !table->types || table->cols <= 0) {
+    if (!table || !table->headers || !table->columns || table->cols <= 0) {
         printf("Error: Invalid table\n");
         return;
     }
     const char *dtype_str[] = {"String", "Int", "Float", "Bool", "Null"};
-    printf("\nRange index: 0 to %d\n", table->rows - 1);
+    if (table->rows > 0) printf("\nRange index: %d entries, 0 to %d\n", table->rows, table->rows - 1);
+    else printf("\nRange index: 0 entries\n");
     printf("#   Column            Dtype\n");
     for (int j = 0; j < table->cols; j++) {
-        printf("%-3d %-18s %s\n", j + 1, table->headers[j] ? table->headers[j] : "", dtype_str[table->types[j]]);
+        printf("%-3d %-18s %s\n", j + 1, table->headers[j] ? table->headers[j] : "", dtype_str[table->columns[j].type]);
     }
 }
 
 void print_stats(const Table *table) {
-    if (!table || !table->headers || !table->types || table->cols <= 0) {
+    if (!table || !table->headers || !table->columns || table->cols <= 0) {
         printf("Error: Invalid table\n");
         return;
     }
@@ -114,41 +137,37 @@ void print_stats(const Table *table) {
 
     printf("%-12s", "");
     for (int j = 0; j < table->cols; j++) {
-        if (table->types[j] == TYPE_INT || table->types[j] == TYPE_FLOAT) {
+        if (column_is_numeric(&table->columns[j])) {
             printf("%-15s", table->headers[j] ? table->headers[j] : "");
         }
     }
     printf("\n");
 
+    // Every statistic of every column comes from one pass per column,
+    // made the first time it is asked for after the column changed
+    const ColumnSummary *summary = table_summaries(table, DESCRIBE_QUARTILES);
+    if (!summary) {
+        printf("Error: Memory allocation failed.\n");
+        return;
+    }
+
     const char *labels[] = {"Count", "Mean", "SD", "Min", "25%", "50%", "75%", "Max"};
     for (int stat = 0; stat < 8; stat++) {
         printf("%-12s", labels[stat]);
         for (int j = 0; j < table->cols; j++) {
-            if (table->types[j] != TYPE_INT && table->types[j] != TYPE_FLOAT) continue;
-            float *vals = get_column_as_float(table, j);
-            if (!vals) {
-                printf("%-15s", "NaN");
-                continue;
-            }
-            int size = table->rows - 1;
+            const ColumnSummary *s = &summary[j];
+            if (!s->numeric) continue;
             double result = NAN;
-            if (size > 0) {
+            if (table->columns[j].length > 0) {
                 switch (stat) {
-                    case 0: {
-                        int count = 0;
-                        for (int i = 0; i < size; i++) {
-                            if (!isnan(vals[i])) count++;
-                        }
-                        result = count;
-                        break;
-                    }
-                    case 1: result = calculate_mean(vals, size); break;
-                    case 2: result = calculate_sd(vals, size); break;
-                    case 3: result = calculate_min(vals, size); break;
-                    case 4: result = calculate_quantile(vals, size, 0.25); break;
-                    case 5: result = calculate_quantile(vals, size, 0.50); break;
-                    case 6: result = calculate_quantile(vals,  size, 0.75); break;
-                    case 7: result = calculate_max(vals, size); break;
+                    case 0: result = s->count; break;
+                    case 1: result = s->mean; break;
+                    case 2: result = s->sd; break;
+                    case 3: result = s->min; break;
+                    case 4: result = s->quartiles[0]; break;
+                    case 5: result = s->quartiles[1]; break;
+                    case 6: result = s->quartiles[2]; break;
+                    case 7: result = s->max; break;
                 }
             }
             if (isnan(result))
@@ -157,8 +176,6 @@ void print_stats(const Table *table) {
                 printf("%-15.0f", result);
             else
                 printf("%-15.2f", result);
-
-            free(vals);
         }
         printf("\n");
     }
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "threadpool.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Work stealing: every worker owns a deque of tasks and outside threads
+// share one more. A thread pushes the tasks it spawns onto its own deque
+// and pops them back newest first; when that runs dry it steals the oldest
+// task of another deque. Threads waiting for a parallel_for to finish keep
+// running tasks meanwhile, so parallel_for calls can nest, and sleep once
+// there are none left.
+
+typedef struct
+{
+    TaskFn fn;
+    void *arg;
+} Task;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    Task *items; // live tasks are items[head..tail)
+    int head, tail, cap;
+} Deque;
+
+struct ThreadPool
+{
+    pthread_t *workers;
+    int count;
+    Deque *deques;      // one per worker, then the one for outside threads
+    atomic_int started; // hands each worker its deque
+    atomic_int queued;  // tasks sitting in deques
+    atomic_int pending; // tasks submitted and not yet finished
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t idle;
+    bool stop;
+};
+
+static int thread_setting = 0;
+static ThreadPool *shared_pool = NULL;
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Pool and deque of the current thread when it is a worker
+static _Thread_local ThreadPool *current_pool = NULL;
+static _Thread_local int current_deque = -1;
+
+static int own_deque(const ThreadPool *pool) {
+    return current_pool == pool ? current_deque : pool->count;
+}
+
+static bool deque_push(Deque *d, Task task) {
+    bool ok = true;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap && d->head > 0) {
+        memmove(d->items, d->items + d->head, (size_t)(d->tail - d->head) * sizeof(Task));
+        d->tail -= d->head;
+        d->head = 0;
+    }
+    if (d->tail == d->cap) {
+        int cap = d->cap ? d->cap * 2 : 16;
+        Task *items = realloc(d->items, (size_t)cap * sizeof(Task));
+        if (items) {
+            d->items = items;
+            d->cap = cap;
+        } else {
+            ok = false;
+        }
+    }
+    if (ok) d->items[d->tail++] = task;
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+// Newest task for the owner, oldest for a thief
+static bool deque_take(Deque *d, Task *task, bool steal) {
+    bool found = false;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *task = steal ? d->items[d->head++] : d->items[--d->tail];
+        if (d->head == d->tail) d->head = d->tail = 0;
+        found = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+// A task from deque `self`, or else stolen from the others in turn
+static bool take_task(ThreadPool *pool, int self, Task *task) {
+    int n = pool->count + 1;
+    for (int i = 0; i < n; i++) {
+        int d = (self + i) % n;
+        if (deque_take(&pool->deques[d], task, i > 0)) {
+            atomic_fetch_sub(&pool->queued, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void run_task(ThreadPool *pool, Task *task) {
+    task->fn(task->arg);
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->idle);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void *worker_main(void *arg) {
+    ThreadPool *pool = arg;
+    current_pool = pool;
+    current_deque = atomic_fetch_add(&pool->started, 1);
+    for (;;) {
+        Task task;
+        if (take_task(pool, current_deque, &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) <= 0 && !pool->stop) pthread_cond_wait(&pool->has_work, &pool->lock);
+        bool stop = pool->stop && atomic_load(&pool->queued) <= 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+static void stop_workers(ThreadPool *pool, int started) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < started; i++) pthread_join(pool->workers[i], NULL);
+}
+
+static void free_pool(ThreadPool *pool) {
+    for (int i = 0; i <= pool->count; i++) {
+        free(pool->deques[i].items);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+ThreadPool *threadpool_create(int threads) {
+    if (threads < 1) threads = 1;
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+    pool->workers = malloc(threads * sizeof(pthread_t));
+    pool->deques = calloc(threads + 1, sizeof(Deque));
+    if (!pool->workers || !pool->deques) {
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    for (int i = 0; i <= threads; i++) pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    // Workers read the count, so it is set before they start
+    pool->count = threads;
+    int started = 0;
+    while (started < threads && pthread_create(&pool->workers[started], NULL, worker_main, pool) == 0) started++;
+    if (started < threads) {
+        stop_workers(pool, started);
+        free_pool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Queue a task on the caller's own deque, where idle workers steal it
+bool threadpool_submit(ThreadPool *pool, TaskFn fn, void *arg) {
+    atomic_fetch_add(&pool->pending, 1);
+    if (!deque_push(&pool->deques[own_deque(pool)], (Task){fn, arg})) {
+        atomic_fetch_sub(&pool->pending, 1);
+        return false;
+    }
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+// Block until every submitted task has finished. For threads outside the
+// pool; tasks wait with parallel_for instead.
+void threadpool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (atomic_load(&pool->pending) > 0) pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void threadpool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+    stop_workers(pool, pool->count);
+    free_pool(pool);
+}
+
+static int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+void set_thread_count(int threads) {
+    pthread_mutex_lock(&shared_lock);
+    thread_setting = threads < 0 ? 0 : threads;
+    // The shared pool is rebuilt with the new size on next use
+    threadpool_destroy(shared_pool);
+    shared_pool = NULL;
+    pthread_mutex_unlock(&shared_lock);
+}
+
+int get_thread_count(void) {
+    return thread_setting > 0 ? thread_setting : cpu_count();
+}
+
+typedef struct
+{
+    ParallelFn fn;
+    void *ctx;
+    int count;
+    atomic_int next;
+    atomic_int helpers; // helper tasks that may still touch the job
+    pthread_mutex_t lock;
+    pthread_cond_t done; // the last helper has let go
+} ParallelJob;
+
+static void run_job(ParallelJob *job) {
+    int i;
+    while ((i = atomic_fetch_add(&job->next, 1)) < job->count) job->fn(i, job->ctx);
+}
+
+static void helper_task(void *arg) {
+    ParallelJob *job = arg;
+    run_job(job);
+    // Under the lock, so the caller cannot free the job between the count
+    // reaching zero and the signal. The job may be gone after the unlock.
+    pthread_mutex_lock(&job->lock);
+    if (atomic_fetch_sub(&job->helpers, 1) == 1) pthread_cond_signal(&job->done);
+    pthread_mutex_unlock(&job->lock);
+}
+
+void parallel_for(int count, ParallelFn fn, void *ctx) {
+    if (count <= 0) return;
+    int threads = get_thread_count();
+    if (threads > count) threads = count;
+
+    ParallelJob job = {.fn = fn, .ctx = ctx, .count = count};
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.done, NULL);
+    ThreadPool *pool = NULL;
+    if (threads > 1) {
+        pthread_mutex_lock(&shared_lock);
+        // The calling thread works too, so the pool needs one thread less
+        if (!shared_pool) shared_pool = threadpool_create(get_thread_count() - 1);
+        pool = shared_pool;
+        pthread_mutex_unlock(&shared_lock);
+    }
+    if (pool) {
+        for (int t = 1; t < threads; t++) {
+            atomic_fetch_add(&job.helpers, 1);
+            if (!threadpool_submit(pool, helper_task, &job)) {
+                atomic_fetch_sub(&job.helpers, 1);
+                break;
+            }
+        }
+    }
+    run_job(&job);
+    // Helpers not started yet still hold the job, so run queued tasks (ours
+    // first) until they have all let go of it. With nothing queued every
+    // helper is running on some thread, and the last one to finish wakes us.
+    // The count is last read under the lock, so that helper is out of
+    // helper_task before the lock is destroyed.
+    for (;;) {
+        Task task;
+        if (atomic_load(&job.helpers) > 0 && take_task(pool, own_deque(pool), &task)) {
+            run_task(pool, &task);
+            continue;
+        }
+        pthread_mutex_lock(&job.lock);
+        while (atomic_load(&job.helpers) > 0 && atomic_load(&pool->queued) <= 0) {
+            pthread_cond_wait(&job.done, &job.lock);
+        }
+        bool done = atomic_load(&job.helpers) == 0;
+        pthread_mutex_unlock(&job.lock);
+        if (done) break;
+    }
+    pthread_cond_destroy(&job.done);
+    pthread_mutex_destroy(&job.lock);
+}
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "trace.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define TRACE_NAME_LEN 48
+
+typedef struct
+{
+    char name[TRACE_NAME_LEN];
+    int thread, depth;
+    double start_us, dur_us;
+    int64_t counters[TRACE_COUNTERS]; // values at the start, then the change
+    long peak_kb;
+    bool open;
+} TraceScope;
+
+static const char *const counter_names[TRACE_COUNTERS] = {
+    "bytes_read", "bytes_written", "rows_parsed", "cells", "allocations"};
+
+static bool enabled;
+static const char *report_path, *chrome_path;
+static atomic_llong counters[TRACE_COUNTERS];
+static atomic_int threads_seen;
+static atomic_int open_scopes;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceScope *scopes;
+static int scope_count, scope_cap;
+static double origin_us;
+
+static _Thread_local int thread_id; // 0 until the thread opens a scope
+static _Thread_local int thread_depth;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* =========================================================
+ * Memory
+ * ======================================================= */
+void reset_peak_memory(void) {
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (fp) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+#endif
+}
+
+long peak_memory_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return -1;
+    return (long)(pmc.PeakWorkingSetSize / 1024);
+#else
+#ifdef __linux__
+    // VmHWM follows reset_peak_memory; ru_maxrss does not
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+        }
+        fclose(fp);
+        if (kb >= 0) return kb;
+    }
+#endif
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024; // bytes there
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+
+/* =========================================================
+ * Recording
+ * ======================================================= */
+void trace_enable(const char *report, const char *chrome) {
+    if (!enabled) atexit(trace_finish);
+    enabled = true;
+    report_path = report;
+    chrome_path = chrome;
+    origin_us = now_us();
+}
+
+bool trace_enabled(void) {
+    return enabled;
+}
+
+void trace_add(TraceCounter counter, int64_t amount) {
+    if (enabled) atomic_fetch_add_explicit(&counters[counter], amount, memory_order_relaxed);
+}
+
+int trace_begin(const char *name) {
+    if (!enabled) return -1;
+    if (thread_id == 0) thread_id = atomic_fetch_add(&threads_seen, 1) + 1;
+    // Outermost scopes start a new memory peak, nested ones share it
+    if (atomic_fetch_add(&open_scopes, 1) == 0) reset_peak_memory();
+
+    pthread_mutex_lock(&lock);
+    if (scope_count == scope_cap) {
+        int cap = scope_cap ? scope_cap * 2 : 256;
+        TraceScope *bigger = realloc(scopes, (size_t)cap * sizeof(TraceScope));
+        if (!bigger) {
+            pthread_mutex_unlock(&lock);
+            atomic_fetch_sub(&open_scopes, 1);
+            return -1;
+        }
+        scopes = bigger;
+        scope_cap = cap;
+    }
+    int index = scope_count++;
+    TraceScope *s = &scopes[index];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    s->thread = thread_id;
+    s->depth = thread_depth++;
+    s->open = true;
+    for (int c = 0; c < TRACE_COUNTERS; c++) s->counters[c] = atomic_load(&counters[c]);
+    s->start_us = now_us() - origin_us;
+    pthread_mutex_unlock(&lock);
+    return index;
+}
+
+void trace_end(int scope) {
+    if (scope < 0) return;
+    double end = now_us() - origin_us;
+    long peak = peak_memory_kb();
+    pthread_mutex_lock(&lock);
+    TraceScope *s = &scopes[scope];
+    s->dur_us = end - s->start_us;
+    s->peak_kb = peak;
+    s->open = false;
+    for (int c = 0; c < TRACE_COUNTERS; c++) s->counters[c] = atomic_load(&counters[c]) - s->counters[c];
+    pthread_mutex_unlock(&lock);
+    thread_depth--;
+    atomic_fetch_sub(&open_scopes, 1);
+}
+
+/* =========================================================
+ * Output
+ * ======================================================= */
+// Names are ours or menu labels, but keep the JSON valid whatever they hold
+static void write_name(FILE *fp, const char *name) {
+    fputc('"', fp);
+    for (const char *p = name; *p; p++) {
+        if (*p == '"' || *p == '\\') fputc('\\', fp);
+        if ((unsigned char)*p >= 0x20) fputc(*p, fp);
+    }
+    fputc('"', fp);
+}
+
+static void write_counters(FILE *fp, const int64_t *values) {
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        fprintf(fp, ", \"%s\": %lld", counter_names[c], (long long)values[c]);
+    }
+}
+
+static bool write_report(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return false;
+    int64_t totals[TRACE_COUNTERS];
+    for (int c = 0; c < TRACE_COUNTERS; c++) totals[c] = atomic_load(&counters[c]);
+    fprintf(fp, "{\n  \"totals\": {\"ms\": %.3f", (now_us() - origin_us) / 1e3);
+    write_counters(fp, totals);
+    fprintf(fp, ", \"peak_rss_kb\": %ld},\n  \"scopes\": [", peak_memory_kb());
+    bool first = true;
+    for (int i = 0; i < scope_count; i++) {
+        const TraceScope *s = &scopes[i];
+        if (s->open) continue;
+        fprintf(fp, "%s\n    {\"name\": ", first ? "" : ",");
+        write_name(fp, s->name);
+        fprintf(fp, ", \"thread\": %d, \"depth\": %d, \"start_ms\": %.3f, \"ms\": %.3f", s->thread, s->depth,
+                s->start_us / 1e3, s->dur_us / 1e3);
+        write_counters(fp, s->counters);
+        fprintf(fp, ", \"peak_rss_kb\": %ld}", s->peak_kb);
+        first = false;
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    return fclose(fp) == 0;
+}
+
+// Complete ("X") events nest by time on each thread; the memory peak is a
+// counter track
+static bool write_chrome(const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return false;
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    for (int i = 0; i < scope_count; i++) {
+        const TraceScope *s = &scopes[i];
+        if (s->open) continue;
+        fprintf(fp, "%s{\"name\": ", first ? "" : ",\n");
+        write_name(fp, s->name);
+        fprintf(fp, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.1f, \"dur\": %.1f, \"args\": {\"depth\": %d",
+                s->thread, s->start_us, s->dur_us, s->depth);
+        write_counters(fp, s->counters);
+        fprintf(fp, "}},\n{\"name\": \"peak_rss_kb\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.1f, \"args\": {\"kb\": %ld}}",
+                s->start_us + s->dur_us, s->peak_kb);
+        first = false;
+    }
+    fprintf(fp, "\n]}\n");
+    return fclose(fp) == 0;
+}
+
+void trace_finish(void) {
+    if (!enabled) return;
+    pthread_mutex_lock(&lock);
+    if (report_path && !write_report(report_path)) printf("Error: cannot write trace report '%s'.\n", report_path);
+    if (chrome_path && !write_chrome(chrome_path)) printf("Error: cannot write trace '%s'.\n", chrome_path);
+    free(scopes);
+    scopes = NULL;
+    scope_count = scope_cap = 0;
+    enabled = false;
+    pthread_mutex_unlock(&lock);
+}
@@ -5,6 +5,7 @@
 
 #define MAX_COLUMN_WIDTH 30
 #define MIN_SPACING 6
+#define CELL_BUF_LEN 64
 
 // Dynamically calculate width for each column (+1 for "No.")
 static int *calculate_column_widths(const Table *table) {
@@ -13,10 +14,11 @@ static int *calculate_column_widths(const Table *table) {
 
     widths[0] = 4; // For "No."
 
+    char buf[CELL_BUF_LEN];
     for (int j = 0; j < table->cols; j++) {
         int max_len = strlen(table->headers[j]);
-        for (int i = 1; i < table->rows; i++) { // skip header row
-            int len = table->data[i][j] ? strlen(table->data[i][j]) : 0;
+        for (int i = 0; i < table->rows; i++) {
+            int len = strlen(column_text(&table->columns[j], i, buf, sizeof(buf)));
             if (len > max_len) max_len = len;
         }
         widths[j + 1] = (max_len > MAX_COLUMN_WIDTH) ? MAX_COLUMN_WIDTH : max_len;
@@ -95,38 +97,52 @@ static void print_table_section(const Table *table, int start, int end, const ch
     }
     printf("\n");
 
-    int row_number = start;
+    // Cell text for one row; non-string cells are formatted into scratch
+    const char **cells = malloc(table->cols * sizeof(char *));
+    char (*scratch)[CELL_BUF_LEN] = malloc(table->cols * sizeof(*scratch));
+    if (!cells || !scratch) {
+        free(cells);
+        free(scratch);
+        free(widths);
+        return;
+    }
+
+    // Table rows are 0-based, displayed row numbers stay 1-based
+    int row_number = start + 1;
     for (int i = start; i < end; i++) {
-        print_wrapped_row((const char **)table->data[i], widths, table->cols, row_number++);
+        for (int j = 0; j < table->cols; j++) {
+            cells[j] = column_text(&table->columns[j], i, scratch[j], CELL_BUF_LEN);
+        }
+        print_wrapped_row(cells, widths, table->cols, row_number++);
     }
 
+    free(cells);
+    free(scratch);
     free(widths);
 }
 
 // Show top N rows
 void print_head(const Table *table, int num) {
-    int data_rows = table->rows - 1;
-    int count = (num < data_rows) ? num : data_rows;
-    print_table_section(table, 1, count + 1, "Header");
+    int count = (num < table->rows) ? num : table->rows;
+    print_table_section(table, 0, count, "Header");
 }
 
 // Show last N rows
 void print_tail(const Table *table, int num) {
-    int data_rows = table->rows - 1;
-    int count = (num < data_rows) ? num : data_rows;
-    int start = data_rows - count + 1;
-    if (start < 1) start = 1;
+    int count = (num < table->rows) ? num : table->rows;
+    int start = table->rows - count;
+    if (start < 0) start = 0;
     print_table_section(table, start, table->rows, "Tailer");
 }
 
-// Show specific row range (start to end inclusive)
+// Show specific row range (start to end inclusive, 1-based)
 void print_row_range(const Table *table, int start, int end) {
-    int data_rows = table->rows - 1;
+    int data_rows = table->rows;
     if (start < 1) start = 1;
     if (end > data_rows) end = data_rows;
     if (start > end || start > data_rows) {
         printf("Invalid row range.\n");
         return;
     }
-    print_table_section(table, start, end + 1, "Row Range");
+    print_table_section(table, start - 1, end, "Row Range");
 }